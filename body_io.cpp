@@ -0,0 +1,148 @@
+#include "body_io.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace {
+
+// writes buffered body bytes to the destination
+bool write_all(int fd, off_t* offset, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = offset ? pwrite(fd, data, len, *offset) : send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        if (offset) *offset += n;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+ssize_t body_read_head(int fd, std::string &buf, size_t max){
+  size_t searched = 0;
+  for (;;){
+    // the blank line may straddle two reads, so look back three bytes
+    size_t from = searched > 3 ? searched - 3 : 0;
+    size_t end = buf.find("\r\n\r\n", from);
+    if (end != std::string::npos && end + 4 <= max) return end + 4;
+    if (buf.size() >= max){
+      errno = EMSGSIZE;
+      return -1;
+    }
+    searched = buf.size();
+    char chunk[4096];
+    ssize_t n = recv(fd, chunk, std::min(sizeof(chunk), max - buf.size()), 0);
+    if (n == 0) return 0;
+    if (n < 0){
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    buf.append(chunk, n);
+  }
+}
+
+void body_linger(int fd, int ms){
+  shutdown(fd, SHUT_WR);
+  timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  char buf[65536];
+  for (;;){
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+    pollfd p = { fd, POLLIN, 0 };
+    if (elapsed >= ms || poll(&p, 1, ms - elapsed) <= 0) return;
+    if (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) <= 0) return;
+  }
+}
+
+int body_open_pipe(int pipe_fds[2], int size){
+  if (pipe2(pipe_fds, O_CLOEXEC) < 0) return -1;
+  // fewer, larger splices; the default 64 KiB pipe is used if this is refused
+  fcntl(pipe_fds[1], F_SETPIPE_SZ, size);
+  return 0;
+}
+
+bool body_read_line(BodyReader* r, std::string &line, size_t max){
+  line.clear();
+  while (line.size() < max){
+    if (r->left > 0){
+      line += *r->pending++;
+      r->left--;
+    } else {
+      // peek first so nothing past the line is taken from the socket
+      char buf[64];
+      ssize_t n = recv(r->fd, buf, sizeof(buf), MSG_PEEK);
+      if (n <= 0) return false;
+      const char* nl = (const char*)memchr(buf, '\n', n);
+      size_t take = nl ? nl - buf + 1 : n;
+      if (recv(r->fd, buf, take, 0) != (ssize_t)take) return false;
+      line.append(buf, take);
+    }
+    if (line.back() == '\n'){
+      line.pop_back();
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool body_chunk_size(const std::string &line, unsigned long long* size){
+  // chunk-size = 1*HEXDIG, then BWS before any ";ext" (RFC 9112 7.1.1);
+  // no sign, no "0x", no leading blanks and no more than 64 bits
+  size_t i = 0;
+  unsigned long long value = 0;
+  for (; i < line.size() && hex_digit(line[i]) >= 0; i++){
+    if (i == 16) return false;
+    value = value << 4 | hex_digit(line[i]);
+  }
+  if (i == 0) return false;
+  while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) i++;
+  if (i < line.size() && line[i] != ';') return false;
+  *size = value;
+  return true;
+}
+
+bool body_splice(BodyReader* r, int to_fd, off_t* to_offset, off_t count, const int pipe_fds[2], int pipe_size,
+                 off_t* moved){
+  size_t buffered = count < 0 ? r->left : (size_t)std::min((off_t)r->left, count);
+  if (buffered > 0){
+    if (!write_all(to_fd, to_offset, r->pending, buffered)) return false;
+    r->pending += buffered;
+    r->left -= buffered;
+    if (moved) *moved += buffered;
+    if (count > 0) count -= buffered;
+  }
+
+  while (count != 0){
+    size_t want = count < 0 ? pipe_size : std::min(count, (off_t)pipe_size);
+    ssize_t n = splice(r->fd, NULL, pipe_fds[1], NULL, want, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n == 0 && count < 0) return true;
+    if (n <= 0) return false;
+    if (count > 0) count -= n;
+    if (moved) *moved += n;
+    // drain the pipe completely, so the next splice into it never blocks;
+    // MSG_MORE only while more is known to follow, or the last segment would wait
+    unsigned int more = count > 0 ? SPLICE_F_MORE : 0;
+    while (n > 0){
+      ssize_t m = splice(pipe_fds[0], NULL, to_fd, to_offset, n, SPLICE_F_MOVE | more);
+      if (m <= 0) return false;
+      n -= m;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+
+/**
+ * Message bodies read from a socket, shared by uploads and the proxy.
+ *
+ * Bytes that arrived together with a header block are used up first; the
+ * rest is moved socket -> pipe -> destination with splice(), so payload
+ * never enters user space. Only chunk-size and trailer lines of a chunked
+ * body (RFC 9112 7.1) are read here.
+ */
+
+/**
+ * @struct BodyReader
+ * @brief Source of a body: bytes already buffered, then the socket
+ * @var fd      Socket the rest of the body is read from
+ * @var pending Body bytes received along with the headers
+ * @var left    Number of bytes at pending not used yet
+*/
+typedef struct{
+    int fd;
+    const char* pending;
+    size_t left;
+  } BodyReader;
+
+/**
+ * @brief Receives until buf holds a complete header block.
+ * Headers may arrive split over several segments; whatever buf already
+ * holds is searched first, and bytes read past the blank line stay in buf.
+ *
+ * @param fd  Socket to read from (a receive timeout bounds the wait).
+ * @param buf Bytes received so far; appended to.
+ * @param max Largest header block accepted.
+ * @return Length of the header block including the blank line; 0 if the
+ *         peer closed first; -1 on error (errno EAGAIN on a timeout,
+ *         EMSGSIZE once max bytes came without a blank line)
+ */
+ssize_t body_read_head(int fd, std::string &buf, size_t max);
+
+/**
+ * @brief Lets a client that is still sending see the response before the close.
+ * Closing a socket with unread data makes the kernel send a reset, which
+ * may discard the response in flight (a 413 to an oversized upload). The
+ * write side is shut down and input is read and dropped until the client
+ * closes or ms milliseconds have passed.
+ *
+ * @param fd Client socket, closed by the caller afterwards.
+ * @param ms Longest time spent waiting.
+ */
+void body_linger(int fd, int ms);
+
+/**
+ * @brief Creates the pipe bodies are spliced through.
+ *
+ * @param pipe_fds Receives the read and write ends.
+ * @param size     Capacity to ask for (capped by /proc/sys/fs/pipe-max-size;
+ *                 the default 64 KiB pipe is used if refused).
+ * @return 0 if successful, -1 on error
+ */
+int body_open_pipe(int pipe_fds[2], int size);
+
+/**
+ * @brief Reads one CRLF- (or LF-) terminated line without consuming anything after it.
+ *
+ * @param r    Body source.
+ * @param line Receives the line without its terminator.
+ * @param max  Longest line accepted.
+ * @return true if a whole line was read, false on EOF, error or an overlong line
+ */
+bool body_read_line(BodyReader* r, std::string &line, size_t max);
+
+/**
+ * @brief Parses a chunk-size line: hex digits, then optionally ";" and
+ * extensions, which are ignored. Whitespace is only allowed before the ";".
+ *
+ * @param line Line returned by body_read_line().
+ * @param size Receives the chunk size.
+ * @return true if the line is well formed
+ */
+bool body_chunk_size(const std::string &line, unsigned long long* size);
+
+/**
+ * @brief Moves count body bytes from r to a socket or file.
+ * Buffered bytes are written with send() (or pwrite() for a file), the
+ * rest is spliced through pipe_fds, which is left empty afterwards.
+ *
+ * @param r         Body source.
+ * @param to_fd     Destination socket or file.
+ * @param to_offset File position, advanced as bytes are written; NULL for a socket.
+ * @param count     Number of bytes, or -1 for everything until the sender closes.
+ * @param pipe_fds  Pipe from body_open_pipe().
+ * @param pipe_size Largest single splice, the size the pipe was created with.
+ * @param moved     If not NULL, incremented by every byte written.
+ * @return true if count bytes (or everything up to EOF) were moved
+ */
+bool body_splice(BodyReader* r, int to_fd, off_t* to_offset, off_t count, const int pipe_fds[2], int pipe_size,
+                 off_t* moved);
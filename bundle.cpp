@@ -0,0 +1,358 @@
+#include "bundle.h"
+#include "http_parser.h"
+#include "mime_table.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+const char* map_base = NULL;
+size_t map_size = 0;
+int map_fd = -1;
+const BundleIndexEntry* entries = NULL;
+uint32_t entry_count = 0;
+
+std::atomic<uint64_t> hits(0);
+std::atomic<uint64_t> misses(0);
+std::atomic<uint64_t> gzip_hits(0);
+
+// one file found by the packer
+struct PackFile {
+    std::string key;       // fs_path() form, "./www/..."
+    std::string source;    // where to read it from
+    off_t size;
+    std::string gzip;      // compressed body, empty if not worth it
+};
+
+uint64_t align_up(uint64_t n) {
+    return (n + BUNDLE_ALIGN - 1) / BUNDLE_ALIGN * BUNDLE_ALIGN;
+}
+
+// regular files under dir, recursively; dot files (temporaries, .git) are left out
+bool collect(const std::string &dir, const std::string &uri, std::vector<PackFile> &files) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) return false;
+    bool ok = true;
+    while (dirent* e = readdir(d)) {
+        if (e->d_name[0] == '.') continue;
+        std::string path = dir + "/" + e->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) < 0) continue;
+        if (S_ISDIR(st.st_mode)) ok = collect(path, uri + "/" + e->d_name, files) && ok;
+        else if (S_ISREG(st.st_mode)) files.push_back({"./www" + uri + "/" + e->d_name, path, st.st_size, ""});
+    }
+    closedir(d);
+    return ok;
+}
+
+bool read_all(const std::string &path, std::string &out, off_t size) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    out.resize(size);
+    ssize_t n = size ? pread(fd, &out[0], size, 0) : 0;
+    close(fd);
+    return n == size;
+}
+
+// gzip (RFC 1952) wrapper around deflate at the best compression level
+bool gzip(const std::string &in, std::string &out) {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+    out.resize(deflateBound(&z, in.size()) + 32);
+    z.next_in = (Bytef*)in.data();
+    z.avail_in = in.size();
+    z.next_out = (Bytef*)&out[0];
+    z.avail_out = out.size();
+    int rc = deflate(&z, Z_FINISH);
+    out.resize(z.total_out);
+    deflateEnd(&z);
+    return rc == Z_STREAM_END;
+}
+
+bool write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// pads the output to the next page boundary, where the next body starts
+bool pad(int out_fd, uint64_t* at) {
+    static const char zeros[BUNDLE_ALIGN] = {0};
+    uint64_t start = align_up(*at);
+    if (!write_all(out_fd, zeros, start - *at)) return false;
+    *at = start;
+    return true;
+}
+
+// appends a file's body without reading it into memory
+bool copy_file(int out_fd, uint64_t* at, const std::string &source, off_t size) {
+    int fd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || !pad(out_fd, at)) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    off_t offset = 0;
+    while (offset < size) {
+        ssize_t n = sendfile(out_fd, fd, &offset, size - offset);
+        if (n <= 0) break;
+    }
+    close(fd);
+    *at += offset;
+    return offset == size;
+}
+
+// one NUL-terminated string in the string area; returns its offset
+uint64_t add_string(std::string &strings, uint64_t base, const std::string &s) {
+    uint64_t offset = base + strings.size();
+    strings.append(s);
+    strings.push_back('\0');
+    return offset;
+}
+
+// [offset, offset + len) lies inside the mapping and, for strings, ends in a NUL
+bool in_map(uint64_t offset, uint64_t len, bool nul) {
+    if (offset > map_size || len > map_size - offset) return false;
+    return !nul || (offset + len < map_size && map_base[offset + len] == '\0');
+}
+
+bool valid_string(uint64_t offset) {
+    return offset < map_size && memchr(map_base + offset, '\0', map_size - offset) != NULL;
+}
+
+bool valid_variant(const BundleVariant &v) {
+    if (v.head_len == 0) return v.body_len == 0;
+    return in_map(v.head_offset, v.head_len, true) && v.body_offset % BUNDLE_ALIGN == 0 &&
+           in_map(v.body_offset, v.body_len, false);
+}
+
+int compare_path(const BundleIndexEntry &e, const char* path, size_t len) {
+    int c = memcmp(map_base + e.path_offset, path, std::min((size_t)e.path_len, len));
+    if (c != 0) return c;
+    return e.path_len < len ? -1 : e.path_len > len ? 1 : 0;
+}
+
+bool valid_bundle(const char* base, size_t size) {
+    if (size < sizeof(BundleHeader)) return false;
+    const BundleHeader* h = (const BundleHeader*)base;
+    if (memcmp(h->magic, BUNDLE_MAGIC, sizeof(h->magic)) != 0 || h->version != BUNDLE_VERSION) return false;
+    if (h->size != size || h->index_offset % alignof(BundleIndexEntry) != 0) return false;
+    if (!in_map(h->index_offset, (uint64_t)h->count * sizeof(BundleIndexEntry), false)) return false;
+
+    const BundleIndexEntry* index = (const BundleIndexEntry*)(base + h->index_offset);
+    for (uint32_t i = 0; i < h->count; i++) {
+        const BundleIndexEntry &e = index[i];
+        if (!in_map(e.path_offset, e.path_len, true) || !valid_string(e.mime_offset) ||
+            !valid_string(e.cache_control_offset) || e.identity.head_len == 0 ||
+            !valid_variant(e.identity) || !valid_variant(e.gzip)) {
+            return false;
+        }
+        // binary search needs strictly increasing paths
+        if (i > 0 && compare_path(index[i - 1], base + e.path_offset, e.path_len) >= 0) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int bundle_pack(const char* root, const char* out){
+  std::vector<PackFile> files;
+  if (!collect(root, "", files)) return -1;
+  std::sort(files.begin(), files.end(), [](const PackFile &a, const PackFile &b){ return a.key < b.key; });
+
+  // compressed copies first: their sizes go into the headers
+  for (PackFile &f : files){
+    const MimeEntry* info = mime_lookup(f.key);
+    if (!info || !info->charset || (uint64_t)f.size < BUNDLE_GZIP_MIN) continue;
+    std::string body, packed;
+    if (!read_all(f.source, body, f.size)) return -1;
+    if (gzip(body, packed) && packed.size() <= f.size * BUNDLE_GZIP_RATIO) f.gzip.swap(packed);
+  }
+
+  // layout: header, index, strings, then every body on its own page boundary
+  uint64_t index_offset = sizeof(BundleHeader);
+  uint64_t strings_offset = index_offset + files.size() * sizeof(BundleIndexEntry);
+  std::vector<BundleIndexEntry> index(files.size());
+  std::string strings;
+  for (size_t i = 0; i < files.size(); i++){
+    const PackFile &f = files[i];
+    std::string mime = guess_mime(f.key);
+    const char* cache_control = guess_cache_control(f.key);
+    std::string head = serialize_headers(200, "OK", mime, f.size, cache_control);
+    std::string gzip_head;
+    if (!f.gzip.empty()){
+      // caches must keep the two representations apart
+      head.insert(head.size() - 2, "Vary: Accept-Encoding\r\n");
+      gzip_head = serialize_headers(200, "OK", mime, f.gzip.size(), cache_control);
+      gzip_head.insert(gzip_head.size() - 2, "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n");
+    }
+    BundleIndexEntry &e = index[i];
+    memset(&e, 0, sizeof(e));
+    e.path_offset = add_string(strings, strings_offset, f.key);
+    e.path_len = f.key.size();
+    e.mime_offset = add_string(strings, strings_offset, mime);
+    e.cache_control_offset = add_string(strings, strings_offset, cache_control);
+    e.identity.head_offset = add_string(strings, strings_offset, head);
+    e.identity.head_len = head.size();
+    if (!f.gzip.empty()){
+      e.gzip.head_offset = add_string(strings, strings_offset, gzip_head);
+      e.gzip.head_len = gzip_head.size();
+    }
+  }
+
+  uint64_t at = strings_offset + strings.size();
+  for (size_t i = 0; i < files.size(); i++){
+    at = align_up(at);
+    index[i].identity.body_offset = at;
+    index[i].identity.body_len = files[i].size;
+    at += files[i].size;
+    if (!files[i].gzip.empty()){
+      at = align_up(at);
+      index[i].gzip.body_offset = at;
+      index[i].gzip.body_len = files[i].gzip.size();
+      at += files[i].gzip.size();
+    }
+  }
+
+  BundleHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+  header.version = BUNDLE_VERSION;
+  header.count = files.size();
+  header.index_offset = index_offset;
+  header.size = at;
+
+  // written beside the target and renamed, so servers never map a half-written bundle
+  std::string tmp = std::string(out) + ".tmp";
+  int out_fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (out_fd < 0) return -1;
+  uint64_t written = strings_offset + strings.size();
+  bool ok = write_all(out_fd, (const char*)&header, sizeof(header)) &&
+            write_all(out_fd, (const char*)index.data(), index.size() * sizeof(BundleIndexEntry)) &&
+            write_all(out_fd, strings.data(), strings.size());
+  for (size_t i = 0; ok && i < files.size(); i++){
+    ok = copy_file(out_fd, &written, files[i].source, files[i].size);
+    if (ok && !files[i].gzip.empty()){
+      ok = pad(out_fd, &written) && write_all(out_fd, files[i].gzip.data(), files[i].gzip.size());
+      written += files[i].gzip.size();
+    }
+  }
+  ok = ok && written == at;
+  if (close(out_fd) < 0 || !ok || rename(tmp.c_str(), out) < 0){
+    int saved = errno;
+    unlink(tmp.c_str());
+    errno = saved ? saved : EIO;
+    return -1;
+  }
+  return (int)files.size();
+}
+
+int bundle_init(int argc, char** argv){
+  const char* path = NULL;
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--bundle") == 0) path = argv[++i];
+  }
+  if (!path) return 0;
+  if (bundle_open(path) < 0){
+    perror("Failed to map the bundle");
+    return -1;
+  }
+  http_register_stats("bundle", bundle_write_stats, NULL);
+  printf("Serving %u files from %s (%zu bytes mapped)\n", entry_count, path, map_size);
+  return 0;
+}
+
+int bundle_open(const char* path){
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  struct stat st;
+  if (fstat(fd, &st) < 0){
+    close(fd);
+    return -1;
+  }
+  void* base = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  if (base == MAP_FAILED){
+    if (st.st_size == 0) errno = EINVAL;
+    close(fd);
+    return -1;
+  }
+
+  const char* old_base = map_base;
+  size_t old_size = map_size;
+  map_base = (const char*)base;
+  map_size = st.st_size;
+  if (!valid_bundle(map_base, map_size)){
+    munmap(base, st.st_size);
+    close(fd);
+    map_base = old_base;
+    map_size = old_size;
+    errno = EINVAL;
+    return -1;
+  }
+  if (old_base){
+    munmap((void*)old_base, old_size);
+    close(map_fd);
+  }
+
+  const BundleHeader* h = (const BundleHeader*)map_base;
+  entries = (const BundleIndexEntry*)(map_base + h->index_offset);
+  entry_count = h->count;
+  map_fd = fd;
+  // the index and headers are touched by every request; bodies page in as they are sent
+  uint64_t meta_end = entry_count ? entries[0].identity.body_offset : map_size;
+  madvise((void*)map_base, meta_end, MADV_WILLNEED);
+  return 0;
+}
+
+const BundleIndexEntry* bundle_lookup(const std::string &path){
+  if (!map_base) return NULL;
+  size_t lo = 0, hi = entry_count;
+  while (lo < hi){
+    size_t mid = (lo + hi) / 2;
+    int c = compare_path(entries[mid], path.data(), path.size());
+    if (c == 0){
+      hits.fetch_add(1, std::memory_order_relaxed);
+      return &entries[mid];
+    }
+    if (c < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  misses.fetch_add(1, std::memory_order_relaxed);
+  return NULL;
+}
+
+const BundleVariant* bundle_variant(const BundleIndexEntry* entry, bool gzip_ok){
+  if (gzip_ok && entry->gzip.head_len){
+    gzip_hits.fetch_add(1, std::memory_order_relaxed);
+    return &entry->gzip;
+  }
+  return &entry->identity;
+}
+
+const char* bundle_data(uint64_t offset){
+  return map_base + offset;
+}
+
+int bundle_fd(){
+  return map_fd;
+}
+
+void bundle_write_stats(std::ostream &out, void*){
+  out << "{\"files\": " << entry_count << ", \"bytes\": " << map_size << ", \"hits\": " << hits.load()
+      << ", \"misses\": " << misses.load() << ", \"gzip\": " << gzip_hits.load() << "}";
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * The docroot packed into one memory-mapped file.
+ *
+ * pack_www (bundle_pack()) turns a www/ tree into a single archive: a
+ * path index sorted by the fs_path() form of each file ("./www/a.css"),
+ * each file's MIME type and complete HTTP/1 response headers, and its body
+ * at a page-aligned offset. Text files that compress well also get a
+ * gzip-compressed copy with its own headers, served to clients that send
+ * "Accept-Encoding: gzip".
+ *
+ * With --bundle FILE a server maps the archive once at startup and answers
+ * every path in it with a binary search over the mapped index: no open(),
+ * no stat(), no page-cache misses on inodes. Large bodies go out with
+ * sendfile() from the archive itself, small ones are appended to the
+ * headers as for loose files. Paths not in the bundle fall through to
+ * ./www, so uploads and files added after packing are still served.
+ *
+ * The archive is written in the packing machine's byte order. Repacking
+ * replaces it with rename(), so a running server keeps the copy it mapped.
+ */
+
+const char BUNDLE_MAGIC[8] = {'W', 'W', 'W', 'B', 'N', 'D', 'L', '1'};
+const uint32_t BUNDLE_VERSION = 1;
+// bodies start on page boundaries, so each one maps and pages in on its own
+const uint64_t BUNDLE_ALIGN = 4096;
+// text bodies smaller than this are not worth a compressed copy
+const uint64_t BUNDLE_GZIP_MIN = 256;
+// a compressed copy is kept only if it is at most this fraction of the original
+const double BUNDLE_GZIP_RATIO = 0.9;
+
+/**
+ * @struct BundleHeader
+ * @brief First bytes of a bundle file
+ * @var magic        BUNDLE_MAGIC
+ * @var version      BUNDLE_VERSION
+ * @var count        Number of index entries
+ * @var index_offset Offset of the first BundleIndexEntry
+ * @var size         Total file size, to detect truncation
+*/
+typedef struct{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t index_offset;
+    uint64_t size;
+  } BundleHeader;
+
+/**
+ * @struct BundleVariant
+ * @brief One servable representation of a file
+ * @var head_offset Offset of the HTTP/1 response headers (NUL-terminated)
+ * @var head_len    Length of the headers, blank line included
+ * @var body_offset Offset of the body, a multiple of BUNDLE_ALIGN
+ * @var body_len    Length of the body; 0 with head_len 0 if the variant does not exist
+*/
+typedef struct BundleVariant{
+    uint64_t head_offset;
+    uint64_t head_len;
+    uint64_t body_offset;
+    uint64_t body_len;
+  } BundleVariant;
+
+/**
+ * @struct BundleIndexEntry
+ * @brief One file of the bundle, in path order
+ * @var path_offset          Offset of the fs_path() form of the file's path (NUL-terminated)
+ * @var path_len             Length of the path
+ * @var mime_offset          Offset of the Content-Type value (NUL-terminated)
+ * @var cache_control_offset Offset of the Cache-Control value (NUL-terminated)
+ * @var identity             The file as it is on disk
+ * @var gzip                 The file gzip-compressed, if that was worth it
+*/
+typedef struct{
+    uint64_t path_offset;
+    uint64_t path_len;
+    uint64_t mime_offset;
+    uint64_t cache_control_offset;
+    BundleVariant identity;
+    BundleVariant gzip;
+  } BundleIndexEntry;
+
+/**
+ * @brief Packs a directory tree into a bundle file.
+ * Dot files and anything that is not a regular file are skipped. The
+ * bundle is written next to out and renamed into place when complete.
+ *
+ * @param root Directory to pack (normally ./www).
+ * @param out  Path of the bundle file to create or replace.
+ * @return Number of files packed, -1 on error (errno set)
+ */
+int bundle_pack(const char* root, const char* out);
+
+/**
+ * @brief Maps a bundle if the command line asks for it ("--bundle FILE").
+ *
+ * @param argc main()'s argc.
+ * @param argv main()'s argv.
+ * @return 0 if successful (or no bundle requested), -1 if the file is missing or invalid
+ */
+int bundle_init(int argc, char** argv);
+
+/**
+ * @brief Maps a bundle directly (tests, embedding), replacing any mapped before.
+ * Every offset in the file is checked against its size first. Call before
+ * serving: lookups do not synchronize with a replacement.
+ *
+ * @param path Bundle file written by bundle_pack().
+ * @return 0 if successful, -1 on error (errno set, EINVAL for a malformed file)
+ */
+int bundle_open(const char* path);
+
+/**
+ * @brief Finds a file in the mapped bundle.
+ *
+ * @param path Result of fs_path() for the request target.
+ * @return Entry in the mapping, or NULL if there is no bundle or no such file
+ */
+const BundleIndexEntry* bundle_lookup(const std::string &path);
+
+/**
+ * @brief Picks the representation to send.
+ *
+ * @param entry   Entry returned by bundle_lookup().
+ * @param gzip_ok Whether the client accepts gzip content coding.
+ * @return The gzip variant if there is one and the client takes it, the identity one otherwise
+ */
+const BundleVariant* bundle_variant(const BundleIndexEntry* entry, bool gzip_ok);
+
+/**
+ * @brief Address of a bundle offset in the mapping.
+ *
+ * @param offset Offset taken from an index entry.
+ * @return Pointer into the mapping, valid until another bundle is opened
+ */
+const char* bundle_data(uint64_t offset);
+
+/**
+ * @brief The mapped bundle's file descriptor, for sendfile() of bodies.
+ *
+ * @return Open read-only descriptor, -1 if no bundle is mapped
+ */
+int bundle_fd();
+
+/**
+ * @brief Writes bundle counters as JSON (the "bundle" /__stats section).
+ *
+ * @param out Stream receiving a JSON object.
+ * @param ctx Unused.
+ */
+void bundle_write_stats(std::ostream &out, void* ctx);
@@ -0,0 +1,174 @@
+#include "docroot_watch.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// events that change what a cached path would serve
+const uint32_t WATCH_MASK = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                            IN_CREATE | IN_DELETE | IN_DELETE_SELF |
+                            IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF;
+
+struct Subscriber {
+    watch_callback cb;
+    void* ctx;
+};
+
+std::vector<Subscriber> subscribers;
+std::unordered_map<int, std::string> wd_paths; // watch descriptor -> directory
+std::string root_path;
+
+int inotify_fd = -1;
+int stop_pipe[2] = {-1, -1};
+pthread_t watcher;
+std::atomic<bool> active(false);
+
+void notify(const std::string &path, bool is_dir) {
+    for (const Subscriber &s : subscribers) s.cb(path, is_dir, s.ctx);
+}
+
+// adds a watch on dir and every directory below it
+void watch_tree(const std::string &dir) {
+    int wd = inotify_add_watch(inotify_fd, dir.c_str(), WATCH_MASK | IN_ONLYDIR);
+    if (wd < 0) {
+        perror("inotify_add_watch");
+        return;
+    }
+    wd_paths[wd] = dir;
+
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    while (dirent* ent = readdir(d)) {
+        if (ent->d_type != DT_DIR) continue;
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        watch_tree(dir + "/" + ent->d_name);
+    }
+    closedir(d);
+}
+
+void handle_event(const inotify_event* ev) {
+    if (ev->mask & IN_Q_OVERFLOW) {
+        // events were lost, nothing cached can be trusted any more
+        notify(root_path, true);
+        return;
+    }
+
+    auto it = wd_paths.find(ev->wd);
+    if (it == wd_paths.end()) return;
+
+    if (ev->mask & IN_IGNORED) {
+        // the directory is gone and the kernel dropped the watch
+        wd_paths.erase(it);
+        return;
+    }
+
+    std::string path = it->second;
+    if (ev->len > 0) path += std::string("/") + ev->name;
+    bool is_dir = (ev->mask & IN_ISDIR) || (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF));
+
+    // a directory moved or created under us needs its own watches
+    if (is_dir && (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+        watch_tree(path);
+    }
+
+    notify(path, is_dir);
+}
+
+void* watcher_loop(void*) {
+    // aligned as inotify_event requires
+    alignas(inotify_event) char buf[16 * 1024];
+
+    pollfd fds[2];
+    fds[0].fd = inotify_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stop_pipe[0];
+    fds[1].events = POLLIN;
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if (fds[1].revents) break;
+
+        ssize_t n = read(inotify_fd, buf, sizeof(buf));
+        if (n <= 0) continue;
+
+        // one read can return many variable-length events back to back
+        for (char* p = buf; p < buf + n; ) {
+            const inotify_event* ev = (const inotify_event*)p;
+            handle_event(ev);
+            p += sizeof(inotify_event) + ev->len;
+        }
+    }
+    return NULL;
+}
+
+} // namespace
+
+void docroot_watch_subscribe(watch_callback cb, void* ctx){
+  subscribers.push_back({cb, ctx});
+}
+
+int docroot_watch_start(const char* root){
+  if (active) return 0;
+
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd < 0){
+    perror("inotify_init1");
+    return -1;
+  }
+  if (pipe2(stop_pipe, O_CLOEXEC) < 0){
+    perror("pipe2");
+    close(inotify_fd);
+    inotify_fd = -1;
+    return -1;
+  }
+
+  root_path = root;
+  while (root_path.size() > 1 && root_path.back() == '/') root_path.pop_back();
+  watch_tree(root_path);
+  if (wd_paths.empty()){
+    docroot_watch_stop();
+    return -1;
+  }
+
+  if (pthread_create(&watcher, NULL, watcher_loop, NULL) != 0){
+    perror("Failed to start docroot watcher");
+    docroot_watch_stop();
+    return -1;
+  }
+  active = true;
+  return 0;
+}
+
+void docroot_watch_stop(){
+  if (active){
+    // wake the watcher out of poll() and wait for it
+    char c = 0;
+    if (write(stop_pipe[1], &c, 1) < 0) perror("write");
+    pthread_join(watcher, NULL);
+    active = false;
+  }
+
+  if (inotify_fd >= 0) close(inotify_fd);
+  if (stop_pipe[0] >= 0) close(stop_pipe[0]);
+  if (stop_pipe[1] >= 0) close(stop_pipe[1]);
+  inotify_fd = stop_pipe[0] = stop_pipe[1] = -1;
+  wd_paths.clear();
+}
+
+bool docroot_watch_active(){
+  return active;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @brief Called by the watcher thread whenever something under the docroot changes.
+ *
+ * @param path   Path of the changed entry, spelled the same way fs_path() spells it
+ *               (e.g. "./www/index.html").
+ * @param is_dir True if a whole directory changed (moved, deleted or the event
+ *               queue overflowed); every cached path below it is stale.
+ * @param ctx    The pointer given to docroot_watch_subscribe().
+ */
+typedef void (*watch_callback)(const std::string &path, bool is_dir, void* ctx);
+
+/**
+ * @brief Registers a cache to be told about changes under the docroot.
+ * Subscribe before docroot_watch_start(); callbacks run on the watcher thread.
+ *
+ * @param cb  Function invoked for every change.
+ * @param ctx Opaque pointer handed back to cb.
+ */
+void docroot_watch_subscribe(watch_callback cb, void* ctx);
+
+/**
+ * @brief Starts a background inotify watcher over a directory tree.
+ * Every directory below root is watched, and new directories are picked up
+ * as they are created, so deploys are seen within milliseconds.
+ *
+ * @param root Docroot to watch (e.g. "./www").
+ *
+ * @return 0 if successful, -1 if inotify is unavailable
+ */
+int docroot_watch_start(const char* root);
+
+/**
+ * @brief Stops the watcher thread and closes the inotify descriptor.
+ */
+void docroot_watch_stop();
+
+/**
+ * @brief Reports whether a watcher is currently running.
+ * While it is, cached metadata can be trusted without re-checking the disk.
+ *
+ * @return true if docroot_watch_start() succeeded and has not been stopped
+ */
+bool docroot_watch_active();
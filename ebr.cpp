@@ -0,0 +1,149 @@
+#include "ebr.h"
+#include <linux/membarrier.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Retired {
+    void* ptr;
+    void (*free_fn)(void*);
+    uint64_t epoch;
+};
+
+// registry of thread slots and the objects waiting to be freed
+pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+EbrThread* threads = NULL;
+std::vector<Retired> limbo;
+
+std::atomic<uint64_t> global_epoch(1);
+
+// asks the kernel for expedited membarrier once, before any reader runs
+bool register_membarrier() {
+    long cmds = syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+    if (cmds < 0 || !(cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) return false;
+    return syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+}
+const bool use_membarrier = register_membarrier();
+
+thread_local EbrThread* self = NULL;
+
+// gives the slot back when a thread that never unregistered exits
+struct ExitGuard {
+    bool armed = false;
+    ~ExitGuard() { if (armed) ebr_unregister_thread(); }
+};
+thread_local ExitGuard exit_guard;
+
+// orders every reader's slot store before the scan that follows
+void reader_barrier() {
+    if (use_membarrier) syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+    else std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+// advances the epoch if no reader lags behind; caller holds registry_lock
+uint64_t try_advance() {
+    uint64_t epoch = global_epoch.load(std::memory_order_relaxed);
+    reader_barrier();
+    for (EbrThread* t = threads; t; t = t->next) {
+        if (!t->in_use) continue;
+        uint64_t s = t->state.load(std::memory_order_acquire);
+        if ((s & 1) && (s >> 1) != epoch) return epoch;
+    }
+    global_epoch.store(epoch + 1, std::memory_order_release);
+    return epoch + 1;
+}
+
+} // namespace
+
+void ebr_register_thread(){
+  if (self) return;
+
+  pthread_mutex_lock(&registry_lock);
+  EbrThread* slot = threads;
+  while (slot && slot->in_use) slot = slot->next;
+  if (!slot){
+    // slots are never freed, so a scan never touches released memory
+    slot = new EbrThread();
+    slot->next = threads;
+    threads = slot;
+  }
+  slot->state.store(0, std::memory_order_relaxed);
+  slot->depth = 0;
+  slot->in_use = true;
+  pthread_mutex_unlock(&registry_lock);
+
+  self = slot;
+  exit_guard.armed = true;
+}
+
+void ebr_unregister_thread(){
+  if (!self) return;
+
+  pthread_mutex_lock(&registry_lock);
+  self->state.store(0, std::memory_order_release);
+  self->in_use = false;
+  pthread_mutex_unlock(&registry_lock);
+
+  self = NULL;
+  exit_guard.armed = false;
+}
+
+void ebr_enter(){
+  if (!self) ebr_register_thread();
+  if (self->depth++ > 0) return;
+
+  uint64_t epoch = global_epoch.load(std::memory_order_relaxed);
+  self->state.store((epoch << 1) | 1, std::memory_order_relaxed);
+  // the writer's membarrier() supplies the store-load barrier on our behalf
+  if (use_membarrier) std::atomic_signal_fence(std::memory_order_seq_cst);
+  else std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void ebr_exit(){
+  if (--self->depth > 0) return;
+  self->state.store(0, std::memory_order_release);
+}
+
+void ebr_retire(void* ptr, void (*free_fn)(void*)){
+  pthread_mutex_lock(&registry_lock);
+  limbo.push_back({ptr, free_fn, global_epoch.load(std::memory_order_relaxed)});
+  bool collect = limbo.size() >= EBR_COLLECT_BATCH;
+  pthread_mutex_unlock(&registry_lock);
+
+  if (collect) ebr_collect();
+}
+
+size_t ebr_collect(){
+  std::vector<Retired> ready;
+
+  pthread_mutex_lock(&registry_lock);
+  uint64_t epoch = try_advance();
+  // readers still inside began at epoch - 1 at the earliest
+  size_t kept = 0;
+  for (const Retired &r : limbo){
+    if (r.epoch + 2 <= epoch) ready.push_back(r);
+    else limbo[kept++] = r;
+  }
+  limbo.resize(kept);
+  pthread_mutex_unlock(&registry_lock);
+
+  for (const Retired &r : ready) r.free_fn(r.ptr);
+  return ready.size();
+}
+
+void ebr_synchronize(){
+  while (ebr_pending() > 0){
+    if (ebr_collect() == 0) sched_yield();
+  }
+}
+
+size_t ebr_pending(){
+  pthread_mutex_lock(&registry_lock);
+  size_t n = limbo.size();
+  pthread_mutex_unlock(&registry_lock);
+  return n;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Epoch-based reclamation (EBR) for read-mostly shared structures.
+ *
+ * Readers bracket every access with ebr_enter() / ebr_exit(). Entering
+ * publishes the global epoch in the thread's own slot with a plain store
+ * (no lock, no atomic read-modify-write); the matching full barrier is paid
+ * by the writer through membarrier(2) instead of by every reader.
+ *
+ * Writers unlink an object so no new reader can reach it, then hand it to
+ * ebr_retire(). The epoch only advances once every reader inside a section
+ * has seen the current one, and an object is freed two epochs after it was
+ * retired, when no reader that could still hold it is left.
+ *
+ * Threads register on their first ebr_enter(); long-lived workers call
+ * ebr_register_thread() up front so the first request does not pay for it.
+ */
+
+// retired objects collected before a writer tries to advance the epoch
+const size_t EBR_COLLECT_BATCH = 32;
+
+/**
+  * @struct EbrThread
+  * @brief Epoch slot of one registered thread, alone on its cache line
+  * @var state  (epoch << 1) | 1 while inside a read section, 0 outside
+  * @var depth  Nesting level of ebr_enter() calls (owner thread only)
+  * @var in_use Slot belongs to a live thread (changed under the registry lock)
+  * @var next   Next slot in the registry
+*/
+typedef struct alignas(64) EbrThread{
+    std::atomic<uint64_t> state;
+    int depth;
+    bool in_use;
+    EbrThread* next;
+  } EbrThread;
+
+/**
+ * @brief Gives the calling thread an epoch slot.
+ * Optional: ebr_enter() registers on first use. Calling it again is a no-op.
+ */
+void ebr_register_thread();
+
+/**
+ * @brief Releases the calling thread's slot for reuse.
+ * Must not be called inside a read section. Threads that never call it
+ * are unregistered when they exit.
+ */
+void ebr_unregister_thread();
+
+/**
+ * @brief Starts a read section; objects reachable now stay allocated until ebr_exit().
+ * Sections nest and must not block for long: they hold back reclamation.
+ */
+void ebr_enter();
+
+/**
+ * @brief Ends the read section started by the matching ebr_enter().
+ */
+void ebr_exit();
+
+/**
+ * @brief Frees an object once no reader can hold it any more.
+ * Call after the object has been unlinked from every shared structure.
+ *
+ * @param ptr     Object to free.
+ * @param free_fn Called with ptr once it is safe.
+ */
+void ebr_retire(void* ptr, void (*free_fn)(void*));
+
+/**
+ * @brief Tries to advance the epoch and frees whatever became safe.
+ * ebr_retire() calls it every EBR_COLLECT_BATCH objects.
+ *
+ * @return Number of objects freed
+ */
+size_t ebr_collect();
+
+/**
+ * @brief Waits until every object retired so far has been freed.
+ * Must not be called inside a read section (it would wait for itself).
+ */
+void ebr_synchronize();
+
+/** @brief Number of retired objects not freed yet. */
+size_t ebr_pending();
@@ -0,0 +1,228 @@
+#include "fd_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+long long now_ms() {
+    // CLOCK_MONOTONIC is served from the vDSO, so this is not a real syscall
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// opens a path and fills in a fresh entry (negative if the open fails)
+FdCacheEntry* open_entry(const std::string &path) {
+    FdCacheEntry* e = new FdCacheEntry();
+    e->path = path;
+    e->fd = -1;
+    e->err = 0;
+    e->refcount = 0;
+    e->expires_ms = 0;
+    e->prev = e->next = NULL;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        e->err = errno;
+        return e;
+    }
+    // only regular files are servable, a directory is treated as missing
+    if (fstat(fd, &e->st) < 0 || !S_ISREG(e->st.st_mode)) {
+        close(fd);
+        e->err = ENOENT;
+        return e;
+    }
+    e->fd = fd;
+    return e;
+}
+
+void free_entry(FdCacheEntry* e) {
+    if (e->fd >= 0) close(e->fd);
+    delete e;
+}
+
+// true if the file on disk is still the one the entry describes
+bool still_valid(const FdCacheEntry* e) {
+    struct stat st;
+    if (stat(e->path.c_str(), &st) < 0) {
+        // still missing -> negative entry stays valid
+        return e->fd < 0;
+    }
+    if (e->fd < 0) return false;
+    return st.st_dev == e->st.st_dev && st.st_ino == e->st.st_ino &&
+           st.st_size == e->st.st_size &&
+           st.st_mtim.tv_sec == e->st.st_mtim.tv_sec &&
+           st.st_mtim.tv_nsec == e->st.st_mtim.tv_nsec;
+}
+
+// LRU list helpers, caller holds cache->lock
+void lru_unlink(FdCache* cache, FdCacheEntry* e) {
+    if (e->prev) e->prev->next = e->next; else cache->lru_head = e->next;
+    if (e->next) e->next->prev = e->prev; else cache->lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+void lru_push_front(FdCache* cache, FdCacheEntry* e) {
+    e->prev = NULL;
+    e->next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->prev = e;
+    cache->lru_head = e;
+    if (!cache->lru_tail) cache->lru_tail = e;
+}
+
+// drops the cache's own reference; returns the entry if it must be freed
+FdCacheEntry* remove_locked(FdCache* cache, FdCacheEntry* e) {
+    cache->map.erase(e->path);
+    lru_unlink(cache, e);
+    return (--e->refcount == 0) ? e : NULL;
+}
+
+} // namespace
+
+int fd_cache_init(FdCache* cache, size_t capacity, int ttl_ms){
+  cache->lru_head = NULL;
+  cache->lru_tail = NULL;
+  cache->capacity = capacity > 0 ? capacity : 1;
+  cache->ttl_ms = ttl_ms;
+  cache->generation = 0;
+  cache->hits = cache->misses = cache->negative_hits = 0;
+  cache->revalidations = cache->evictions = 0;
+
+  if (pthread_mutex_init(&cache->lock, NULL) != 0){
+    perror("Failed to init fd cache lock");
+    return -1;
+  }
+  return 0;
+}
+
+void fd_cache_destroy(FdCache* cache){
+  pthread_mutex_lock(&cache->lock);
+  FdCacheEntry* e = cache->lru_head;
+  while (e){
+    FdCacheEntry* next = e->next;
+    free_entry(e);
+    e = next;
+  }
+  cache->map.clear();
+  cache->lru_head = cache->lru_tail = NULL;
+  pthread_mutex_unlock(&cache->lock);
+
+  pthread_mutex_destroy(&cache->lock);
+}
+
+FdCacheEntry* fd_cache_acquire(FdCache* cache, const std::string &path){
+  pthread_mutex_lock(&cache->lock);
+
+  auto it = cache->map.find(path);
+  if (it != cache->map.end()){
+    FdCacheEntry* e = it->second;
+    // within the TTL the entry is trusted without touching the filesystem
+    long long now = now_ms();
+    bool in_ttl = now < e->expires_ms;
+    if (in_ttl || still_valid(e)){
+      if (!in_ttl){
+        cache->revalidations++;
+        e->expires_ms = now + cache->ttl_ms;
+      }
+      if (e->fd < 0) cache->negative_hits++; else cache->hits++;
+      lru_unlink(cache, e);
+      lru_push_front(cache, e);
+      e->refcount++;
+      pthread_mutex_unlock(&cache->lock);
+      return e;
+    }
+    // file changed on disk, forget the old entry and reopen below
+    FdCacheEntry* dead = remove_locked(cache, e);
+    if (dead) free_entry(dead);
+  }
+  cache->misses++;
+  unsigned long generation = cache->generation;
+  pthread_mutex_unlock(&cache->lock);
+
+  // open outside the lock so a slow path walk does not stall other workers
+  FdCacheEntry* fresh = open_entry(path);
+
+  pthread_mutex_lock(&cache->lock);
+  it = cache->map.find(path);
+  if (it != cache->map.end()){
+    // another worker inserted it while we were opening, use theirs
+    FdCacheEntry* e = it->second;
+    e->refcount++;
+    pthread_mutex_unlock(&cache->lock);
+    free_entry(fresh);
+    return e;
+  }
+  if (cache->generation != generation){
+    // the path may have changed after our open(), e.g. a negative entry for
+    // a file that was just created; serve it this once, cache nothing
+    fresh->refcount = 1;
+    pthread_mutex_unlock(&cache->lock);
+    return fresh;
+  }
+
+  FdCacheEntry* victim = NULL;
+  if (cache->map.size() >= cache->capacity && cache->lru_tail){
+    cache->evictions++;
+    victim = remove_locked(cache, cache->lru_tail);
+  }
+
+  fresh->expires_ms = now_ms() + cache->ttl_ms;
+  fresh->refcount = 2; // one for the cache, one for the caller
+  cache->map[path] = fresh;
+  lru_push_front(cache, fresh);
+  pthread_mutex_unlock(&cache->lock);
+
+  if (victim) free_entry(victim);
+  return fresh;
+}
+
+void fd_cache_release(FdCache* cache, FdCacheEntry* entry){
+  pthread_mutex_lock(&cache->lock);
+  bool last = (--entry->refcount == 0);
+  pthread_mutex_unlock(&cache->lock);
+
+  if (last) free_entry(entry);
+}
+
+void fd_cache_invalidate(FdCache* cache, const std::string &path){
+  pthread_mutex_lock(&cache->lock);
+  cache->generation++;
+  FdCacheEntry* dead = NULL;
+  auto it = cache->map.find(path);
+  if (it != cache->map.end()){
+    dead = remove_locked(cache, it->second);
+  }
+  pthread_mutex_unlock(&cache->lock);
+
+  if (dead) free_entry(dead);
+}
+
+void fd_cache_invalidate_prefix(FdCache* cache, const std::string &prefix){
+  std::vector<FdCacheEntry*> dead;
+  std::string dir = prefix + "/";
+
+  pthread_mutex_lock(&cache->lock);
+  cache->generation++;
+  FdCacheEntry* e = cache->lru_head;
+  while (e){
+    FdCacheEntry* next = e->next;
+    if (e->path == prefix || e->path.compare(0, dir.size(), dir) == 0){
+      FdCacheEntry* d = remove_locked(cache, e);
+      if (d) dead.push_back(d);
+    }
+    e = next;
+  }
+  pthread_mutex_unlock(&cache->lock);
+
+  for (FdCacheEntry* d : dead) free_entry(d);
+}
+
+void fd_cache_set_ttl(FdCache* cache, int ttl_ms){
+  pthread_mutex_lock(&cache->lock);
+  cache->ttl_ms = ttl_ms;
+  pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include <string>
+#include <unordered_map>
+
+// max number of paths kept in the cache (positive and negative entries)
+const int FD_CACHE_CAPACITY = 256;
+// how long a cached entry is trusted before it is re-checked with stat()
+const int FD_CACHE_TTL_MS = 1000;
+
+/**
+  * @struct FdCacheEntry
+  * @brief One cached path: an open file descriptor plus its stat() result
+  * @var path       Resolved filesystem path (the cache key)
+  * @var fd         Open read-only descriptor, or -1 for a negative (404) entry
+  * @var err        errno from the failed open for negative entries, 0 otherwise
+  * @var st         stat() result taken when the descriptor was opened
+  * @var refcount   Number of users holding the entry (the cache itself counts as one)
+  * @var expires_ms Monotonic time after which the entry must be revalidated
+  * @var prev/next  Links in the LRU list (head = most recently used)
+*/
+typedef struct FdCacheEntry{
+    std::string path;
+    int fd;
+    int err;
+    struct stat st;
+
+    int refcount;
+    long long expires_ms;
+
+    FdCacheEntry* prev;
+    FdCacheEntry* next;
+  } FdCacheEntry;
+
+/**
+  * @struct FdCache
+  * @brief Bounded, reference-counted cache of open files keyed by path
+  * @var map           Path -> entry lookup table
+  * @var lru_head      Most recently used entry
+  * @var lru_tail      Least recently used entry (evicted first)
+  * @var capacity      Max number of entries kept in the map
+  * @var ttl_ms        Revalidation interval in milliseconds
+  * @var generation    Bumped by every invalidation, so a lookup that opened a
+  *                    path meanwhile knows its result may already be stale
+  * @var lock          Protects every field above and the entries' refcounts
+  * @var hits, misses, negative_hits, revalidations, evictions  Counters
+*/
+typedef struct{
+    std::unordered_map<std::string, FdCacheEntry*> map;
+    FdCacheEntry* lru_head;
+    FdCacheEntry* lru_tail;
+
+    size_t capacity;
+    long long ttl_ms;
+    unsigned long generation;
+
+    pthread_mutex_t lock;
+
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long negative_hits;
+    unsigned long revalidations;
+    unsigned long evictions;
+
+  } FdCache;
+
+/**
+ * @brief Sets up an empty cache
+ *
+ * @param cache    Pointer to the FdCache structure to initialize.
+ * @param capacity Max number of entries kept at once.
+ * @param ttl_ms   How long an entry is served before being re-checked with stat().
+ *
+ * @return 0 if successful, -1 on error
+ */
+int fd_cache_init(FdCache* cache, size_t capacity, int ttl_ms);
+
+/**
+ * @brief Closes every cached descriptor and frees all entries.
+ * Entries still held by callers must be released before this is called.
+ *
+ * @param cache Pointer to the FdCache to destroy.
+ */
+void fd_cache_destroy(FdCache* cache);
+
+/**
+ * @brief Looks up a path, opening and caching it on a miss.
+ * Hits within the TTL cost no syscalls at all. Once the TTL runs out the
+ * entry is checked with a single stat() and reopened only if the file changed.
+ * Missing files are cached as negative entries (fd == -1) so repeated 404s
+ * skip the open() as well. A file opened while an invalidation came in is
+ * handed to the caller but not cached.
+ *
+ * @param cache Pointer to the initialized FdCache.
+ * @param path  Resolved filesystem path (e.g. the result of fs_path()).
+ *
+ * @return Entry holding a reference; must be handed back with fd_cache_release()
+ */
+FdCacheEntry* fd_cache_acquire(FdCache* cache, const std::string &path);
+
+/**
+ * @brief Drops a reference taken by fd_cache_acquire().
+ * The descriptor is closed once the entry has been evicted and the last
+ * user releases it, so an fd is never closed under a request still sending it.
+ *
+ * @param cache Pointer to the FdCache the entry came from.
+ * @param entry Entry returned by fd_cache_acquire().
+ */
+void fd_cache_release(FdCache* cache, FdCacheEntry* entry);
+
+/**
+ * @brief Removes a path from the cache so the next lookup reopens it.
+ *
+ * @param cache Pointer to the FdCache.
+ * @param path  Path to forget; unknown paths are ignored.
+ */
+void fd_cache_invalidate(FdCache* cache, const std::string &path);
+
+/**
+ * @brief Removes a path and everything cached below it.
+ * Used when a whole directory is moved or deleted.
+ *
+ * @param cache  Pointer to the FdCache.
+ * @param prefix Directory path; entries equal to it or under prefix + "/" are dropped.
+ */
+void fd_cache_invalidate_prefix(FdCache* cache, const std::string &prefix);
+
+/**
+ * @brief Changes how long entries are trusted before being re-checked.
+ * A docroot watcher that reports every change lets this be raised far above
+ * FD_CACHE_TTL_MS, leaving stat() only as a rare safety net.
+ *
+ * @param cache  Pointer to the FdCache.
+ * @param ttl_ms New revalidation interval in milliseconds.
+ */
+void fd_cache_set_ttl(FdCache* cache, int ttl_ms);
@@ -0,0 +1,540 @@
+#include "h2.h"
+#include "fd_cache.h"
+#include "bundle.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+enum FrameType {
+    FRAME_DATA = 0x0,
+    FRAME_HEADERS = 0x1,
+    FRAME_PRIORITY = 0x2,
+    FRAME_RST_STREAM = 0x3,
+    FRAME_SETTINGS = 0x4,
+    FRAME_PUSH_PROMISE = 0x5,
+    FRAME_PING = 0x6,
+    FRAME_GOAWAY = 0x7,
+    FRAME_WINDOW_UPDATE = 0x8,
+    FRAME_CONTINUATION = 0x9,
+};
+
+const uint8_t FLAG_END_STREAM = 0x1;
+const uint8_t FLAG_ACK = 0x1;
+const uint8_t FLAG_END_HEADERS = 0x4;
+const uint8_t FLAG_PADDED = 0x8;
+const uint8_t FLAG_PRIORITY = 0x20;
+
+enum SettingId {
+    SETTINGS_HEADER_TABLE_SIZE = 0x1,
+    SETTINGS_ENABLE_PUSH = 0x2,
+    SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+    SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+    SETTINGS_MAX_FRAME_SIZE = 0x5,
+};
+
+const size_t FRAME_HEADER_LEN = 9;
+const int64_t MAX_WINDOW = 0x7fffffff;
+const uint32_t MAX_FRAME_SIZE_LIMIT = (1u << 24) - 1;
+
+uint32_t get_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void put_u32(std::string &out, uint32_t v) {
+    out += (char)(v >> 24);
+    out += (char)(v >> 16);
+    out += (char)(v >> 8);
+    out += (char)v;
+}
+
+void put_frame_header(std::string &out, uint32_t len, uint8_t type, uint8_t flags, uint32_t stream) {
+    out += (char)(len >> 16);
+    out += (char)(len >> 8);
+    out += (char)len;
+    out += (char)type;
+    out += (char)flags;
+    put_u32(out, stream & 0x7fffffff);
+}
+
+void queue_rst(H2Conn* conn, uint32_t stream, uint32_t error) {
+    put_frame_header(conn->out, 4, FRAME_RST_STREAM, 0, stream);
+    put_u32(conn->out, error);
+}
+
+void queue_window_update(H2Conn* conn, uint32_t stream, uint32_t increment) {
+    put_frame_header(conn->out, 4, FRAME_WINDOW_UPDATE, 0, stream);
+    put_u32(conn->out, increment);
+}
+
+int connection_error(H2Conn* conn, uint32_t error) {
+    h2_goaway(conn, error);
+    return -1;
+}
+
+off_t inline_length(const H2Stream &s) {
+    return s.resp.head.size() - s.resp.header_len;
+}
+
+off_t body_length(const H2Stream &s) {
+    return inline_length(s) + ((s.resp.file || s.resp.bundled) ? s.resp.body_size : 0);
+}
+
+// drops a stream once its response is complete or it was reset
+void finish_stream(H2Conn* conn, uint32_t id, bool reset_open) {
+    auto it = conn->streams.find(id);
+    if (it == conn->streams.end()) return;
+    // the client still had its side open: tell it we do not need the rest
+    if (reset_open && !it->second.remote_closed) queue_rst(conn, id, H2_NO_ERROR);
+    http_response_done(&it->second.resp);
+    conn->streams.erase(it);
+}
+
+// queues a header block as HEADERS plus as many CONTINUATION frames as it takes
+void queue_headers(H2Conn* conn, uint32_t id, const std::string &block, bool end_stream) {
+    size_t off = 0;
+    bool first = true;
+    do {
+        size_t chunk = std::min<size_t>(block.size() - off, conn->max_frame);
+        uint8_t flags = off + chunk == block.size() ? FLAG_END_HEADERS : 0;
+        if (first && end_stream) flags |= FLAG_END_STREAM;
+        put_frame_header(conn->out, chunk, first ? FRAME_HEADERS : FRAME_CONTINUATION, flags, id);
+        conn->out.append(block, off, chunk);
+        off += chunk;
+        first = false;
+    } while (off < block.size());
+}
+
+// builds the response the same way as for HTTP/1 and queues its HEADERS
+void start_response(H2Conn* conn, uint32_t id, const std::string &request, bool remote_closed) {
+    H2Stream s;
+    s.send_window = conn->initial_window;
+    s.sent = 0;
+    s.remote_closed = remote_closed;
+    http_build_response(request.data(), request.size(), &s.resp);
+
+    off_t length = body_length(s);
+    std::vector<HeaderField> fields = {
+        {":status", std::to_string(s.resp.status)},
+        {"content-type", s.resp.mime},
+        {"content-length", std::to_string(length)},
+    };
+    if (s.resp.cache_control) fields.push_back({"cache-control", s.resp.cache_control});
+    if (s.resp.encoding) {
+        fields.push_back({"content-encoding", s.resp.encoding});
+        fields.push_back({"vary", "accept-encoding"});
+    }
+
+    std::string block;
+    hpack_encode(&conn->encoder, fields, block);
+    queue_headers(conn, id, block, length == 0);
+
+    conn->streams[id] = s;
+    if (length == 0) finish_stream(conn, id, true);
+}
+
+// applies a SETTINGS payload from the client; returns an error code or H2_NO_ERROR
+uint32_t apply_settings(H2Conn* conn, const uint8_t* p, size_t len) {
+    for (size_t off = 0; off + 6 <= len; off += 6) {
+        uint16_t id = (p[off] << 8) | p[off + 1];
+        uint32_t value = get_u32(p + off + 2);
+
+        switch (id) {
+        case SETTINGS_HEADER_TABLE_SIZE:
+            hpack_set_limit(&conn->encoder, value);
+            break;
+        case SETTINGS_ENABLE_PUSH:
+            if (value > 1) return H2_PROTOCOL_ERROR;
+            break;
+        case SETTINGS_INITIAL_WINDOW_SIZE: {
+            if (value > MAX_WINDOW) return H2_FLOW_CONTROL_ERROR;
+            // the change applies to every open stream's window (RFC 9113 6.9.2)
+            int64_t delta = (int64_t)value - conn->initial_window;
+            for (auto &it : conn->streams) {
+                if (it.second.send_window + delta > MAX_WINDOW) return H2_FLOW_CONTROL_ERROR;
+                it.second.send_window += delta;
+            }
+            conn->initial_window = value;
+            break;
+        }
+        case SETTINGS_MAX_FRAME_SIZE:
+            if (value < H2_MAX_FRAME_SIZE || value > MAX_FRAME_SIZE_LIMIT) return H2_PROTOCOL_ERROR;
+            conn->max_frame = value;
+            break;
+        default:
+            // MAX_CONCURRENT_STREAMS only limits pushes, which we never send
+            break;
+        }
+    }
+    return H2_NO_ERROR;
+}
+
+bool base64url_decode(const std::string &in, std::string &out) {
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char c : in) {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '-' || c == '+') v = 62;
+        else if (c == '_' || c == '/') v = 63;
+        else if (c == '=') break;
+        else return false;
+
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out += (char)(acc >> bits);
+        }
+    }
+    return true;
+}
+
+// a complete header block has arrived for stream id
+int on_header_block(H2Conn* conn, uint32_t id, bool end_stream) {
+    std::vector<HeaderField> headers;
+    int rc = hpack_decode(&conn->decoder, (const uint8_t*)conn->header_block.data(),
+                          conn->header_block.size(), headers);
+    conn->header_block.clear();
+    conn->header_stream = 0;
+    if (rc < 0) return connection_error(conn, H2_COMPRESSION_ERROR);
+
+    auto it = conn->streams.find(id);
+    if (it != conn->streams.end()) {
+        // trailers: only valid as the last thing the client sends
+        if (!end_stream || it->second.remote_closed) return connection_error(conn, H2_PROTOCOL_ERROR);
+        it->second.remote_closed = true;
+        return 0;
+    }
+
+    if (conn->goaway) return 0;
+    if (conn->streams.size() >= H2_MAX_STREAMS) {
+        queue_rst(conn, id, H2_REFUSED_STREAM);
+        return 0;
+    }
+
+    std::string method, path;
+    for (const HeaderField &f : headers) {
+        if (f.first == ":method") method = f.second;
+        else if (f.first == ":path") path = f.second;
+    }
+    if (method.empty() || path.empty()) {
+        queue_rst(conn, id, H2_PROTOCOL_ERROR);
+        return 0;
+    }
+
+    // the handler only looks at the request line
+    start_response(conn, id, method + " " + path + " HTTP/2\r\n\r\n", end_stream);
+    return 0;
+}
+
+// strips the padding of a DATA or HEADERS payload; false if it is malformed
+bool strip_padding(uint8_t flags, const uint8_t* &p, uint32_t &len) {
+    if (!(flags & FLAG_PADDED)) return true;
+    if (len < 1 || p[0] >= len) return false;
+    uint8_t pad = p[0];
+    p++;
+    len -= 1 + pad;
+    return true;
+}
+
+int on_frame(H2Conn* conn, uint8_t type, uint8_t flags, uint32_t id, const uint8_t* p, uint32_t len) {
+    // a header block must not be interleaved with any other frame
+    if (conn->header_stream && (type != FRAME_CONTINUATION || id != conn->header_stream)) {
+        return connection_error(conn, H2_PROTOCOL_ERROR);
+    }
+
+    switch (type) {
+    case FRAME_DATA: {
+        if (id == 0 || id > conn->last_stream_id) return connection_error(conn, H2_PROTOCOL_ERROR);
+        uint32_t frame_len = len;
+        if (!strip_padding(flags, p, len)) return connection_error(conn, H2_PROTOCOL_ERROR);
+
+        // request bodies are not used, hand the window straight back
+        if (frame_len > 0) queue_window_update(conn, 0, frame_len);
+
+        auto it = conn->streams.find(id);
+        if (it == conn->streams.end() || it->second.remote_closed) {
+            queue_rst(conn, id, H2_STREAM_CLOSED);
+            return 0;
+        }
+        if (flags & FLAG_END_STREAM) it->second.remote_closed = true;
+        else if (frame_len > 0) queue_window_update(conn, id, frame_len);
+        return 0;
+    }
+
+    case FRAME_HEADERS: {
+        if (id == 0 || !(id & 1)) return connection_error(conn, H2_PROTOCOL_ERROR);
+        if (id > conn->last_stream_id) {
+            conn->last_stream_id = id;
+        } else if (!conn->streams.count(id)) {
+            return connection_error(conn, H2_STREAM_CLOSED);
+        }
+
+        if (!strip_padding(flags, p, len)) return connection_error(conn, H2_PROTOCOL_ERROR);
+        if (flags & FLAG_PRIORITY) {
+            // stream dependency and weight; priorities are not used
+            if (len < 5) return connection_error(conn, H2_FRAME_SIZE_ERROR);
+            p += 5;
+            len -= 5;
+        }
+
+        conn->header_block.assign((const char*)p, len);
+        conn->header_end_stream = flags & FLAG_END_STREAM;
+        if (flags & FLAG_END_HEADERS) return on_header_block(conn, id, conn->header_end_stream);
+        conn->header_stream = id;
+        return 0;
+    }
+
+    case FRAME_CONTINUATION:
+        if (!conn->header_stream) return connection_error(conn, H2_PROTOCOL_ERROR);
+        conn->header_block.append((const char*)p, len);
+        if (conn->header_block.size() > HPACK_MAX_HEADER_LIST) return connection_error(conn, H2_PROTOCOL_ERROR);
+        if (flags & FLAG_END_HEADERS) return on_header_block(conn, id, conn->header_end_stream);
+        return 0;
+
+    case FRAME_PRIORITY:
+        if (id == 0) return connection_error(conn, H2_PROTOCOL_ERROR);
+        if (len != 5) queue_rst(conn, id, H2_FRAME_SIZE_ERROR);
+        return 0;
+
+    case FRAME_RST_STREAM:
+        if (id == 0 || id > conn->last_stream_id) return connection_error(conn, H2_PROTOCOL_ERROR);
+        if (len != 4) return connection_error(conn, H2_FRAME_SIZE_ERROR);
+        finish_stream(conn, id, false);
+        return 0;
+
+    case FRAME_SETTINGS: {
+        if (id != 0) return connection_error(conn, H2_PROTOCOL_ERROR);
+        if (flags & FLAG_ACK) {
+            return len == 0 ? 0 : connection_error(conn, H2_FRAME_SIZE_ERROR);
+        }
+        if (len % 6 != 0) return connection_error(conn, H2_FRAME_SIZE_ERROR);
+        uint32_t error = apply_settings(conn, p, len);
+        if (error != H2_NO_ERROR) return connection_error(conn, error);
+        put_frame_header(conn->out, 0, FRAME_SETTINGS, FLAG_ACK, 0);
+        return 0;
+    }
+
+    case FRAME_PING:
+        if (id != 0) return connection_error(conn, H2_PROTOCOL_ERROR);
+        if (len != 8) return connection_error(conn, H2_FRAME_SIZE_ERROR);
+        if (!(flags & FLAG_ACK)) {
+            put_frame_header(conn->out, 8, FRAME_PING, FLAG_ACK, 0);
+            conn->out.append((const char*)p, 8);
+        }
+        return 0;
+
+    case FRAME_GOAWAY:
+        if (id != 0) return connection_error(conn, H2_PROTOCOL_ERROR);
+        if (len < 8) return connection_error(conn, H2_FRAME_SIZE_ERROR);
+        // finish what is in flight, accept nothing new
+        conn->goaway = true;
+        return 0;
+
+    case FRAME_WINDOW_UPDATE: {
+        if (len != 4) return connection_error(conn, H2_FRAME_SIZE_ERROR);
+        uint32_t increment = get_u32(p) & 0x7fffffff;
+
+        if (id == 0) {
+            if (increment == 0) return connection_error(conn, H2_PROTOCOL_ERROR);
+            if (conn->send_window + (int64_t)increment > MAX_WINDOW) {
+                return connection_error(conn, H2_FLOW_CONTROL_ERROR);
+            }
+            conn->send_window += increment;
+            return 0;
+        }
+
+        auto it = conn->streams.find(id);
+        if (it == conn->streams.end()) return 0;   // already finished on our side
+        if (increment == 0 || it->second.send_window + (int64_t)increment > MAX_WINDOW) {
+            queue_rst(conn, id, increment == 0 ? H2_PROTOCOL_ERROR : H2_FLOW_CONTROL_ERROR);
+            it->second.remote_closed = true;
+            finish_stream(conn, id, false);
+            return 0;
+        }
+        it->second.send_window += increment;
+        return 0;
+    }
+
+    case FRAME_PUSH_PROMISE:
+        // clients cannot push
+        return connection_error(conn, H2_PROTOCOL_ERROR);
+
+    default:
+        // unknown frame types must be ignored (RFC 9113 4.1)
+        return 0;
+    }
+}
+
+// queues one DATA frame of at most max bytes of a stream's body; false if reading the file failed
+bool queue_data(H2Conn* conn, uint32_t id, H2Stream &s, size_t max) {
+    off_t remaining = body_length(s) - s.sent;
+    size_t chunk = std::min<off_t>(remaining, max);
+    bool last = (off_t)chunk == remaining;
+
+    size_t start = conn->out.size();
+    put_frame_header(conn->out, chunk, FRAME_DATA, last ? FLAG_END_STREAM : 0, id);
+
+    // the small inline part sits behind the HTTP/1 headers in resp.head
+    size_t copied = 0;
+    off_t inline_len = inline_length(s);
+    if (s.sent < inline_len) {
+        copied = std::min<off_t>(chunk, inline_len - s.sent);
+        conn->out.append(s.resp.head, s.resp.header_len + s.sent, copied);
+    }
+    if (copied < chunk && s.resp.bundled) {
+        // bundled bodies are copied straight out of the mapping
+        conn->out.append(bundle_data(s.resp.bundled->body_offset) + s.sent + copied - inline_len, chunk - copied);
+    } else if (copied < chunk) {
+        // the rest comes from the cached file; pread keeps the shared fd's offset alone
+        size_t want = chunk - copied;
+        size_t at = conn->out.size();
+        conn->out.resize(at + want);
+        ssize_t n = pread(s.resp.file->fd, &conn->out[at], want, s.sent + copied - inline_len);
+        if (n != (ssize_t)want) {
+            conn->out.resize(start);
+            return false;
+        }
+    }
+
+    s.sent += chunk;
+    s.send_window -= chunk;
+    conn->send_window -= chunk;
+    return true;
+}
+
+} // namespace
+
+void h2_init(H2Conn* conn) {
+    conn->in.clear();
+    conn->out.clear();
+    conn->preface_done = false;
+    hpack_table_init(&conn->decoder);
+    hpack_table_init(&conn->encoder);
+    conn->streams.clear();
+    conn->last_stream_id = 0;
+    conn->send_window = H2_DEFAULT_WINDOW;
+    conn->initial_window = H2_DEFAULT_WINDOW;
+    conn->max_frame = H2_MAX_FRAME_SIZE;
+    conn->header_stream = 0;
+    conn->header_block.clear();
+    conn->header_end_stream = false;
+    conn->next_stream = 0;
+    conn->goaway = false;
+
+    // server connection preface: our SETTINGS, everything else at its default
+    put_frame_header(conn->out, 6, FRAME_SETTINGS, 0, 0);
+    conn->out += (char)0;
+    conn->out += (char)SETTINGS_MAX_CONCURRENT_STREAMS;
+    put_u32(conn->out, H2_MAX_STREAMS);
+}
+
+int h2_upgrade(H2Conn* conn, const std::string &settings, const char* req, size_t len) {
+    std::string payload;
+    if (!base64url_decode(settings, payload) || payload.size() % 6 != 0) return -1;
+    // acknowledged implicitly by the 101 response (RFC 7540 3.2.1)
+    if (apply_settings(conn, (const uint8_t*)payload.data(), payload.size()) != H2_NO_ERROR) return -1;
+
+    conn->last_stream_id = 1;
+    start_response(conn, 1, std::string(req, len), true);
+    return 0;
+}
+
+int h2_feed(H2Conn* conn, const char* data, size_t len) {
+    conn->in.append(data, len);
+    size_t off = 0;
+
+    if (!conn->preface_done) {
+        size_t have = std::min(conn->in.size(), H2_PREFACE_LEN);
+        if (memcmp(conn->in.data(), H2_PREFACE, have) != 0) return connection_error(conn, H2_PROTOCOL_ERROR);
+        if (have < H2_PREFACE_LEN) return 0;
+        conn->preface_done = true;
+        off = H2_PREFACE_LEN;
+    }
+
+    int rc = 0;
+    while (conn->in.size() - off >= FRAME_HEADER_LEN) {
+        const uint8_t* h = (const uint8_t*)conn->in.data() + off;
+        uint32_t frame_len = (h[0] << 16) | (h[1] << 8) | h[2];
+        if (frame_len > H2_MAX_FRAME_SIZE) {
+            rc = connection_error(conn, H2_FRAME_SIZE_ERROR);
+            break;
+        }
+        if (conn->in.size() - off < FRAME_HEADER_LEN + frame_len) break;
+
+        uint32_t id = get_u32(h + 5) & 0x7fffffff;
+        rc = on_frame(conn, h[3], h[4], id, h + FRAME_HEADER_LEN, frame_len);
+        off += FRAME_HEADER_LEN + frame_len;
+        if (rc < 0) break;
+    }
+
+    conn->in.erase(0, off);
+    return rc;
+}
+
+bool h2_produce(H2Conn* conn, size_t budget) {
+    // after an Upgrade, hold bodies back until the client has switched over:
+    // its preface and SETTINGS come first, and some clients cannot buffer a
+    // window's worth of DATA arriving right behind the 101
+    if (!conn->preface_done) return false;
+
+    size_t start = conn->out.size();
+    bool progress = true;
+
+    while (progress && conn->out.size() - start < budget && conn->send_window > 0) {
+        progress = false;
+
+        // one frame per stream per pass, starting after the stream served last
+        std::vector<uint32_t> order;
+        for (auto it = conn->streams.lower_bound(conn->next_stream); it != conn->streams.end(); ++it) {
+            order.push_back(it->first);
+        }
+        for (auto it = conn->streams.begin(); it != conn->streams.end() && it->first < conn->next_stream; ++it) {
+            order.push_back(it->first);
+        }
+
+        for (uint32_t id : order) {
+            if (conn->send_window <= 0 || conn->out.size() - start >= budget) break;
+            H2Stream &s = conn->streams[id];
+            if (s.send_window <= 0) continue;
+
+            size_t max = std::min<int64_t>({s.send_window, conn->send_window, conn->max_frame});
+            if (!queue_data(conn, id, s, max)) {
+                queue_rst(conn, id, H2_INTERNAL_ERROR);
+                s.remote_closed = true;
+                finish_stream(conn, id, false);
+                continue;
+            }
+            conn->next_stream = id + 1;
+            progress = true;
+            if (s.sent == body_length(s)) finish_stream(conn, id, true);
+        }
+    }
+
+    if (conn->send_window <= 0) return false;
+    for (const auto &it : conn->streams) {
+        if (it.second.send_window > 0) return true;
+    }
+    return false;
+}
+
+void h2_goaway(H2Conn* conn, uint32_t error) {
+    put_frame_header(conn->out, 8, FRAME_GOAWAY, 0, 0);
+    put_u32(conn->out, conn->last_stream_id);
+    put_u32(conn->out, error);
+    conn->goaway = true;
+}
+
+bool h2_finished(const H2Conn* conn) {
+    return conn->goaway && conn->streams.empty();
+}
+
+void h2_destroy(H2Conn* conn) {
+    for (auto &it : conn->streams) http_response_done(&it.second.resp);
+    conn->streams.clear();
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "hpack.h"
+#include "http_parser.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/**
+ * HTTP/2 over cleartext TCP (h2c, RFC 9113) without any I/O of its own.
+ *
+ * An H2Conn is fed the bytes read from the client with h2_feed() and
+ * leaves the bytes to write back in its out buffer; h2_produce() adds DATA
+ * frames for as much of the pending response bodies as the flow-control
+ * windows allow. The socket loop around it (serve_h2() in http_parser.cpp)
+ * decides when to read and write, so the same state machine would work for
+ * a non-blocking server.
+ *
+ * Every request stream is answered through http_build_response(), so
+ * routing, the file cache and MIME types behave exactly as for HTTP/1.0.
+ */
+
+// client connection preface (RFC 9113 3.4)
+const char H2_PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const size_t H2_PREFACE_LEN = sizeof(H2_PREFACE) - 1;
+
+// largest frame payload we accept (SETTINGS_MAX_FRAME_SIZE, left at its default)
+const uint32_t H2_MAX_FRAME_SIZE = 16384;
+// SETTINGS_MAX_CONCURRENT_STREAMS we advertise
+const uint32_t H2_MAX_STREAMS = 100;
+// initial connection and stream flow-control window (RFC 9113 6.9.2)
+const int32_t H2_DEFAULT_WINDOW = 65535;
+// a connection without open streams is closed after this long without input
+const int H2_IDLE_TIMEOUT_MS = 5 * 1000;
+// bytes of DATA queued per h2_produce() call, so input is checked in between
+const size_t H2_WRITE_BUDGET = 64 * 1024;
+
+// error codes (RFC 9113 7)
+enum H2Error {
+    H2_NO_ERROR = 0x0,
+    H2_PROTOCOL_ERROR = 0x1,
+    H2_INTERNAL_ERROR = 0x2,
+    H2_FLOW_CONTROL_ERROR = 0x3,
+    H2_STREAM_CLOSED = 0x5,
+    H2_FRAME_SIZE_ERROR = 0x6,
+    H2_REFUSED_STREAM = 0x7,
+    H2_COMPRESSION_ERROR = 0x9,
+};
+
+/**
+  * @struct H2Stream
+  * @brief A request stream whose response is being sent
+  * @var resp          Response from http_build_response(); the body follows header_len
+  * @var send_window   Stream flow-control window (bytes we may still send)
+  * @var sent          Body bytes sent so far (inline part first, then the file)
+  * @var remote_closed The client has ended its side (END_STREAM received)
+*/
+typedef struct{
+    HttpResponse resp;
+    int32_t send_window;
+    off_t sent;
+    bool remote_closed;
+  } H2Stream;
+
+/**
+  * @struct H2Conn
+  * @brief State of one HTTP/2 connection
+  * @var in             Received bytes not yet parsed into whole frames
+  * @var out            Frames ready to be written to the client
+  * @var preface_done   The client connection preface has been received
+  * @var decoder        HPACK table for request headers
+  * @var encoder        HPACK table for response headers
+  * @var streams        Streams with a response in flight, by stream id
+  * @var last_stream_id Highest stream id the client has opened
+  * @var send_window    Connection flow-control window
+  * @var initial_window Client's SETTINGS_INITIAL_WINDOW_SIZE for new streams
+  * @var max_frame      Client's SETTINGS_MAX_FRAME_SIZE
+  * @var header_stream  Stream whose header block awaits CONTINUATION, 0 if none
+  * @var header_block   Header block fragments collected so far
+  * @var header_end_stream The HEADERS frame of that block carried END_STREAM
+  * @var next_stream    Round-robin cursor: serve streams from this id on
+  * @var goaway         GOAWAY was sent or received; no new streams are accepted
+*/
+typedef struct{
+    std::string in;
+    std::string out;
+    bool preface_done;
+    HpackTable decoder;
+    HpackTable encoder;
+    std::map<uint32_t, H2Stream> streams;
+    uint32_t last_stream_id;
+    int32_t send_window;
+    int32_t initial_window;
+    uint32_t max_frame;
+    uint32_t header_stream;
+    std::string header_block;
+    bool header_end_stream;
+    uint32_t next_stream;
+    bool goaway;
+  } H2Conn;
+
+/**
+ * @brief Starts a connection and queues our SETTINGS (the server preface).
+ *
+ * @param conn Connection to initialize.
+ */
+void h2_init(H2Conn* conn);
+
+/**
+ * @brief Takes over an HTTP/1.1 request that asked to "Upgrade: h2c".
+ * Call after h2_init() and after the 101 response has been written: the
+ * client's HTTP2-Settings are applied and the request becomes stream 1,
+ * already half-closed by the client.
+ *
+ * @param conn     Connection set up by h2_init().
+ * @param settings Value of the HTTP2-Settings header (base64url SETTINGS payload).
+ * @param req      The HTTP/1.1 request.
+ * @param len      Length of req.
+ * @return 0 if successful, -1 if the settings are malformed
+ */
+int h2_upgrade(H2Conn* conn, const std::string &settings, const char* req, size_t len);
+
+/**
+ * @brief Processes bytes received from the client.
+ * Whole frames are handled right away (new streams get their response
+ * HEADERS queued); a partial frame waits in conn->in for more input.
+ *
+ * @param conn Connection.
+ * @param data Received bytes.
+ * @param len  Number of bytes.
+ * @return 0 if successful, -1 on a connection error (GOAWAY is queued; send out, then close)
+ */
+int h2_feed(H2Conn* conn, const char* data, size_t len);
+
+/**
+ * @brief Queues DATA frames round-robin across all streams with a response body.
+ * Each pass gives every stream one frame (bounded by its window, the
+ * connection window and the client's max frame size), so one large file
+ * does not hold back the small ones sharing the connection.
+ *
+ * @param conn   Connection.
+ * @param budget Stop after roughly this many bytes.
+ * @return true if more DATA could be sent right away
+ */
+bool h2_produce(H2Conn* conn, size_t budget = H2_WRITE_BUDGET);
+
+/**
+ * @brief Queues a GOAWAY frame; streams already open still complete.
+ *
+ * @param conn  Connection.
+ * @param error Error code (H2_NO_ERROR for a graceful close).
+ */
+void h2_goaway(H2Conn* conn, uint32_t error);
+
+/**
+ * @brief Reports whether the connection can be closed.
+ *
+ * @return true once GOAWAY was exchanged and no stream is left
+ */
+bool h2_finished(const H2Conn* conn);
+
+/**
+ * @brief Releases every stream's response (cached files) of a closing connection.
+ *
+ * @param conn Connection.
+ */
+void h2_destroy(H2Conn* conn);
@@ -0,0 +1,382 @@
+#include "hpack.h"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+
+struct StaticEntry {
+    const char* name;
+    const char* value;
+};
+
+// RFC 7541 Appendix A; index 1 is STATIC_TABLE[0]
+const StaticEntry STATIC_TABLE[] = {
+    {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+    {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, {":status", "200"},
+    {":status", "204"}, {":status", "206"}, {":status", "304"}, {":status", "400"},
+    {":status", "404"}, {":status", "500"}, {"accept-charset", ""}, {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""}, {"access-control-allow-origin", ""},
+    {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+    {"content-disposition", ""}, {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+    {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+    {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""},
+    {"from", ""}, {"host", ""}, {"if-match", ""}, {"if-modified-since", ""},
+    {"if-none-match", ""}, {"if-range", ""}, {"if-unmodified-since", ""}, {"last-modified", ""},
+    {"link", ""}, {"location", ""}, {"max-forwards", ""}, {"proxy-authenticate", ""},
+    {"proxy-authorization", ""}, {"range", ""}, {"referer", ""}, {"refresh", ""},
+    {"retry-after", ""}, {"server", ""}, {"set-cookie", ""}, {"strict-transport-security", ""},
+    {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""}, {"via", ""},
+    {"www-authenticate", ""},
+};
+const size_t STATIC_COUNT = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+
+// per-entry overhead counted against the table size (RFC 7541 4.1)
+const size_t ENTRY_OVERHEAD = 32;
+
+// RFC 7541 Appendix B, symbols 0-255 (EOS is 30 one bits)
+const uint32_t HUFFMAN_CODES[256] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+    0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+    0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+    0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+    0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+    0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+    0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+    0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+    0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+    0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+    0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+    0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+    0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+    0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+    0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+    0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+    0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+    0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+    0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+    0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+};
+
+const uint8_t HUFFMAN_LENGTHS[256] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+
+const int EOS_SYMBOL = 256;
+const int EOS_LENGTH = 30;
+const int MAX_CODE_LENGTH = 30;
+
+/**
+ * The code is canonical: codes of one length are consecutive and ordered by
+ * symbol, so a decoder only needs, per length, the first code, how many
+ * codes there are and where their symbols start in a length-sorted list.
+ */
+struct HuffmanDecoder {
+    uint32_t first_code[MAX_CODE_LENGTH + 1];
+    uint32_t count[MAX_CODE_LENGTH + 1];
+    uint32_t first_index[MAX_CODE_LENGTH + 1];
+    uint16_t symbols[257];
+
+    HuffmanDecoder() {
+        std::fill(count, count + MAX_CODE_LENGTH + 1, 0);
+        for (int s = 0; s < 256; s++) count[HUFFMAN_LENGTHS[s]]++;
+        count[EOS_LENGTH]++;
+
+        uint32_t code = 0, index = 0;
+        first_code[0] = first_index[0] = 0;
+        for (int len = 1; len <= MAX_CODE_LENGTH; len++) {
+            code = (code + count[len - 1]) << 1;
+            first_code[len] = code;
+            first_index[len] = index;
+            index += count[len];
+        }
+
+        uint32_t next[MAX_CODE_LENGTH + 1];
+        std::copy(first_index, first_index + MAX_CODE_LENGTH + 1, next);
+        for (int s = 0; s < 256; s++) symbols[next[HUFFMAN_LENGTHS[s]]++] = s;
+        symbols[next[EOS_LENGTH]++] = EOS_SYMBOL;
+    }
+};
+
+const HuffmanDecoder &huffman_decoder() {
+    static const HuffmanDecoder decoder;
+    return decoder;
+}
+
+size_t entry_size(const HeaderField &f) {
+    return f.first.size() + f.second.size() + ENTRY_OVERHEAD;
+}
+
+void evict_to(HpackTable* table, size_t max) {
+    while (table->size > max) {
+        table->size -= entry_size(table->entries.back());
+        table->entries.pop_back();
+    }
+}
+
+void table_add(HpackTable* table, const HeaderField &f) {
+    size_t size = entry_size(f);
+    // an entry larger than the whole table just empties it (RFC 7541 4.4)
+    if (size > table->max_size) {
+        evict_to(table, 0);
+        return;
+    }
+    evict_to(table, table->max_size - size);
+    table->entries.push_front(f);
+    table->size += size;
+}
+
+// looks up a 1-based HPACK index in the static, then the dynamic table
+bool table_get(const HpackTable* table, uint64_t index, HeaderField &f) {
+    if (index == 0) return false;
+    if (index <= STATIC_COUNT) {
+        f.first = STATIC_TABLE[index - 1].name;
+        f.second = STATIC_TABLE[index - 1].value;
+        return true;
+    }
+    index -= STATIC_COUNT + 1;
+    if (index >= table->entries.size()) return false;
+    f = table->entries[index];
+    return true;
+}
+
+bool decode_int(const uint8_t* &p, const uint8_t* end, int prefix_bits, uint64_t &value) {
+    if (p >= end) return false;
+    uint64_t mask = (1u << prefix_bits) - 1;
+    value = *p++ & mask;
+    if (value < mask) return true;
+
+    for (int shift = 0; p < end; shift += 7) {
+        // anything past 2^35 is far beyond any limit we accept
+        if (shift > 28) return false;
+        uint8_t b = *p++;
+        value += (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+bool decode_string(const uint8_t* &p, const uint8_t* end, std::string &s) {
+    if (p >= end) return false;
+    bool huffman = *p & 0x80;
+    uint64_t len;
+    if (!decode_int(p, end, 7, len) || len > (uint64_t)(end - p)) return false;
+
+    s.clear();
+    bool ok = huffman ? huffman_decode(p, len, s) : (s.assign((const char*)p, len), true);
+    p += len;
+    return ok;
+}
+
+void encode_int(std::string &out, uint8_t flags, int prefix_bits, uint64_t value) {
+    uint64_t mask = (1u << prefix_bits) - 1;
+    if (value < mask) {
+        out += (char)(flags | value);
+        return;
+    }
+    out += (char)(flags | mask);
+    value -= mask;
+    while (value >= 0x80) {
+        out += (char)(0x80 | (value & 0x7f));
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+void encode_string(std::string &out, const std::string &s) {
+    size_t huffman_len = huffman_encoded_size(s);
+    if (huffman_len < s.size()) {
+        encode_int(out, 0x80, 7, huffman_len);
+        huffman_encode(s, out);
+    } else {
+        encode_int(out, 0x00, 7, s.size());
+        out += s;
+    }
+}
+
+// 1-based index of an exact match (value_match) or of the name only, 0 if none
+size_t table_find(const HpackTable* table, const HeaderField &f, bool &value_match) {
+    size_t name_index = 0;
+    for (size_t i = 0; i < STATIC_COUNT; i++) {
+        if (f.first != STATIC_TABLE[i].name) continue;
+        if (f.second == STATIC_TABLE[i].value) {
+            value_match = true;
+            return i + 1;
+        }
+        if (!name_index) name_index = i + 1;
+    }
+    for (size_t i = 0; i < table->entries.size(); i++) {
+        const HeaderField &e = table->entries[i];
+        if (e.first != f.first) continue;
+        if (e.second == f.second) {
+            value_match = true;
+            return STATIC_COUNT + 1 + i;
+        }
+        if (!name_index) name_index = STATIC_COUNT + 1 + i;
+    }
+    value_match = false;
+    return name_index;
+}
+
+} // namespace
+
+void hpack_table_init(HpackTable* table, size_t limit) {
+    table->entries.clear();
+    table->size = 0;
+    table->limit = limit;
+    table->max_size = limit;
+    table->pending_update = false;
+}
+
+void hpack_set_limit(HpackTable* table, size_t limit) {
+    // never grow past what we would use anyway, shrink whenever asked
+    size_t max = std::min(limit, HPACK_TABLE_SIZE);
+    table->limit = limit;
+    if (max != table->max_size) {
+        table->max_size = max;
+        evict_to(table, max);
+        table->pending_update = true;
+    }
+}
+
+int hpack_decode(HpackTable* table, const uint8_t* data, size_t len, std::vector<HeaderField> &headers) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    size_t list_size = 0;
+    bool fields_seen = false;
+
+    while (p < end) {
+        uint8_t b = *p;
+        HeaderField f;
+
+        if (b & 0x80) {
+            // indexed header field
+            uint64_t index;
+            if (!decode_int(p, end, 7, index) || !table_get(table, index, f)) return -1;
+        } else if ((b & 0xe0) == 0x20) {
+            // dynamic table size update, only allowed before the first field
+            uint64_t size;
+            if (fields_seen || !decode_int(p, end, 5, size) || size > table->limit) return -1;
+            table->max_size = size;
+            evict_to(table, size);
+            continue;
+        } else {
+            // literal: with incremental indexing (01), without (0000) or never indexed (0001)
+            bool indexing = (b & 0xc0) == 0x40;
+            uint64_t name_index;
+            if (!decode_int(p, end, indexing ? 6 : 4, name_index)) return -1;
+            if (name_index) {
+                if (!table_get(table, name_index, f)) return -1;
+            } else if (!decode_string(p, end, f.first)) {
+                return -1;
+            }
+            if (!decode_string(p, end, f.second)) return -1;
+            if (indexing) table_add(table, f);
+        }
+
+        fields_seen = true;
+        list_size += entry_size(f);
+        if (list_size > HPACK_MAX_HEADER_LIST) return -1;
+        headers.push_back(std::move(f));
+    }
+    return 0;
+}
+
+void hpack_encode(HpackTable* table, const std::vector<HeaderField> &headers, std::string &out) {
+    if (table->pending_update) {
+        encode_int(out, 0x20, 5, table->max_size);
+        table->pending_update = false;
+    }
+
+    for (const HeaderField &f : headers) {
+        bool value_match;
+        size_t index = table_find(table, f, value_match);
+        if (value_match) {
+            encode_int(out, 0x80, 7, index);
+            continue;
+        }
+
+        // a fresh length per response would only churn the table
+        bool indexing = f.first != "content-length";
+        if (indexing) encode_int(out, 0x40, 6, index);
+        else encode_int(out, 0x00, 4, index);
+        if (!index) encode_string(out, f.first);
+        encode_string(out, f.second);
+        if (indexing) table_add(table, f);
+    }
+}
+
+bool huffman_decode(const uint8_t* data, size_t len, std::string &out) {
+    const HuffmanDecoder &d = huffman_decoder();
+    uint32_t code = 0;
+    int bits = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        for (int shift = 7; shift >= 0; shift--) {
+            code = (code << 1) | ((data[i] >> shift) & 1);
+            bits++;
+            uint32_t offset = code - d.first_code[bits];
+            if (code >= d.first_code[bits] && offset < d.count[bits]) {
+                uint16_t sym = d.symbols[d.first_index[bits] + offset];
+                if (sym == EOS_SYMBOL) return false;
+                out += (char)sym;
+                code = 0;
+                bits = 0;
+            } else if (bits == MAX_CODE_LENGTH) {
+                return false;
+            }
+        }
+    }
+    // padding: at most 7 bits, all ones (the most significant bits of EOS)
+    return bits <= 7 && code == (1u << bits) - 1;
+}
+
+void huffman_encode(const std::string &in, std::string &out) {
+    uint64_t acc = 0;
+    int bits = 0;
+    for (unsigned char c : in) {
+        acc = (acc << HUFFMAN_LENGTHS[c]) | HUFFMAN_CODES[c];
+        bits += HUFFMAN_LENGTHS[c];
+        while (bits >= 8) {
+            bits -= 8;
+            out += (char)(acc >> bits);
+        }
+    }
+    if (bits > 0) {
+        // pad with the leading one bits of EOS
+        out += (char)((acc << (8 - bits)) | (0xff >> bits));
+    }
+}
+
+size_t huffman_encoded_size(const std::string &in) {
+    size_t bits = 0;
+    for (unsigned char c : in) bits += HUFFMAN_LENGTHS[c];
+    return (bits + 7) / 8;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * HPACK header compression for HTTP/2 (RFC 7541).
+ *
+ * Each direction of a connection keeps its own dynamic table: the decoder
+ * table mirrors the peer's encoder and ours mirrors the peer's decoder, so
+ * an HpackTable is used for exactly one of hpack_decode() / hpack_encode().
+ */
+
+typedef std::pair<std::string, std::string> HeaderField;
+
+// default SETTINGS_HEADER_TABLE_SIZE, also what we advertise
+const size_t HPACK_TABLE_SIZE = 4096;
+// largest decoded header list accepted (names + values + 32 per field)
+const size_t HPACK_MAX_HEADER_LIST = 64 * 1024;
+
+/**
+  * @struct HpackTable
+  * @brief Dynamic table of one direction of a connection
+  * @var entries        Newest first; entry i has index 62 + i
+  * @var size           Sum of name + value + 32 over all entries
+  * @var max_size       Current size limit, changed by size updates
+  * @var limit          Largest max_size allowed (SETTINGS_HEADER_TABLE_SIZE)
+  * @var pending_update Encoder only: a size update must start the next block
+*/
+typedef struct{
+    std::deque<HeaderField> entries;
+    size_t size;
+    size_t max_size;
+    size_t limit;
+    bool pending_update;
+  } HpackTable;
+
+/**
+ * @brief Sets up an empty dynamic table.
+ *
+ * @param table Table to initialize.
+ * @param limit SETTINGS_HEADER_TABLE_SIZE in effect for this direction.
+ */
+void hpack_table_init(HpackTable* table, size_t limit = HPACK_TABLE_SIZE);
+
+/**
+ * @brief Applies a new SETTINGS_HEADER_TABLE_SIZE from the peer to our encoder.
+ * The encoder shrinks (or grows up to) the new limit and announces it with
+ * a size update at the start of the next header block.
+ *
+ * @param table Encoder table.
+ * @param limit New limit.
+ */
+void hpack_set_limit(HpackTable* table, size_t limit);
+
+/**
+ * @brief Decodes one complete header block.
+ *
+ * @param table   Decoder table, updated as the block is processed.
+ * @param data    Header block (HEADERS + CONTINUATION payloads, padding removed).
+ * @param len     Length of data.
+ * @param headers Receives the header list in order.
+ * @return 0 if successful, -1 on a compression error (the connection must die)
+ */
+int hpack_decode(HpackTable* table, const uint8_t* data, size_t len, std::vector<HeaderField> &headers);
+
+/**
+ * @brief Encodes a header list into a header block.
+ * Exact matches become one-byte indexes; other fields are added to the
+ * dynamic table unless they are unlikely to repeat (content-length).
+ * Strings are Huffman-coded when that is shorter.
+ *
+ * @param table   Encoder table, updated as fields are added.
+ * @param headers Header list; names must be lowercase.
+ * @param out     The block is appended here.
+ */
+void hpack_encode(HpackTable* table, const std::vector<HeaderField> &headers, std::string &out);
+
+/**
+ * @brief Decodes a Huffman-coded string (RFC 7541 5.2).
+ *
+ * @param data Encoded bytes.
+ * @param len  Length of data.
+ * @param out  Decoded string is appended here.
+ * @return false on invalid padding or an encoded EOS symbol
+ */
+bool huffman_decode(const uint8_t* data, size_t len, std::string &out);
+
+/**
+ * @brief Huffman-codes a string.
+ *
+ * @param in  String to encode.
+ * @param out Encoded bytes are appended here.
+ */
+void huffman_encode(const std::string &in, std::string &out);
+
+/** @brief Length in bytes of huffman_encode(in). */
+size_t huffman_encoded_size(const std::string &in);
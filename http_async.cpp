@@ -0,0 +1,57 @@
+#include "http_async.h"
+#include "http_parser.h"
+#include "fd_cache.h"
+#include "bundle.h"
+#include "ratelimit.h"
+
+namespace {
+
+// closes the client and, when draining, stops the reactor after the last one
+void finish_client(Reactor* reactor, int client_fd) {
+    ratelimit_release(client_fd);
+    reactor_close(reactor, client_fd);
+    if (--reactor->clients == 0 && reactor->draining) reactor->stop = true;
+}
+
+} // namespace
+
+Task handle_client_async(Reactor* reactor, int client_fd) {
+    reactor->clients++;
+
+    char buf[4096];
+    ssize_t n = co_await async_recv(reactor, client_fd, buf, sizeof(buf)-1);
+    if (n <= 0) {
+        finish_client(reactor, client_fd);
+        co_return;
+    }
+    buf[n] = '\0';
+
+    HttpResponse resp;
+    http_build_response(buf, n, &resp);
+
+    // headers (and small bodies) first
+    bool ok = true;
+    size_t sent = 0;
+    while (sent < resp.head.size()) {
+        ssize_t w = co_await async_send(reactor, client_fd, resp.head.data() + sent, resp.head.size() - sent);
+        if (w <= 0) { ok = false; break; }
+        sent += w;
+    }
+
+    // then large bodies straight from the page cache
+    off_t offset = 0;
+    while (ok && resp.file && offset < resp.body_size) {
+        ssize_t w = co_await async_sendfile(reactor, client_fd, resp.file->fd, &offset, resp.body_size - offset);
+        if (w <= 0) ok = false;
+    }
+    // or from the bundle, at the body's offset in it
+    offset = resp.bundled ? resp.bundled->body_offset : 0;
+    off_t end = offset + resp.body_size;
+    while (ok && resp.bundled && offset < end) {
+        ssize_t w = co_await async_sendfile(reactor, client_fd, bundle_fd(), &offset, end - offset);
+        if (w <= 0) ok = false;
+    }
+
+    http_response_done(&resp);
+    finish_client(reactor, client_fd);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "reactor.h"
+
+/**
+ * @brief Coroutine version of handle_client().
+ * Reads the request, builds the response with http_build_response() and
+ * writes it back, suspending on the reactor instead of blocking whenever
+ * the socket is not ready. Closes client_fd when done.
+ *
+ * @param reactor   Reactor driving this connection.
+ * @param client_fd Non-blocking socket for the connected client.
+ */
+Task handle_client_async(Reactor* reactor, int client_fd);
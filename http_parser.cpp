@@ -1,12 +1,34 @@
 #include "http_parser.h"
+#include "fd_cache.h"
+#include "ebr.h"
+#include "response_cache.h"
+#include "docroot_watch.h"
+#include "lifecycle.h"
+#include "mime_table.h"
+#include "h2.h"
+#include "https.h"
+#include "upload.h"
+#include "body_io.h"
+#include "bundle.h"
+#include "proxy.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <poll.h>
+#include <strings.h>
+#include <vector>
+#include <sys/sendfile.h>
+#include <time.h>
 
 namespace {
 
-// helper to check suffix
-bool ends_with(const std::string &str, const std::string &suffix) {
-    if (suffix.size() > str.size()) return false;
-    return std::equal(suffix.rbegin(), suffix.rend(), str.rbegin());
-}
+// bodies up to this size are copied into the header buffer and sent with one send()
+const off_t INLINE_BODY_MAX = 16 * 1024;
+// with inotify reporting every change, stat() revalidation is only a safety net
+const int WATCHED_TTL_MS = 60 * 1000;
+// cached responses are trusted as long as the file cache trusts its entries
+int response_ttl_ms = FD_CACHE_TTL_MS;
 
 bool send_all(int fd, const std::string &data) {
     size_t sent = 0;
@@ -14,78 +36,628 @@ bool send_all(int fd, const std::string &data) {
     const char* buf = data.data();
 
     while (sent < len) {
-        ssize_t n = send(fd, buf + sent, len - sent, 0);
+        ssize_t n = send(fd, buf + sent, len - sent, MSG_NOSIGNAL);
         if (n <= 0) return false;
         sent += n;
     }
     return true;
 }
 
+// sends count bytes of a cached file (or of the bundle) straight from the page cache
+bool send_file(int fd, int file_fd, off_t count, off_t offset = 0) {
+    // private offset, the cached fd is shared between workers
+    off_t end = offset + count;
+    while (offset < end) {
+        ssize_t n = sendfile(fd, file_fd, &offset, end - offset);
+        if (n <= 0) return false;
+    }
+    return true;
+}
+
+// process-wide cache of open files, shared by every worker thread
+FdCache* file_cache() {
+    static FdCache* cache = [] {
+        FdCache* c = new FdCache();
+        fd_cache_init(c, FD_CACHE_CAPACITY, FD_CACHE_TTL_MS);
+        return c;
+    }();
+    return cache;
+}
+
+// process-wide cache of complete small responses, read without locks
+ResponseCache* response_cache() {
+    static ResponseCache* cache = [] {
+        ResponseCache* c = new ResponseCache();
+        response_cache_init(c, RESPONSE_CACHE_CAPACITY);
+        return c;
+    }();
+    return cache;
+}
+
+long long now_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// where responses are counted; a prefork worker swaps in its shared slot
+HttpCounters local_counters;
+HttpCounters* counters = &local_counters;
+
+void count_sent(size_t bytes) {
+    counters->bytes_sent.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+// extra /__stats sections registered by the server
+struct StatsSection {
+    std::string name;
+    stats_writer writer;
+    void* ctx;
+};
+std::vector<StatsSection> stats_sections;
+
+// watcher callback: drop whatever the changed path resolved to
+void invalidate_file(const std::string &path, bool is_dir, void* ctx) {
+    FdCache* cache = (FdCache*)ctx;
+    if (is_dir) fd_cache_invalidate_prefix(cache, path);
+    else fd_cache_invalidate(cache, path);
+}
+
+void invalidate_response(const std::string &path, bool is_dir, void* ctx) {
+    ResponseCache* cache = (ResponseCache*)ctx;
+    if (is_dir) response_cache_invalidate_prefix(cache, path);
+    else response_cache_invalidate(cache, path);
+}
+
+/**
+ * Fills resp from the response cache; the hot path for small static files.
+ * With pin, a hit leaves the read section open and points resp->cached at
+ * the entry instead of copying it; http_response_done() closes the section.
+ */
+bool cached_response(HttpResponse* resp, const std::string &path, bool pin) {
+    ebr_enter();
+    const CachedResponse* c = response_cache_lookup(response_cache(), path, now_ms());
+    if (c && pin) {
+        resp->head.clear();
+        resp->cached = c;
+    } else if (c) {
+        resp->head = c->bytes;
+        resp->cached = NULL;
+    }
+    if (c) {
+        resp->header_len = c->header_len;
+        resp->status = 200;
+        resp->mime = c->mime;
+        resp->cache_control = c->cache_control;
+        resp->file = NULL;
+        resp->body_size = 0;
+        resp->bundled = NULL;
+        resp->encoding = NULL;
+    }
+    if (!c || !pin) ebr_exit();
+    return c != NULL;
+}
+
+/**
+ * Sends a pinned cache hit without blocking inside its read section: what
+ * the socket does not take at once is copied into head, the pin is dropped
+ * and the copy goes out with an ordinary blocking send.
+ */
+bool send_pinned(int fd, HttpResponse* resp) {
+    const std::string &bytes = resp->cached->bytes;
+    ssize_t n = send(fd, bytes.data(), bytes.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return false;
+    size_t done = n > 0 ? n : 0;
+    if (done == bytes.size()) return true;
+    resp->head.assign(bytes, done, std::string::npos);
+    resp->cached = NULL;
+    ebr_exit();
+    return send_all(fd, resp->head);
+}
+
+// publishes a freshly built small-file response for the next requests
+void cache_response(const HttpResponse* resp, const std::string &path, uint64_t generation) {
+    CachedResponse* c = new CachedResponse();
+    c->path = path;
+    c->bytes = resp->head;
+    c->header_len = resp->header_len;
+    c->mime = resp->mime;
+    c->cache_control = resp->cache_control;
+    c->expires_ms = now_ms() + response_ttl_ms;
+    response_cache_insert(response_cache(), c, generation);
+}
+
+// fills resp with a small generated page (errors, no file body)
+void simple_response(HttpResponse* resp, int code, const std::string &reason, const std::string &body,
+                     const std::string &mime = "text/html") {
+    resp->head = serialize_headers(code, reason, mime, body.size(), "no-store");
+    resp->header_len = resp->head.size();
+    resp->head += body;
+    resp->file = NULL;
+    resp->body_size = 0;
+    resp->bundled = NULL;
+    resp->encoding = NULL;
+    resp->cached = NULL;
+    resp->status = code;
+    resp->mime = mime;
+    resp->cache_control = "no-store";
+}
+
+/**
+ * Fills resp from the mapped bundle: headers were built by the packer, the
+ * body stays in the mapping unless it is small enough to go out inline.
+ */
+bool bundled_response(HttpResponse* resp, const std::string &path, const char* req, size_t len) {
+    const BundleIndexEntry* e = bundle_lookup(path);
+    if (!e) return false;
+    const BundleVariant* v = bundle_variant(e, has_token(header_value(req, len, "Accept-Encoding"), "gzip"));
+
+    resp->head.assign(bundle_data(v->head_offset), v->head_len);
+    resp->header_len = v->head_len;
+    resp->status = 200;
+    resp->mime = bundle_data(e->mime_offset);
+    resp->cache_control = bundle_data(e->cache_control_offset);
+    resp->encoding = v == &e->gzip ? "gzip" : NULL;
+    resp->file = NULL;
+    resp->cached = NULL;
+    if ((off_t)v->body_len <= INLINE_BODY_MAX) {
+        resp->head.append(bundle_data(v->body_offset), v->body_len);
+        resp->bundled = NULL;
+        resp->body_size = 0;
+    } else {
+        resp->bundled = v;
+        resp->body_size = v->body_len;
+    }
+    return true;
+}
+
+void count_status(int status) {
+    counters->requests.fetch_add(1, std::memory_order_relaxed);
+    if (status >= 500) counters->status_5xx.fetch_add(1, std::memory_order_relaxed);
+    else if (status >= 400) counters->status_4xx.fetch_add(1, std::memory_order_relaxed);
+    else counters->status_2xx.fetch_add(1, std::memory_order_relaxed);
+}
+
+void count_response(const HttpResponse* resp) {
+    count_status(resp->status);
+}
+
+// streams a PUT/POST body to disk and answers with where it was stored
+void upload_response(int client_fd, const char* req, size_t len, HttpResponse* resp) {
+    std::string method, uri, version;
+    parse_request_line(req, len, method, uri, version);
+    std::cout << "[REQ] " << method << " " << uri << std::endl;
+
+    UploadResult up;
+    upload_receive(client_fd, req, len, &up);
+    if (up.uri.empty()) {
+        simple_response(resp, up.status, up.reason, std::to_string(up.status) + " " + up.reason + "\n", "text/plain");
+    } else {
+        simple_response(resp, up.status, up.reason, up.uri + "\n", "text/plain");
+        resp->head.insert(resp->header_len - 2, "Location: " + up.uri + "\r\n");
+        resp->header_len += strlen("Location: \r\n") + up.uri.size();
+    }
+    count_response(resp);
+}
+
+// answers the reserved URIs from ROUTE_TABLE without touching ./www
+void route_response(HttpResponse* resp, RouteId id) {
+    switch (id) {
+    case ROUTE_HEALTHZ:
+        simple_response(resp, 200, "OK", "ok\n", "text/plain");
+        break;
+    case ROUTE_READYZ:
+        // load balancers should stop sending traffic once we are draining
+        if (lifecycle_stopping()) simple_response(resp, 503, "Service Unavailable", "draining\n", "text/plain");
+        else simple_response(resp, 200, "OK", "ready\n", "text/plain");
+        break;
+    case ROUTE_STATS: {
+        FdCache* c = file_cache();
+        std::ostringstream oss;
+        pthread_mutex_lock(&c->lock);
+        oss << "{\"fd_cache\": {\"entries\": " << c->map.size()
+            << ", \"hits\": " << c->hits
+            << ", \"negative_hits\": " << c->negative_hits
+            << ", \"misses\": " << c->misses
+            << ", \"revalidations\": " << c->revalidations
+            << ", \"evictions\": " << c->evictions << "}";
+        pthread_mutex_unlock(&c->lock);
+        ResponseCache* rc = response_cache();
+        pthread_mutex_lock(&rc->write_lock);
+        oss << ", \"response_cache\": {\"entries\": " << rc->fifo.size()
+            << ", \"inserts\": " << rc->inserts
+            << ", \"replacements\": " << rc->replacements
+            << ", \"invalidations\": " << rc->invalidations
+            << ", \"evictions\": " << rc->evictions
+            << ", \"retired_pending\": " << ebr_pending() << "}";
+        pthread_mutex_unlock(&rc->write_lock);
+        oss << ", \"http\": {\"requests\": " << counters->requests.load()
+            << ", \"status_2xx\": " << counters->status_2xx.load()
+            << ", \"status_4xx\": " << counters->status_4xx.load()
+            << ", \"status_5xx\": " << counters->status_5xx.load()
+            << ", \"bytes_sent\": " << counters->bytes_sent.load() << "}";
+        for (const StatsSection &section : stats_sections) {
+            oss << ", \"" << section.name << "\": ";
+            section.writer(oss, section.ctx);
+        }
+        oss << "}\n";
+        simple_response(resp, 200, "OK", oss.str(), "application/json");
+        break;
+    }
+    }
+}
+
+// an HTTP/1.1 GET asking to switch to h2c (RFC 7540 3.2); fills in its HTTP2-Settings
+bool wants_h2c_upgrade(const char* req, size_t len, std::string &settings) {
+    std::string method, uri, version;
+    parse_request_line(req, len, method, uri, version);
+    if (method != "GET" || version != "HTTP/1.1") return false;
+    if (!has_token(header_value(req, len, "Upgrade"), "h2c")) return false;
+
+    std::string connection = header_value(req, len, "Connection");
+    if (!has_token(connection, "upgrade") || !has_token(connection, "http2-settings")) return false;
+    settings = header_value(req, len, "HTTP2-Settings");
+    return true;
+}
+
+/**
+ * Drives an HTTP/2 connection on a blocking socket: writes whatever the
+ * connection has queued, then waits for input. While DATA is still
+ * sendable the wait is only a peek, so window updates and new streams are
+ * picked up between chunks of a large response. The caller still owns
+ * conn and destroys it afterwards.
+ */
+void serve_h2(int client_fd, H2Conn* conn) {
+    // poll in short steps so a drain is noticed while the client is idle
+    const int POLL_STEP_MS = 1000;
+    int idle_ms = 0;
+    char buf[16384];
+
+    for (;;) {
+        bool more = h2_produce(conn);
+        if (!conn->out.empty()) {
+            if (!send_all(client_fd, conn->out)) break;
+            count_sent(conn->out.size());
+            conn->out.clear();
+        }
+        if (h2_finished(conn)) break;
+
+        pollfd p = { client_fd, POLLIN, 0 };
+        int ready = poll(&p, 1, more ? 0 : POLL_STEP_MS);
+        if (ready < 0) break;
+        if (ready == 0) {
+            if (more) continue;
+            idle_ms += POLL_STEP_MS;
+            bool idle = conn->streams.empty() && idle_ms >= H2_IDLE_TIMEOUT_MS;
+            if (!conn->goaway && (idle || lifecycle_stopping())) h2_goaway(conn, H2_NO_ERROR);
+            continue;
+        }
+
+        ssize_t n = recv(client_fd, buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        idle_ms = 0;
+        if (h2_feed(conn, buf, n) < 0) {
+            send_all(client_fd, conn->out);
+            break;
+        }
+    }
+}
+
+} // namespace
+
 std::string guess_mime(const std::string &p) {
-    if (ends_with(p, ".html")) return "text/html";
-    if (ends_with(p, ".css"))  return "text/css";
-    if (ends_with(p, ".js"))   return "application/javascript";
-    if (ends_with(p, ".txt"))  return "text/plain";
-    if (ends_with(p, ".png"))  return "image/png";
-    if (ends_with(p, ".jpg") || ends_with(p, ".jpeg")) return "image/jpeg";
-    return "application/octet-stream";
+    const MimeEntry* m = mime_lookup(p);
+    if (!m) return "application/octet-stream";
+    if (m->charset) return std::string(m->type) + "; charset=utf-8";
+    return m->type;
+}
+
+const char* guess_cache_control(const std::string &path) {
+    const MimeEntry* info = mime_lookup(path);
+    return (info && info->cache == CACHE_STATIC) ? "public, max-age=86400" : "no-cache";
 }
 
 std::string fs_path(const std::string &uri) {
-    if (uri == "/") return "./www/index.html";
-    return "./www" + uri;
+    if (uri.empty() || uri[0] != '/') return "";
+    // one spelling per file: the fd and response caches are keyed by it, and
+    // the docroot watcher invalidates only this form
+    std::string path = "./www";
+    const size_t root = path.size();
+    for (size_t i = 1; i <= uri.size();) {
+        size_t end = std::min(uri.find('/', i), uri.size());
+        size_t n = end - i;
+        if (n == 2 && uri[i] == '.' && uri[i + 1] == '.') {
+            if (path.size() == root) return "";   // above the docroot
+            path.resize(path.rfind('/'));
+        } else if (n > 0 && !(n == 1 && uri[i] == '.')) {
+            path += '/';
+            path.append(uri, i, n);
+        }
+        i = end + 1;
+    }
+    if (path.size() == root) return "./www/index.html";
+    return path;
+}
+
+bool parse_request_line(const char* req_buf, size_t len, std::string &method, std::string &uri, std::string &version) {
+    std::string req(req_buf, len);
+    std::istringstream ss(req);
+
+    ss >> method >> uri >> version;
+    return !method.empty();
 }
 
-void send_simple(int fd, int code, const std::string &reason, const std::string &body) {
+std::string header_value(const char* req, size_t len, const char* name) {
+    std::string r(req, len);
+    size_t name_len = strlen(name);
+    size_t pos = r.find("\r\n");
+    while (pos != std::string::npos && pos + 2 < r.size()) {
+        size_t line = pos + 2;
+        size_t end = r.find("\r\n", line);
+        if (end == std::string::npos || end == line) break;
+        if (end - line > name_len && r[line + name_len] == ':' && strncasecmp(&r[line], name, name_len) == 0) {
+            size_t v = r.find_first_not_of(" \t", line + name_len + 1);
+            return v < end ? r.substr(v, end - v) : "";
+        }
+        pos = end;
+    }
+    return "";
+}
+
+bool has_token(const std::string &value, const char* token) {
+    std::string v = value;
+    for (char &c : v) c = tolower((unsigned char)c);
+    std::string t = token;
+    for (size_t pos = 0; (pos = v.find(t, pos)) != std::string::npos; pos += t.size()) {
+        bool starts = pos == 0 || v[pos - 1] == ',' || v[pos - 1] == ' ';
+        size_t after = pos + t.size();
+        bool ends = after == v.size() || v[after] == ',' || v[after] == ' ';
+        if (starts && ends) return true;
+    }
+    return false;
+}
+
+std::string serialize_headers(int code, const std::string &reason, const std::string &mime, size_t length,
+                              const char* cache_control) {
     std::ostringstream oss;
     oss << "HTTP/1.0 " << code << " " << reason << "\r\n";
-    oss << "Content-Type: text/html\r\n";
-    oss << "Content-Length: " << body.size() << "\r\n";
+    oss << "Content-Type: " << mime << "\r\n";
+    oss << "Content-Length: " << length << "\r\n";
+    if (cache_control) oss << "Cache-Control: " << cache_control << "\r\n";
     oss << "Connection: close\r\n\r\n";
-    oss << body;
-    send_all(fd, oss.str());
+    return oss.str();
 }
 
-} // namespace
+void http_register_stats(const char* name, stats_writer writer, void* ctx) {
+    stats_sections.push_back({name, writer, ctx});
+}
 
-void handle_client(int client_fd) { 
-    // sleep(10);  // 10 seconds
-    char buf[4096];
-    ssize_t n = recv(client_fd, buf, sizeof(buf)-1, 0);
-    if (n <= 0) return;
-    buf[n] = '\0';
+off_t http_peek_cost(int client_fd) {
+    char buf[1024];
+    ssize_t n = recv(client_fd, buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT);
+    if (n <= 0) return -1;
 
-    std::string req(buf);
-    std::istringstream ss(req);
     std::string method, uri, version;
+    parse_request_line(buf, n, method, uri, version);
+    // an upload costs a worker as long as a download of the same size
+    if ((method == "PUT" || method == "POST") && upload_request(buf, n)) {
+        std::string length = header_value(buf, n, "Content-Length");
+        return length.empty() ? -1 : atoll(length.c_str());
+    }
+    // HTTP/2 connections carry many requests and upstreams take however long they take
+    if (method != "GET" || uri.empty() || version.empty() || proxy_request(buf, n)) return -1;
+    if (route_lookup(uri)) return 0;
 
-    ss >> method >> uri >> version;
+    std::string path = fs_path(uri);
+    if (path.empty()) return 0;
+    if (const BundleIndexEntry* e = bundle_lookup(path)) return e->identity.body_len;
+    FdCacheEntry* file = fd_cache_acquire(file_cache(), path);
+    off_t cost = file->fd < 0 ? 0 : file->st.st_size;
+    fd_cache_release(file_cache(), file);
+    return cost;
+}
+
+int http_watch_docroot() {
+    docroot_watch_subscribe(invalidate_file, file_cache());
+    // after the file cache, so a response rebuilt in between is seen as stale
+    docroot_watch_subscribe(invalidate_response, response_cache());
+    if (docroot_watch_start("./www") < 0) {
+        std::cerr << "[!] inotify unavailable, falling back to TTL revalidation\n";
+        return -1;
+    }
+    fd_cache_set_ttl(file_cache(), WATCHED_TTL_MS);
+    response_ttl_ms = WATCHED_TTL_MS;
+    return 0;
+}
+
+// routing, response cache and file lookup; http_build_response() counts the result
+static void build_response(const char* req_buf, size_t len, HttpResponse* resp, bool pin) {
+    uint64_t t = trace_clock();
+    std::string method, uri, version;
+    parse_request_line(req_buf, len, method, uri, version);
+    trace_here(TRACE_PARSE, t);
 
     std::cout << "[REQ] " << method << " " << uri << std::endl;
 
+    // handle_client() forwards and stores these itself on plain HTTP/1; over
+    // TLS or HTTP/2 they must not fall through to whatever ./www has there
+    if (proxy_request(req_buf, len)) {
+        simple_response(resp, 421, "Misdirected Request", "421 Proxied paths are only served over plain HTTP/1\n",
+                        "text/plain");
+        return;
+    }
+    if (upload_request(req_buf, len)) {
+        simple_response(resp, 421, "Misdirected Request", "421 Uploads are only accepted over plain HTTP/1\n",
+                        "text/plain");
+        return;
+    }
+
     if (method != "GET") {
-        send_simple(client_fd, 405, "Method Not Allowed", "<h1>405 Not Allowed</h1>");
+        simple_response(resp, 405, "Method Not Allowed", "<h1>405 Not Allowed</h1>");
+        return;
+    }
+
+    if (const RouteEntry* route = route_lookup(uri)) {
+        route_response(resp, route->id);
         return;
     }
 
     std::string path = fs_path(uri);
-    std::ifstream f(path, std::ios::binary);
-    if (!f) {
-        send_simple(client_fd, 404, "Not Found", "<h1>404 Not Found</h1>");
+    if (path.empty()) {
+        simple_response(resp, 400, "Bad Request", "<h1>400 Bad Request</h1>");
+        return;
+    }
+    if (bundled_response(resp, path, req_buf, len)) return;
+    if (cached_response(resp, path, pin)) return;
+
+    uint64_t generation = response_cache_generation(response_cache());
+    t = trace_clock();
+    FdCacheEntry* file = fd_cache_acquire(file_cache(), path);
+    trace_here(TRACE_OPEN, t, file->fd < 0 ? -1 : file->st.st_size);
+    if (file->fd < 0) {
+        fd_cache_release(file_cache(), file);
+        simple_response(resp, 404, "Not Found", "<h1>404 Not Found</h1>");
         return;
     }
 
-    std::string body((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
     std::string mime = guess_mime(path);
+    const char* cache_control = guess_cache_control(path);
 
-    std::ostringstream oss;
-    oss << "HTTP/1.0 200 OK\r\n";
-    oss << "Content-Type: " << mime << "\r\n";
-    oss << "Content-Length: " << body.size() << "\r\n";
-    oss << "Connection: close\r\n\r\n";
+    resp->head = serialize_headers(200, "OK", mime, file->st.st_size, cache_control);
+    resp->header_len = resp->head.size();
+    resp->status = 200;
+    resp->mime = mime;
+    resp->cache_control = cache_control;
+    resp->bundled = NULL;
+    resp->encoding = NULL;
+    resp->cached = NULL;
+    off_t size = file->st.st_size;
+    if (size <= INLINE_BODY_MAX) {
+        // small file: headers + body go out in one send(), no second round trip
+        size_t hlen = resp->head.size();
+        resp->head.resize(hlen + size);
+        ssize_t n = pread(file->fd, &resp->head[hlen], size, 0);
+        fd_cache_release(file_cache(), file);
+        if (n != size) {
+            simple_response(resp, 500, "Internal Server Error", "<h1>500 Internal Server Error</h1>");
+            return;
+        }
+        resp->file = NULL;
+        resp->body_size = 0;
+        cache_response(resp, path, generation);
+        return;
+    }
+    resp->file = file;
+    resp->body_size = size;
+}
+
+void http_build_response(const char* req_buf, size_t len, HttpResponse* resp) {
+    build_response(req_buf, len, resp, false);
+    count_response(resp);
+}
+
+void http_build_response_pinned(const char* req_buf, size_t len, HttpResponse* resp) {
+    build_response(req_buf, len, resp, true);
+    count_response(resp);
+}
+
+void http_set_counters(HttpCounters* c) {
+    counters = c;
+}
+
+HttpCounters* http_counters() {
+    return counters;
+}
+
+void http_response_done(HttpResponse* resp) {
+    if (resp->file) fd_cache_release(file_cache(), resp->file);
+    resp->file = NULL;
+    if (resp->cached) ebr_exit();
+    resp->cached = NULL;
+}
+
+void handle_client(int client_fd) { 
+    // sleep(10);  // 10 seconds
+    char buf[4096];
+    trace_bind(client_fd);
+
+    // HTTPS: handshake in OpenSSL, then let the kernel encrypt the response
+    HttpsConn tls;
+    bool is_tls = https_client(client_fd);
+    if (is_tls && https_accept(client_fd, &tls) < 0) return;
+    if (is_tls) https_offload(&tls);
 
-    send_all(client_fd, oss.str());
-    send_all(client_fd, body); 
+    uint64_t t = trace_clock();
+    ssize_t n = is_tls ? https_recv(&tls, buf, sizeof(buf)-1) : recv(client_fd, buf, sizeof(buf)-1, 0);
+    trace_span(client_fd, TRACE_RECV, t, n);
+    if (n <= 0) {
+        if (is_tls) https_close(&tls);
+        return;
+    }
+    buf[n] = '\0';
+
+    // h2c with prior knowledge: the client opens with the HTTP/2 preface
+    size_t prefix = std::min((size_t)n, H2_PREFACE_LEN);
+    if (!is_tls && prefix >= 3 && memcmp(buf, H2_PREFACE, prefix) == 0) {
+        H2Conn conn;
+        h2_init(&conn);
+        if (h2_feed(&conn, buf, n) == 0) serve_h2(client_fd, &conn);
+        else send_all(client_fd, conn.out);
+        // streams opened before a connection error still hold cached files
+        h2_destroy(&conn);
+        return;
+    }
 
-    
+    // h2c via "Upgrade: h2c"; the request itself is answered as stream 1
+    std::string settings;
+    if (!is_tls && wants_h2c_upgrade(buf, n, settings)) {
+        H2Conn conn;
+        h2_init(&conn);
+        std::string switching = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+        if (send_all(client_fd, switching) && h2_upgrade(&conn, settings, buf, n) == 0) {
+            serve_h2(client_fd, &conn);
+        }
+        h2_destroy(&conn);
+        return;
+    }
+
+    // proxied paths: the upstream's response is relayed as it comes, bodies spliced socket to socket
+    if (!is_tls && proxy_request(buf, n)) {
+        ProxyResult proxied;
+        proxy_forward(client_fd, buf, n, &proxied);
+        if (proxied.status) count_status(proxied.status);
+        count_sent(proxied.bytes_sent);
+        return;
+    }
+
+    // PUT/POST into the upload directory: the body goes to disk without passing through here
+    HttpResponse resp;
+    bool upload = !is_tls && upload_request(buf, n);
+    // cache hits go out straight from the cache entry unless OpenSSL has to encrypt them
+    bool direct = !is_tls || tls.ktls;
+    if (upload) upload_response(client_fd, buf, n, &resp);
+    else if (direct) http_build_response_pinned(buf, n, &resp);
+    else http_build_response(buf, n, &resp);
+
+    t = trace_clock();
+    size_t head_size = resp.cached ? resp.cached->bytes.size() : resp.head.size();
+    bool sent;
+    if (resp.cached) {
+        sent = send_pinned(client_fd, &resp);
+    } else if (direct) {
+        // with kTLS the kernel encrypts these writes, sendfile() included
+        sent = send_all(client_fd, resp.head) && (!resp.file || send_file(client_fd, resp.file->fd, resp.body_size)) &&
+               (!resp.bundled || send_file(client_fd, bundle_fd(), resp.body_size, resp.bundled->body_offset));
+    } else {
+        sent = https_send(&tls, resp.head.data(), resp.head.size()) &&
+               (!resp.file || https_send_file(&tls, resp.file->fd, resp.body_size)) &&
+               (!resp.bundled || https_send(&tls, bundle_data(resp.bundled->body_offset), resp.body_size));
+    }
+    off_t body = (resp.file || resp.bundled) ? resp.body_size : 0;
+    if (sent) count_sent(head_size + body);
+    trace_span(client_fd, TRACE_SEND, t, head_size + body);
+    // a refused upload may still be arriving; a reset would drop the status we just sent
+    if (upload && resp.status >= 400) body_linger(client_fd, UPLOAD_LINGER_MS);
+    http_response_done(&resp);
+    if (is_tls) https_close(&tls);
 }
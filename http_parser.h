@@ -2,11 +2,209 @@
 
 #include <sys/socket.h>
 #include <unistd.h>
+#include <atomic>
+#include <cstdint>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 #include <string>
 
+struct FdCacheEntry;
+struct BundleVariant;
+struct CachedResponse;
+
+/**
+  * @struct HttpResponse
+  * @brief A response ready to be written to the client
+  * @var head          Status line and headers; bodies of small files are appended inline
+  * @var file          Cached file whose body follows head, or NULL if head is everything
+  * @var body_size     Number of bytes of file to send after head
+  * @var status        Status code, for framings other than HTTP/1 (HTTP/2)
+  * @var mime          Content-Type value
+  * @var cache_control Cache-Control value, or NULL if there is none
+  * @var header_len    Bytes of head taken by the HTTP/1 headers; the rest is inline body
+  * @var bundled       Bundle variant whose mapped body follows head (instead of file), or NULL
+  * @var encoding      Content-Encoding value, or NULL for the identity coding
+  * @var cached        Response cache entry whose bytes are sent instead of head (which is then empty),
+  *                    or NULL; see http_build_response_pinned()
+*/
+typedef struct{
+    std::string head;
+    FdCacheEntry* file;
+    off_t body_size;
+    int status;
+    std::string mime;
+    const char* cache_control;
+    size_t header_len;
+    const BundleVariant* bundled;
+    const char* encoding;
+    const CachedResponse* cached;
+  } HttpResponse;
+
+/**
+  * @struct HttpCounters
+  * @brief Responses served by one process, updated by all of its threads
+  * @var requests   Responses built (HTTP/1 requests and HTTP/2 streams)
+  * @var status_2xx Successful responses
+  * @var status_4xx Client errors (404, 405)
+  * @var status_5xx Server errors
+  * @var bytes_sent Bytes written to clients, headers included
+*/
+typedef struct{
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> status_2xx;
+    std::atomic<uint64_t> status_4xx;
+    std::atomic<uint64_t> status_5xx;
+    std::atomic<uint64_t> bytes_sent;
+  } HttpCounters;
+
+/**
+ * @brief Picks a Content-Type from a file path's extension.
+ * Looks the extension up (case-insensitively) in the compile-time table
+ * in mime_table.h; textual types get "; charset=utf-8".
+ *
+ * @param path Resolved file path (or URI).
+ * @return MIME type, application/octet-stream if the extension is unknown
+ */
+std::string guess_mime(const std::string &path);
+
+/**
+ * @brief Picks a Cache-Control value from a file path's extension.
+ *
+ * @param path Resolved file path (or URI).
+ * @return "public, max-age=86400" for static assets, "no-cache" for everything else
+ */
+const char* guess_cache_control(const std::string &path);
+
+/**
+ * @brief Maps a request URI onto a path under ./www ("/" serves index.html).
+ * "." and empty segments are dropped and ".." is resolved, so every
+ * spelling of a file maps to the same cache key.
+ *
+ * @param uri Request target from the request line.
+ * @return Filesystem path to open, "" if the URI is not absolute or climbs above ./www
+ */
+std::string fs_path(const std::string &uri);
+
+/**
+ * @brief Splits the request line into method, URI and version.
+ *
+ * @param req     Raw request bytes.
+ * @param len     Number of bytes in req.
+ * @param method  Receives the method (e.g. "GET").
+ * @param uri     Receives the request target.
+ * @param version Receives the protocol version.
+ * @return false if not even a method could be read
+ */
+bool parse_request_line(const char* req, size_t len, std::string &method, std::string &uri, std::string &version);
+
+/**
+ * @brief Looks up a request header.
+ *
+ * @param req  Raw request bytes.
+ * @param len  Number of bytes in req.
+ * @param name Header name, matched case-insensitively.
+ * @return The header's value, empty if the header is absent
+ */
+std::string header_value(const char* req, size_t len, const char* name);
+
+/**
+ * @brief Case-insensitive search for a token in a comma-separated header value.
+ *
+ * @param value Header value (e.g. of Connection).
+ * @param token Lower-case token to look for.
+ * @return True if the token is one of the list's elements
+ */
+bool has_token(const std::string &value, const char* token);
+
+/**
+ * @brief Builds the status line and headers of a response, ending in the blank line.
+ *
+ * @param code   HTTP status code.
+ * @param reason Reason phrase (e.g. "OK").
+ * @param mime   Content-Type value.
+ * @param length Content-Length value.
+ * @param cache_control Cache-Control value, or NULL to omit the header.
+ * @return Header block ready to be sent before the body
+ */
+std::string serialize_headers(int code, const std::string &reason, const std::string &mime, size_t length,
+                              const char* cache_control = NULL);
+
+/**
+ * @brief Parses a raw request and decides what to send back.
+ * This is the I/O-free part of handle_client(): it validates the method,
+ * resolves the file path and builds the headers, so blocking and
+ * event-driven servers can share it and only differ in how they write.
+ *
+ * @param req  Raw request bytes as received from the client.
+ * @param len  Number of bytes in req.
+ * @param resp Filled in with the response; release with http_response_done().
+ */
+void http_build_response(const char* req, size_t len, HttpResponse* resp);
+
+/**
+ * @brief http_build_response() for a caller that sends right away on the same thread.
+ * A response cache hit is not copied into head: resp->cached points at the
+ * entry, kept alive by an EBR read section (ebr.h) that http_response_done()
+ * ends. The section holds back reclamation, so the send must not block.
+ *
+ * @param req  Raw request bytes as received from the client.
+ * @param len  Number of bytes in req.
+ * @param resp Filled in with the response; release with http_response_done().
+ */
+void http_build_response_pinned(const char* req, size_t len, HttpResponse* resp);
+
+/**
+ * @brief Releases the cached file or cache entry held by a response once it has been sent.
+ *
+ * @param resp Response filled in by http_build_response().
+ */
+void http_response_done(HttpResponse* resp);
+
+/**
+ * @brief Estimates the cost of a client's request without consuming it.
+ * Peeks at whatever request bytes have arrived and resolves the target
+ * through the file cache, so a scheduler can tell tiny pages from large
+ * downloads before a worker picks the connection up.
+ *
+ * @param client_fd The connected client.
+ * @return Expected response body size in bytes (0 for routes and errors),
+ *         or -1 if the request has not arrived yet or is not plain HTTP/1
+ */
+off_t http_peek_cost(int client_fd);
+
+/**
+ * @brief Writes one section of the /__stats JSON document.
+ *
+ * @param out Stream receiving a JSON value.
+ * @param ctx Pointer given to http_register_stats().
+ */
+typedef void (*stats_writer)(std::ostream &out, void* ctx);
+
+/**
+ * @brief Adds a section to the /__stats endpoint.
+ * The fd cache is always reported; servers register their own components
+ * (e.g. the thread pool's lane wait times) once at startup.
+ *
+ * @param name   Key of the section in the JSON object.
+ * @param writer Writes the section's value.
+ * @param ctx    Passed to writer.
+ */
+void http_register_stats(const char* name, stats_writer writer, void* ctx);
+
+/**
+ * @brief Makes this process count its responses into the given counters.
+ * By default they go to a private HttpCounters; a prefork worker points
+ * this at its slot in shared memory so the parent can add them up. Call
+ * before serving.
+ *
+ * @param counters Counters to update from now on.
+ */
+void http_set_counters(HttpCounters* counters);
+
+/** @brief The counters this process currently updates. */
+HttpCounters* http_counters();
+
 /**
  * @brief Main handler for an individual client connection.
  * * Performs the following steps:
@@ -18,3 +216,14 @@
  * * @param client_fd The socket file descriptor for the connected client.
  */
 void handle_client(int client_fd);
+
+
+/**
+ * @brief Starts watching ./www so cached files are invalidated on change.
+ * Once the watcher runs, cached descriptors and stat results are trusted
+ * without per-request syscalls; modify/move/delete events drop them.
+ * Call once from main() before serving.
+ *
+ * @return 0 if the watcher is running, -1 if the cache stays TTL-based
+ */
+int http_watch_docroot();
@@ -0,0 +1,305 @@
+#include "https.h"
+#include "http_parser.h"
+#include "socket.h"
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/kdf.h>
+#include <openssl/core_names.h>
+#include <openssl/ssl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/un.h>
+#include <algorithm>
+#include <atomic>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+namespace {
+
+SSL_CTX* ctx = NULL;
+
+// local addresses of the --https listeners, fixed before the first connection
+sockaddr_storage listeners[HTTPS_MAX_LISTENERS];
+socklen_t listener_lens[HTTPS_MAX_LISTENERS];
+int num_listeners = 0;
+
+std::atomic<uint64_t> handshakes(0);
+std::atomic<uint64_t> failed(0);
+std::atomic<uint64_t> offloaded(0);
+std::atomic<uint64_t> userspace(0);
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * OpenSSL has no public getter for traffic secrets, but it reports each one
+ * to the key log callback (the SSLKEYLOGFILE hook) as
+ * "SERVER_TRAFFIC_SECRET_0 <client random> <secret>", all in hex.
+ */
+void capture_secret(const SSL* ssl, const char* line) {
+    const char* label = "SERVER_TRAFFIC_SECRET_0 ";
+    if (strncmp(line, label, strlen(label)) != 0) return;
+    HttpsConn* conn = (HttpsConn*)SSL_get_app_data(ssl);
+    const char* hex = strrchr(line, ' ');
+    if (!conn || !hex) return;
+
+    conn->tx_secret.clear();
+    for (hex++; hex_value(hex[0]) >= 0 && hex_value(hex[1]) >= 0; hex += 2) {
+        conn->tx_secret.push_back((char)(hex_value(hex[0]) << 4 | hex_value(hex[1])));
+    }
+}
+
+// HKDF-Expand-Label(secret, label, "", len) from RFC 8446 section 7.1
+bool expand_label(const std::string &secret, const char* digest, const char* label, unsigned char* out, size_t len) {
+    unsigned char info[64];
+    size_t label_len = strlen("tls13 ") + strlen(label);
+    info[0] = (unsigned char)(len >> 8);
+    info[1] = (unsigned char)len;
+    info[2] = (unsigned char)label_len;
+    memcpy(info + 3, "tls13 ", 6);
+    memcpy(info + 9, label, strlen(label));
+    info[3 + label_len] = 0; // empty context
+    size_t info_len = 4 + label_len;
+
+    EVP_KDF* kdf = EVP_KDF_fetch(NULL, OSSL_KDF_NAME_HKDF, NULL);
+    if (!kdf) return false;
+    EVP_KDF_CTX* kctx = EVP_KDF_CTX_new(kdf);
+    EVP_KDF_free(kdf);
+    if (!kctx) return false;
+
+    int mode = EVP_KDF_HKDF_MODE_EXPAND_ONLY;
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, (char*)digest, 0),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, (void*)secret.data(), secret.size()),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, info, info_len),
+        OSSL_PARAM_construct_int(OSSL_KDF_PARAM_MODE, &mode),
+        OSSL_PARAM_construct_end(),
+    };
+    bool ok = EVP_KDF_derive(kctx, out, len, params) == 1;
+    EVP_KDF_CTX_free(kctx);
+    return ok;
+}
+
+// installs the keys; the kernel numbers records from 0, as no ticket was sent
+template <typename CryptoInfo>
+bool install_tx(int fd, const HttpsTxKeys &keys) {
+    CryptoInfo info;
+    memset(&info, 0, sizeof(info));
+    info.info.version = TLS_1_3_VERSION;
+    info.info.cipher_type = keys.cipher;
+    memcpy(info.key, keys.key, sizeof(info.key));
+    memcpy(info.salt, keys.iv, sizeof(info.salt));
+    memcpy(info.iv, keys.iv + sizeof(info.salt), sizeof(info.iv));
+    return setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info)) == 0;
+}
+
+bool same_listener(const sockaddr_storage &spec, socklen_t spec_len, const sockaddr_storage &local, socklen_t len) {
+    if (spec.ss_family != local.ss_family) return false;
+    if (spec.ss_family == AF_INET) {
+        const sockaddr_in &a = (const sockaddr_in &)spec;
+        const sockaddr_in &b = (const sockaddr_in &)local;
+        return a.sin_port == b.sin_port &&
+               (a.sin_addr.s_addr == htonl(INADDR_ANY) || a.sin_addr.s_addr == b.sin_addr.s_addr);
+    }
+    if (spec.ss_family == AF_INET6) {
+        const sockaddr_in6 &a = (const sockaddr_in6 &)spec;
+        const sockaddr_in6 &b = (const sockaddr_in6 &)local;
+        return a.sin6_port == b.sin6_port &&
+               (IN6_IS_ADDR_UNSPECIFIED(&a.sin6_addr) || IN6_ARE_ADDR_EQUAL(&a.sin6_addr, &b.sin6_addr));
+    }
+    // an accepted Unix socket reports the path it was accepted on
+    return spec_len == len && memcmp(&spec, &local, len) == 0;
+}
+
+} // namespace
+
+int https_init(int argc, char** argv){
+  const char* cert = HTTPS_DEFAULT_CERT;
+  const char* key = HTTPS_DEFAULT_KEY;
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--https") == 0){
+      if (https_add_listener(argv[++i]) < 0){
+        fprintf(stderr, "[!] Bad --https listener %s\n", argv[i]);
+        return -1;
+      }
+    }
+    else if (strcmp(argv[i], "--cert") == 0) cert = argv[++i];
+    else if (strcmp(argv[i], "--key") == 0) key = argv[++i];
+  }
+  if (num_listeners == 0) return 0;
+  if (https_load(cert, key) < 0) return -1;
+
+  http_register_stats("https", https_write_stats, NULL);
+  printf("HTTPS on %d listener(s), certificate %s\n", num_listeners, cert);
+  return 0;
+}
+
+int https_load(const char* cert_file, const char* key_file){
+  SSL_CTX* c = SSL_CTX_new(TLS_server_method());
+  if (!c) return -1;
+  SSL_CTX_set_min_proto_version(c, TLS1_2_VERSION);
+  // AES-GCM is what the kernel can take over
+  SSL_CTX_set_ciphersuites(c, "TLS_AES_256_GCM_SHA384:TLS_AES_128_GCM_SHA256");
+  // a session ticket would be the first record under the traffic key; with
+  // none, the kernel starts from sequence number 0
+  SSL_CTX_set_num_tickets(c, 0);
+  SSL_CTX_set_keylog_callback(c, capture_secret);
+
+  if (SSL_CTX_use_certificate_chain_file(c, cert_file) != 1 ||
+      SSL_CTX_use_PrivateKey_file(c, key_file, SSL_FILETYPE_PEM) != 1 ||
+      SSL_CTX_check_private_key(c) != 1){
+    fprintf(stderr, "[!] Cannot load %s / %s: ", cert_file, key_file);
+    ERR_print_errors_fp(stderr);
+    SSL_CTX_free(c);
+    return -1;
+  }
+  if (ctx) SSL_CTX_free(ctx);
+  ctx = c;
+  return 0;
+}
+
+int https_add_listener(const char* spec){
+  if (num_listeners == HTTPS_MAX_LISTENERS) return -1;
+  if (resolve_socket_spec(spec, &listeners[num_listeners], &listener_lens[num_listeners]) < 0) return -1;
+  num_listeners++;
+  return 0;
+}
+
+bool https_client(int client_fd){
+  if (num_listeners == 0) return false;
+  sockaddr_storage local;
+  socklen_t len = sizeof(local);
+  if (getsockname(client_fd, (sockaddr*)&local, &len) < 0) return false;
+  for (int i = 0; i < num_listeners; i++){
+    if (same_listener(listeners[i], listener_lens[i], local, len)) return true;
+  }
+  return false;
+}
+
+int https_accept(int client_fd, HttpsConn* conn){
+  conn->ssl = ctx ? SSL_new(ctx) : NULL;
+  conn->ktls = false;
+  conn->tx_secret.clear();
+  if (!conn->ssl) return -1;
+
+  // every write is a whole record; without this the close_notify after a
+  // small response waits out the client's delayed ACK
+  int one = 1;
+  setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  SSL_set_app_data(conn->ssl, conn);
+  SSL_set_fd(conn->ssl, client_fd);
+  if (SSL_accept(conn->ssl) != 1){
+    failed++;
+    ERR_clear_error();
+    SSL_free(conn->ssl);
+    conn->ssl = NULL;
+    return -1;
+  }
+  handshakes++;
+  return 0;
+}
+
+int https_tx_keys(const HttpsConn* conn, HttpsTxKeys* keys){
+  if (SSL_version(conn->ssl) != TLS1_3_VERSION || conn->tx_secret.empty()) return -1;
+
+  const char* digest;
+  switch (SSL_CIPHER_get_id(SSL_get_current_cipher(conn->ssl))){
+    case TLS1_3_CK_AES_128_GCM_SHA256:
+      keys->cipher = TLS_CIPHER_AES_GCM_128;
+      keys->key_len = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+      digest = "SHA256";
+      break;
+    case TLS1_3_CK_AES_256_GCM_SHA384:
+      keys->cipher = TLS_CIPHER_AES_GCM_256;
+      keys->key_len = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+      digest = "SHA384";
+      break;
+    default:
+      return -1;
+  }
+  if (!expand_label(conn->tx_secret, digest, "key", keys->key, keys->key_len)) return -1;
+  if (!expand_label(conn->tx_secret, digest, "iv", keys->iv, sizeof(keys->iv))) return -1;
+  return 0;
+}
+
+bool https_offload(HttpsConn* conn){
+  HttpsTxKeys keys;
+  int fd = SSL_get_fd(conn->ssl);
+  // ENOENT: the kernel has no tls module; the socket is left as it was
+  bool ok = https_tx_keys(conn, &keys) == 0 && setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+  if (ok){
+    ok = keys.cipher == TLS_CIPHER_AES_GCM_128 ? install_tx<tls12_crypto_info_aes_gcm_128>(fd, keys)
+                                               : install_tx<tls12_crypto_info_aes_gcm_256>(fd, keys);
+  }
+  OPENSSL_cleanse(&keys, sizeof(keys));
+  conn->ktls = ok;
+  if (ok) offloaded++;
+  else userspace++;
+  return ok;
+}
+
+ssize_t https_recv(HttpsConn* conn, char* buf, size_t len){
+  int n = SSL_read(conn->ssl, buf, (int)len);
+  if (n > 0) return n;
+  return SSL_get_error(conn->ssl, n) == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+}
+
+bool https_send(HttpsConn* conn, const char* data, size_t len){
+  while (len > 0){
+    int n = SSL_write(conn->ssl, data, (int)std::min(len, (size_t)INT32_MAX));
+    if (n <= 0) return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool https_send_file(HttpsConn* conn, int file_fd, off_t count){
+  char buf[HTTPS_CHUNK];
+  for (off_t offset = 0; offset < count; ){
+    ssize_t n = pread(file_fd, buf, std::min((off_t)sizeof(buf), count - offset), offset);
+    if (n <= 0 || !https_send(conn, buf, n)) return false;
+    offset += n;
+  }
+  return true;
+}
+
+void https_close(HttpsConn* conn){
+  if (!conn->ssl) return;
+  if (conn->ktls){
+    // OpenSSL no longer knows the sequence number; the kernel sends the alert
+    unsigned char alert[2] = { 1, 0 }; // warning, close_notify
+    char control[CMSG_SPACE(sizeof(unsigned char))];
+    iovec iov = { alert, sizeof(alert) };
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *CMSG_DATA(cmsg) = 21; // alert
+    sendmsg(SSL_get_fd(conn->ssl), &msg, MSG_NOSIGNAL);
+  } else {
+    SSL_shutdown(conn->ssl);
+  }
+  SSL_free(conn->ssl);
+  conn->ssl = NULL;
+  OPENSSL_cleanse(&conn->tx_secret[0], conn->tx_secret.size());
+}
+
+void https_write_stats(std::ostream &out, void*){
+  out << "{\"handshakes\": " << handshakes.load() << ", \"failed\": " << failed.load()
+      << ", \"ktls\": " << offloaded.load() << ", \"userspace\": " << userspace.load() << "}";
+}
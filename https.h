@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * HTTPS listeners, with the bulk encryption done by the kernel (kTLS).
+ *
+ * OpenSSL performs the TLS 1.3 handshake and decrypts the request. The
+ * server's traffic key is then installed on the socket with TCP_ULP "tls",
+ * after which the kernel encrypts everything written to it: handle_client()
+ * answers with the same send()/sendfile() calls as on plain HTTP, and file
+ * bodies still go from the page cache to the NIC without a userspace copy.
+ *
+ * Kernels without the tls module (or TLS 1.2 clients, or other ciphers)
+ * fall back to SSL_write(), with file bodies read in chunks.
+ */
+
+typedef struct ssl_st SSL;
+
+// most --https listeners a server recognises
+const int HTTPS_MAX_LISTENERS = 16;
+// certificate and key used when --cert / --key are not given ("make certs" creates them)
+const char* const HTTPS_DEFAULT_CERT = "certs/server.crt";
+const char* const HTTPS_DEFAULT_KEY = "certs/server.key";
+// chunk a file body is read in when the kernel cannot encrypt it
+const size_t HTTPS_CHUNK = 16 * 1024;
+
+/**
+ * @struct HttpsConn
+ * @brief One TLS connection, from the handshake to close_notify
+ * @var ssl       OpenSSL session (the handshake and received data)
+ * @var ktls      True once the kernel encrypts what is written to the socket
+ * @var tx_secret Server application traffic secret, captured during the handshake
+*/
+typedef struct{
+    SSL* ssl;
+    bool ktls;
+    std::string tx_secret;
+  } HttpsConn;
+
+/**
+ * @struct HttpsTxKeys
+ * @brief Record protection keys for the server's first application traffic
+ * The values handed to the kernel with setsockopt(SOL_TLS, TLS_TX).
+ * @var cipher  TLS_CIPHER_AES_GCM_128 or TLS_CIPHER_AES_GCM_256 (linux/tls.h)
+ * @var key     AES key, key_len bytes
+ * @var key_len 16 or 32
+ * @var iv      Per-connection nonce; the record sequence number is XORed into its tail
+*/
+typedef struct{
+    int cipher;
+    unsigned char key[32];
+    size_t key_len;
+    unsigned char iv[12];
+  } HttpsTxKeys;
+
+/**
+ * @brief Sets up HTTPS if the command line asks for it.
+ * Understands "--https SPEC" (repeatable, any listener spec; open_listeners()
+ * opens these sockets), "--cert PATH" and "--key PATH" (PEM files).
+ *
+ * @param argc main()'s argc.
+ * @param argv main()'s argv.
+ * @return 0 if successful (or HTTPS not requested), -1 if the certificate or key cannot be loaded
+ */
+int https_init(int argc, char** argv);
+
+/**
+ * @brief Loads the server certificate and private key (tests, embedding).
+ *
+ * @param cert_file PEM certificate (chain).
+ * @param key_file  PEM private key.
+ * @return 0 if successful, -1 on error
+ */
+int https_load(const char* cert_file, const char* key_file);
+
+/**
+ * @brief Makes connections accepted on a listener spec speak TLS.
+ *
+ * @param spec Listener spec, as given to --https.
+ * @return 0 if successful, -1 if the spec is malformed or there are too many
+ */
+int https_add_listener(const char* spec);
+
+/**
+ * @brief Whether a client socket was accepted on an HTTPS listener.
+ * Decided from the socket's local address, so it also holds for listeners
+ * inherited across a binary upgrade. Costs nothing while HTTPS is off.
+ *
+ * @param client_fd Accepted client socket.
+ * @return True if the connection must be served over TLS
+ */
+bool https_client(int client_fd);
+
+/**
+ * @brief Performs the server side of the TLS handshake.
+ *
+ * @param client_fd Accepted client socket (blocking).
+ * @param conn      Receives the session; release it with https_close().
+ * @return 0 if successful, -1 if the handshake failed (nothing to release)
+ */
+int https_accept(int client_fd, HttpsConn* conn);
+
+/**
+ * @brief Hands encryption of everything sent on the socket to the kernel.
+ * Call once, right after https_accept() and before anything is sent.
+ * Only TLS 1.3 sessions using AES-GCM can be offloaded.
+ *
+ * @param conn Session from https_accept().
+ * @return True if conn->ktls is now set; otherwise use https_send()
+ */
+bool https_offload(HttpsConn* conn);
+
+/**
+ * @brief Derives the keys https_offload() installs in the kernel.
+ *
+ * @param conn Session from https_accept().
+ * @param keys Receives the key material.
+ * @return 0 if successful, -1 if the session's version or cipher cannot be offloaded
+ */
+int https_tx_keys(const HttpsConn* conn, HttpsTxKeys* keys);
+
+/**
+ * @brief Reads decrypted request bytes.
+ *
+ * @param conn Session from https_accept().
+ * @param buf  Destination.
+ * @param len  Capacity of buf.
+ * @return Bytes read, 0 if the client closed, -1 on error
+ */
+ssize_t https_recv(HttpsConn* conn, char* buf, size_t len);
+
+/**
+ * @brief Encrypts and sends data in userspace (sessions not offloaded).
+ *
+ * @param conn Session from https_accept().
+ * @param data Bytes to send.
+ * @param len  Number of bytes.
+ * @return True if everything was sent
+ */
+bool https_send(HttpsConn* conn, const char* data, size_t len);
+
+/**
+ * @brief Sends count bytes of a file in HTTPS_CHUNK pieces (sessions not offloaded).
+ *
+ * @param conn    Session from https_accept().
+ * @param file_fd File to send from offset 0; its file offset is not used.
+ * @param count   Number of bytes.
+ * @return True if everything was sent
+ */
+bool https_send_file(HttpsConn* conn, int file_fd, off_t count);
+
+/**
+ * @brief Sends close_notify (through the kernel once offloaded) and frees the session.
+ *
+ * @param conn Session from https_accept().
+ */
+void https_close(HttpsConn* conn);
+
+/**
+ * @brief Writes handshake and offload counters as JSON (the "https" /__stats section).
+ *
+ * @param out Stream receiving a JSON object.
+ * @param ctx Unused.
+ */
+void https_write_stats(std::ostream &out, void* ctx);
@@ -0,0 +1,314 @@
+#include "lifecycle.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+extern char** environ;
+
+namespace {
+
+// the new binary finds its channel to the old one on this fd
+const int UPGRADE_CHANNEL_FD = 3;
+const char* UPGRADE_ENV = "SERVER_UPGRADE_FD";
+
+sigset_t handled;
+char** saved_argv = NULL;
+std::string exe_path;
+
+int wake[2] = {-1, -1};       // [1] written by the signal thread, [0] watched by servers
+int upgrade_channel = -1;     // new binary: socket back to the old one
+
+std::atomic<bool> stopping(false);
+std::atomic<bool> upgrade_requested(false);
+// a hand_over() thread is running; further SIGUSR2s are ignored until it ends
+std::atomic<bool> handing_over(false);
+// forked worker process: SIGUSR2 belongs to the parent that owns the listeners
+bool forked_worker = false;
+
+void* signal_loop(void*) {
+    while (true) {
+        int sig;
+        if (sigwait(&handled, &sig) != 0) continue;
+
+        if (sig == SIGUSR2) {
+            if (forked_worker) continue;
+            if (!stopping) upgrade_requested = true;
+        } else if (stopping.exchange(true)) {
+            // second SIGTERM/SIGINT: the operator does not want to wait
+            fprintf(stderr, "[!] Forced shutdown\n");
+            _exit(1);
+        }
+
+        char c = 0;
+        send(wake[1], &c, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+    return NULL;
+}
+
+void drain_wakeups() {
+    char buf[64];
+    while (recv(wake[0], buf, sizeof(buf), MSG_DONTWAIT) > 0) {}
+}
+
+bool send_fds(int sock, const int* fds, int n) {
+    char count = (char)n;
+    iovec iov = { &count, 1 };
+
+    std::vector<char> ctrl(CMSG_SPACE(sizeof(int) * n));
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.data();
+    msg.msg_controllen = ctrl.size();
+
+    cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * n);
+    memcpy(CMSG_DATA(cm), fds, sizeof(int) * n);
+
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+/**
+ * Starts the new binary and hands it the listening sockets. The old process
+ * keeps its copies open until the new one says it is accepting, so there is
+ * never a moment where the port is closed and connections get refused.
+ */
+bool hand_over(const int* fds, int n) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+        perror("socketpair");
+        return false;
+    }
+
+    // everything the child needs is prepared before fork(): only
+    // async-signal-safe calls are allowed between fork() and exec()
+    std::string env_entry = std::string(UPGRADE_ENV) + "=" + std::to_string(UPGRADE_CHANNEL_FD);
+    std::vector<char*> envp;
+    for (char** e = environ; *e; e++) {
+        if (strncmp(*e, UPGRADE_ENV, strlen(UPGRADE_ENV)) != 0) envp.push_back(*e);
+    }
+    envp.push_back(&env_entry[0]);
+    envp.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+    if (pid == 0) {
+        // don't leak client sockets or the pool's fds into the new binary
+        if (sv[1] == UPGRADE_CHANNEL_FD) fcntl(sv[1], F_SETFD, 0);
+        else dup2(sv[1], UPGRADE_CHANNEL_FD);
+        close_range(UPGRADE_CHANNEL_FD + 1, ~0U, 0);
+        execve(exe_path.c_str(), saved_argv, envp.data());
+        _exit(127);
+    }
+    close(sv[1]);
+
+    bool ok = send_fds(sv[0], fds, n);
+
+    // wait for the new binary to reach its accept loop
+    pollfd p = { sv[0], POLLIN, 0 };
+    char ack = 0;
+    ok = ok && poll(&p, 1, UPGRADE_TIMEOUT_MS) == 1 && recv(sv[0], &ack, 1, 0) == 1;
+    close(sv[0]);
+
+    if (!ok) {
+        fprintf(stderr, "[!] Upgrade failed, new binary (pid %d) never became ready\n", pid);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return false;
+    }
+    printf("[+] Handed listening sockets to pid %d, draining\n", pid);
+    return true;
+}
+
+// listening sockets for the hand_over() thread, duplicated so the server may close its own
+struct Handover {
+    int fds[MAX_LISTENERS];
+    int n;
+};
+
+/**
+ * Runs the upgrade off the server's thread: waiting up to
+ * UPGRADE_TIMEOUT_MS for the new binary must not stall an event loop that
+ * is still serving every open connection meanwhile.
+ */
+void* handover_thread(void* arg) {
+    Handover* h = (Handover*)arg;
+    if (hand_over(h->fds, h->n)) {
+        stopping = true;
+        // the server notices on its next wakeup and starts draining
+        char c = 0;
+        send(wake[1], &c, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+    for (int i = 0; i < h->n; i++) close(h->fds[i]);
+    delete h;
+    handing_over = false;
+    return NULL;
+}
+
+void start_handover(const int* listen_fds, int n) {
+    if (handing_over.exchange(true)) return;
+    Handover* h = new Handover();
+    h->n = 0;
+    for (int i = 0; i < n && i < MAX_LISTENERS; i++) {
+        int fd = fcntl(listen_fds[i], F_DUPFD_CLOEXEC, 0);
+        if (fd >= 0) h->fds[h->n++] = fd;
+    }
+    pthread_t tid;
+    if (h->n < n || pthread_create(&tid, NULL, handover_thread, h) != 0) {
+        perror("Failed to start upgrade");
+        for (int i = 0; i < h->n; i++) close(h->fds[i]);
+        delete h;
+        handing_over = false;
+        return;
+    }
+    pthread_detach(tid);
+}
+
+// wakeup socket pair plus the sigwait() thread
+int start_signal_thread() {
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, wake) < 0) {
+        perror("socketpair");
+        return -1;
+    }
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, signal_loop, NULL) != 0) {
+        perror("Failed to start signal thread");
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+} // namespace
+
+int lifecycle_init(char** argv){
+  saved_argv = argv;
+  // the path we were started from, resolved by the kernel now (argv[0] may
+  // have come from $PATH); on upgrade it names the binary installed there
+  // then, not the (possibly deleted) one we run from
+  char resolved[PATH_MAX];
+  ssize_t len = readlink("/proc/self/exe", resolved, sizeof(resolved) - 1);
+  exe_path = len > 0 ? std::string(resolved, len) : "/proc/self/exe";
+
+  const char* channel = getenv(UPGRADE_ENV);
+  if (channel){
+    upgrade_channel = atoi(channel);
+    fcntl(upgrade_channel, F_SETFD, FD_CLOEXEC);
+    unsetenv(UPGRADE_ENV);
+  }
+
+  // every thread started from here on inherits the blocked mask, so only
+  // signal_loop() ever sees these signals and no syscall gets EINTR
+  sigemptyset(&handled);
+  sigaddset(&handled, SIGTERM);
+  sigaddset(&handled, SIGINT);
+  sigaddset(&handled, SIGUSR2);
+  pthread_sigmask(SIG_BLOCK, &handled, NULL);
+
+  return start_signal_thread();
+}
+
+int lifecycle_forked(){
+  // the parent reports readiness to an upgrading binary, not its workers
+  if (upgrade_channel >= 0) close(upgrade_channel);
+  upgrade_channel = -1;
+  close(wake[0]);
+  close(wake[1]);
+  forked_worker = true;
+  stopping = false;
+  upgrade_requested = false;
+
+  // fork() kept only the calling thread; the signals are still blocked
+  return start_signal_thread();
+}
+
+int lifecycle_inherited(int* fds, int max){
+  if (upgrade_channel < 0) return 0;
+
+  char count = 0;
+  iovec iov = { &count, 1 };
+  std::vector<char> ctrl(CMSG_SPACE(sizeof(int) * MAX_LISTENERS));
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.data();
+  msg.msg_controllen = ctrl.size();
+
+  if (recvmsg(upgrade_channel, &msg, MSG_CMSG_CLOEXEC) != 1){
+    perror("recvmsg");
+    return 0;
+  }
+
+  int n = 0;
+  for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)){
+    if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) continue;
+    int got = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    int* data = (int*)CMSG_DATA(cm);
+    for (int i = 0; i < got; i++){
+      if (n < max) fds[n++] = data[i];
+      else close(data[i]);
+    }
+  }
+  printf("[+] Took over %d listening socket(s) from the previous binary\n", n);
+  return n;
+}
+
+void lifecycle_ready(){
+  if (upgrade_channel < 0) return;
+  char ack = 1;
+  send(upgrade_channel, &ack, 1, MSG_NOSIGNAL);
+  close(upgrade_channel);
+  upgrade_channel = -1;
+}
+
+bool lifecycle_running(const int* listen_fds, int n){
+  drain_wakeups();
+  // we keep accepting until the new binary is ready; the handover thread
+  // sets stopping and wakes us once it is
+  if (upgrade_requested.exchange(false)) start_handover(listen_fds, n);
+  return !stopping;
+}
+
+bool lifecycle_stopping(){
+  return stopping;
+}
+
+int lifecycle_wait(const int* listen_fds, int n){
+  pollfd fds[MAX_LISTENERS + 1];
+  for (int i = 0; i < n; i++){
+    fds[i].fd = listen_fds[i];
+    fds[i].events = POLLIN;
+  }
+  fds[n].fd = wake[0];
+  fds[n].events = POLLIN;
+
+  if (poll(fds, n + 1, -1) < 0) return -1;
+  if (fds[n].revents) return -1;
+  for (int i = 0; i < n; i++){
+    if (fds[i].revents) return i;
+  }
+  return -1;
+}
+
+int lifecycle_wakeup_fd(){
+  return wake[0];
+}
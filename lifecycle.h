@@ -0,0 +1,95 @@
+#pragma once
+
+// max listening sockets handed over on upgrade
+const int MAX_LISTENERS = 8;
+// how long the old binary waits for the new one to report ready
+const int UPGRADE_TIMEOUT_MS = 10 * 1000;
+
+/**
+ * @brief Takes over SIGTERM, SIGINT and SIGUSR2 for graceful restarts.
+ * The signals are blocked in the calling thread (and every thread created
+ * after it) and handled by a dedicated sigwait() thread instead, so call
+ * this first thing in main(), before any worker threads exist.
+ *
+ *   SIGTERM / SIGINT  stop accepting, finish in-flight clients, exit
+ *                     (a second one exits immediately)
+ *   SIGUSR2           exec a fresh copy of the binary, pass it the
+ *                     listening sockets over SCM_RIGHTS, then drain and exit
+ *
+ * @param argv main()'s argv, reused to exec the new binary on upgrade.
+ *
+ * @return 0 if successful, -1 on error
+ */
+int lifecycle_init(char** argv);
+
+/**
+ * @brief Restarts signal handling in a worker process forked after lifecycle_init().
+ * fork() keeps only the calling thread, so the sigwait() thread is started
+ * again. SIGTERM drains the worker as usual; SIGUSR2 is ignored, since the
+ * parent owns the listening sockets and performs the upgrade.
+ *
+ * @return 0 if successful, -1 on error
+ */
+int lifecycle_forked();
+
+/**
+ * @brief Returns listening sockets passed down by the binary we replace.
+ * When started by a SIGUSR2 upgrade, the old process sends its listening
+ * fds before we create any sockets of our own; reuse them instead of
+ * calling create_listen_socket() so the backlog is never dropped.
+ *
+ * @param fds Array receiving the inherited descriptors.
+ * @param max Capacity of fds.
+ *
+ * @return Number of fds received (0 on a normal start)
+ */
+int lifecycle_inherited(int* fds, int max);
+
+/**
+ * @brief Tells the old binary (if any) that we are accepting now.
+ * Call right before entering the accept loop; the old process stops
+ * accepting and starts draining only once this has been sent.
+ */
+void lifecycle_ready();
+
+/**
+ * @brief Accept-loop condition; also starts a pending SIGUSR2 upgrade.
+ * The upgrade runs on a helper thread, so the caller never blocks waiting
+ * for the new binary; once it reports ready the wakeup socket fires and
+ * this returns false.
+ *
+ * @param listen_fds Listening sockets to hand over on upgrade.
+ * @param n          Number of sockets.
+ *
+ * @return true while the server should keep accepting new clients
+ */
+bool lifecycle_running(const int* listen_fds, int n);
+
+/**
+ * @brief Reports whether the server is draining for shutdown or upgrade.
+ * Unlike lifecycle_running() this has no side effects and is safe to call
+ * from any thread, e.g. to fail readiness checks while draining.
+ *
+ * @return true once no new clients should be sent our way
+ */
+bool lifecycle_stopping();
+
+/**
+ * @brief Blocks until a listening socket is readable or a signal arrives.
+ * Use it in front of accept_client() so shutdown and upgrade requests are
+ * noticed even while no client is connecting.
+ *
+ * @param listen_fds Listening sockets to wait on.
+ * @param n          Number of sockets.
+ *
+ * @return Index of a readable socket, or -1 if woken by a signal
+ */
+int lifecycle_wait(const int* listen_fds, int n);
+
+/**
+ * @brief Socket that becomes readable whenever a lifecycle signal arrives.
+ * Event-loop servers can watch it instead of calling lifecycle_wait().
+ *
+ * @return Read end of the wakeup socket pair
+ */
+int lifecycle_wakeup_fd();
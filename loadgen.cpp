@@ -0,0 +1,220 @@
+/**
+ * @file loadgen.cpp
+ * @brief Closed-loop HTTP load generator for comparing listener types
+ *
+ * Every connection thread repeatedly connects, sends one GET, reads the
+ * response until the server closes and records the latency of the whole
+ * exchange. The target uses the same spec syntax as the servers' --listen
+ * option, so the TCP and Unix domain socket paths can be measured side by
+ * side against one running server:
+ *
+ *   ./server_pool --listen 8080 --listen unix:/tmp/www.sock
+ *   ./loadgen --target 127.0.0.1:8080 --connections 4 --duration 5
+ *   ./loadgen --target unix:/tmp/www.sock --connections 4 --duration 5
+ *
+ * --tls speaks HTTPS (certificate not verified), to compare an --https
+ * listener with a plain one serving the same file.
+ */
+
+#include "socket.h"
+
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    const char* target = "127.0.0.1:8080";
+    const char* path = "/";
+    int connections = 4;
+    double duration_s = 5;
+    long requests = 0;      // stop after this many in total; 0 runs for duration_s
+    bool json = false;
+    bool tls = false;
+};
+
+struct Worker {
+    pthread_t thread;
+    std::vector<long long> latencies_ns;
+    long errors = 0;
+    long long bytes = 0;
+};
+
+Options opts;
+sockaddr_storage target_addr;
+socklen_t target_len;
+std::string request;
+SSL_CTX* tls_ctx = NULL;
+std::atomic<long> issued(0);
+long long deadline_ns;
+
+long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// one connect/request/response/close cycle; returns bytes received or -1
+long long one_request() {
+    int fd = ::socket(target_addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (sockaddr *)&target_addr, target_len) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    SSL* ssl = NULL;
+    if (opts.tls) {
+        // the request must not wait behind the client's Finished for an ACK
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        ssl = SSL_new(tls_ctx);
+        SSL_set_fd(ssl, fd);
+        if (SSL_connect(ssl) != 1) {
+            SSL_free(ssl);
+            close(fd);
+            return -1;
+        }
+    }
+
+    ssize_t sent = ssl ? SSL_write(ssl, request.data(), request.size())
+                       : send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    if (sent != (ssize_t)request.size()) {
+        SSL_free(ssl);
+        close(fd);
+        return -1;
+    }
+
+    char buf[16384];
+    long long total = 0;
+    bool is_http = false;
+    ssize_t n;
+    while ((n = ssl ? SSL_read(ssl, buf, sizeof(buf)) : recv(fd, buf, sizeof(buf), 0)) > 0) {
+        if (total == 0) is_http = n >= 5 && memcmp(buf, "HTTP/", 5) == 0;
+        total += n;
+    }
+    // a TLS server may close without close_notify once the response is complete
+    if (ssl) n = 0;
+    SSL_free(ssl);
+    close(fd);
+
+    // an empty, reset or non-HTTP answer counts as an error
+    if (n < 0 || !is_http) return -1;
+    return total;
+}
+
+void* worker_loop(void* arg) {
+    Worker* w = (Worker*)arg;
+    for (;;) {
+        if (opts.requests > 0) {
+            if (issued.fetch_add(1) >= opts.requests) break;
+        } else if (now_ns() >= deadline_ns) {
+            break;
+        }
+
+        long long t0 = now_ns();
+        long long got = one_request();
+        long long t1 = now_ns();
+
+        if (got < 0) {
+            w->errors++;
+        } else {
+            w->latencies_ns.push_back(t1 - t0);
+            w->bytes += got;
+        }
+    }
+    return NULL;
+}
+
+double percentile_us(const std::vector<long long> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[i] / 1000.0;
+}
+
+void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--target SPEC] [--path /uri] [--connections N]\n"
+            "          [--duration SECONDS | --requests N] [--tls] [--json]\n"
+            "SPEC is host:port, [v6addr]:port, unix:/path or unix:@abstract\n",
+            prog);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--target") == 0 && has_value) opts.target = argv[++i];
+        else if (strcmp(argv[i], "--path") == 0 && has_value) opts.path = argv[++i];
+        else if (strcmp(argv[i], "--connections") == 0 && has_value) opts.connections = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--duration") == 0 && has_value) opts.duration_s = atof(argv[++i]);
+        else if (strcmp(argv[i], "--requests") == 0 && has_value) opts.requests = atol(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0) opts.json = true;
+        else if (strcmp(argv[i], "--tls") == 0) opts.tls = true;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (resolve_socket_spec(opts.target, &target_addr, &target_len) < 0) {
+        fprintf(stderr, "bad target: %s\n", opts.target);
+        return 1;
+    }
+    if (opts.tls) {
+        // a benchmark against a self-signed certificate: no verification
+        tls_ctx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_verify(tls_ctx, SSL_VERIFY_NONE, NULL);
+    }
+    request = std::string("GET ") + opts.path + " HTTP/1.0\r\nHost: localhost\r\n\r\n";
+
+    std::vector<Worker> workers(opts.connections);
+    long long start = now_ns();
+    deadline_ns = start + (long long)(opts.duration_s * 1e9);
+    for (Worker &w : workers) {
+        if (pthread_create(&w.thread, NULL, worker_loop, &w) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    std::vector<long long> all;
+    long errors = 0;
+    long long bytes = 0;
+    for (Worker &w : workers) {
+        pthread_join(w.thread, NULL);
+        all.insert(all.end(), w.latencies_ns.begin(), w.latencies_ns.end());
+        errors += w.errors;
+        bytes += w.bytes;
+    }
+    double elapsed_s = (now_ns() - start) / 1e9;
+    std::sort(all.begin(), all.end());
+
+    double rps = all.size() / elapsed_s;
+    double p50 = percentile_us(all, 50), p90 = percentile_us(all, 90);
+    double p99 = percentile_us(all, 99), max = all.empty() ? 0 : all.back() / 1000.0;
+
+    if (opts.json) {
+        printf("{\"target\": \"%s\", \"path\": \"%s\", \"connections\": %d, \"requests\": %zu, "
+               "\"errors\": %ld, \"seconds\": %.3f, \"rps\": %.1f, \"mb_per_s\": %.2f, "
+               "\"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}\n",
+               opts.target, opts.path, opts.connections, all.size(), errors, elapsed_s, rps,
+               bytes / elapsed_s / 1e6, p50, p90, p99, max);
+    } else {
+        printf("target       %s%s (%d connections)\n", opts.target, opts.path, opts.connections);
+        printf("requests     %zu ok, %ld errors in %.2f s\n", all.size(), errors, elapsed_s);
+        printf("throughput   %.1f req/s, %.2f MB/s\n", rps, bytes / elapsed_s / 1e6);
+        printf("latency us   p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", p50, p90, p99, max);
+    }
+    return errors > 0 && all.empty() ? 1 : 0;
+}
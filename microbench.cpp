@@ -0,0 +1,323 @@
+/**
+ * @file microbench.cpp
+ * @brief Microbenchmarks for the request hot path and the thread pool hand-off
+ *
+ * Each benchmark runs a few warmup repetitions, then REPS measured ones, and
+ * reports the median and median absolute deviation (MAD) of the time per
+ * operation plus cycles per operation from rdtsc. Results go to stdout as
+ * JSON (one object per run) so runs from different commits can be diffed;
+ * a readable table goes to stderr.
+ *
+ *   make microbench
+ *   ./microbench > before.json
+ *   ./microbench --reps 31 --filter mime > after.json
+ *   ./microbench --filter cache_lookup   (EBR vs lock-guarded maps, 1-64 threads)
+ */
+
+#include "http_parser.h"
+#include "thread_pool.h"
+#include "mime_table.h"
+#include "response_cache.h"
+#include "ebr.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#ifndef BENCH_REV
+#define BENCH_REV "unknown"
+#endif
+
+namespace {
+
+const int WARMUP_REPS = 3;
+int reps = 15;
+std::string filter;
+
+struct BenchResult {
+    std::string name;
+    long ops_per_rep;
+    double median_ns;   // per operation
+    double mad_ns;
+    double min_ns;
+    double cycles;      // per operation, -1 without rdtsc
+};
+
+std::vector<BenchResult> results;
+
+long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+unsigned long long cycles_now() {
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// keeps the compiler from optimizing a benchmarked result away
+template <typename T>
+void keep(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+/**
+ * Times one benchmark. body(ops) must perform ops operations; it is called
+ * once per repetition so per-repetition setup stays outside the timings of
+ * the operations themselves.
+ */
+void run_bench(const std::string &name, long ops, const std::function<void(long)> &body) {
+    if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+    for (int i = 0; i < WARMUP_REPS; i++) body(ops);
+
+    std::vector<double> ns, cyc;
+    for (int i = 0; i < reps; i++) {
+        long long t0 = now_ns();
+        unsigned long long c0 = cycles_now();
+        body(ops);
+        unsigned long long c1 = cycles_now();
+        long long t1 = now_ns();
+        ns.push_back((double)(t1 - t0) / ops);
+        cyc.push_back((double)(c1 - c0) / ops);
+    }
+
+    BenchResult r;
+    r.name = name;
+    r.ops_per_rep = ops;
+    r.median_ns = median(ns);
+    std::vector<double> dev;
+    for (double x : ns) dev.push_back(std::fabs(x - r.median_ns));
+    r.mad_ns = median(dev);
+    r.min_ns = *std::min_element(ns.begin(), ns.end());
+#ifdef HAVE_RDTSC
+    r.cycles = median(cyc);
+#else
+    r.cycles = -1;
+#endif
+    results.push_back(r);
+
+    fprintf(stderr, "%-32s %12.1f ns/op  +/- %8.1f  %10.1f cycles/op\n",
+            name.c_str(), r.median_ns, r.mad_ns, r.cycles);
+}
+
+void print_json() {
+    printf("{\n  \"rev\": \"%s\",\n  \"reps\": %d,\n  \"timestamp\": %ld,\n  \"benchmarks\": [\n",
+           BENCH_REV, reps, (long)time(NULL));
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        printf("    {\"name\": \"%s\", \"ops_per_rep\": %ld, \"median_ns\": %.3f, "
+               "\"mad_ns\": %.3f, \"min_ns\": %.3f, \"cycles_per_op\": %.1f}%s\n",
+               r.name.c_str(), r.ops_per_rep, r.median_ns, r.mad_ns, r.min_ns, r.cycles,
+               i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+// ---------------------------------------------------------------- parser
+
+const char* SAMPLE_REQUEST =
+    "GET /images/johnpork.jpeg HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: curl/7.88.1\r\n"
+    "Accept: */*\r\n"
+    "\r\n";
+
+const char* SAMPLE_PATHS[] = {
+    "./www/index.html", "./www/css/site.css", "./www/js/app.js",
+    "./www/johnpork.jpeg", "./www/fonts/inter.woff2", "./www/data.bin",
+};
+const int NUM_SAMPLE_PATHS = sizeof(SAMPLE_PATHS) / sizeof(SAMPLE_PATHS[0]);
+
+void bench_parser() {
+    size_t len = strlen(SAMPLE_REQUEST);
+    run_bench("parse_request_line", 200000, [len](long ops) {
+        for (long i = 0; i < ops; i++) {
+            std::string method, uri, version;
+            parse_request_line(SAMPLE_REQUEST, len, method, uri, version);
+            keep(uri);
+        }
+    });
+
+    std::vector<std::string> paths(SAMPLE_PATHS, SAMPLE_PATHS + NUM_SAMPLE_PATHS);
+    run_bench("guess_mime", 1000000, [&paths](long ops) {
+        for (long i = 0; i < ops; i++) {
+            std::string mime = guess_mime(paths[i % NUM_SAMPLE_PATHS]);
+            keep(mime);
+        }
+    });
+
+    // raw perfect-hash lookups, without building the Content-Type string
+    run_bench("mime_lookup", 1000000, [&paths](long ops) {
+        for (long i = 0; i < ops; i++) {
+            const MimeEntry* m = mime_lookup(paths[i % NUM_SAMPLE_PATHS]);
+            keep(m);
+        }
+    });
+
+    std::vector<std::string> uris = {"/", "/index.html", "/johnpork.jpeg", "/css/site.css"};
+    run_bench("route_lookup", 1000000, [&uris](long ops) {
+        for (long i = 0; i < ops; i++) {
+            const RouteEntry* r = route_lookup(uris[i % uris.size()]);
+            keep(r);
+        }
+    });
+
+    run_bench("fs_path", 1000000, [&uris](long ops) {
+        for (long i = 0; i < ops; i++) {
+            std::string path = fs_path(uris[i % uris.size()]);
+            keep(path);
+        }
+    });
+
+    run_bench("serialize_headers", 500000, [](long ops) {
+        for (long i = 0; i < ops; i++) {
+            std::string head = serialize_headers(200, "OK", "image/jpeg", 238097 + (i & 7));
+            keep(head);
+        }
+    });
+}
+
+// ----------------------------------------------------------- thread pool
+
+std::atomic<long> handled(0);
+
+void count_task(int) {
+    handled.fetch_add(1, std::memory_order_relaxed);
+}
+
+// enqueue -> dequeue -> handler round trips through a pool of n workers
+void bench_pool() {
+    const int THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32, 64};
+    for (int threads : THREAD_COUNTS) {
+        ThreadPool pool;
+        if (pool_init_handler(&pool, threads, count_task) < 0) return;
+
+        run_bench("pool_handoff/" + std::to_string(threads), 20000, [&pool](long ops) {
+            long target = handled.load() + ops;
+            for (long i = 0; i < ops; i++) pool_enqueue(&pool, 1000 + (int)(i % 1000));
+            // the rep ends when the last task has actually been handled
+            while (handled.load() < target) sched_yield();
+        });
+
+        pool_destroy(&pool);
+    }
+}
+
+// --------------------------------------------------------- response cache
+
+const int CACHE_PATHS = 64;
+const int CACHE_THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32, 64};
+
+// splits ops lookups over n threads; the rep ends when the last one finishes
+void run_threads(int n, long ops, const std::function<void(long first, long count)> &work) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n; t++) {
+        long first = ops * t / n;
+        long count = ops * (t + 1) / n - first;
+        threads.emplace_back(work, first, count);
+    }
+    for (std::thread &t : threads) t.join();
+}
+
+// the same small-response lookup through EBR and through the usual locks
+void bench_cache() {
+    std::vector<std::string> paths;
+    for (int i = 0; i < CACHE_PATHS; i++) paths.push_back("./www/page" + std::to_string(i) + ".html");
+    std::string body(4096, 'x');
+
+    ResponseCache cache;
+    response_cache_init(&cache, CACHE_PATHS);
+    std::unordered_map<std::string, std::string> map;
+    for (const std::string &p : paths) {
+        CachedResponse* c = new CachedResponse();
+        c->path = p;
+        c->bytes = body;
+        c->header_len = 0;
+        c->cache_control = NULL;
+        c->expires_ms = 1LL << 62;
+        response_cache_insert(&cache, c, response_cache_generation(&cache));
+        map[p] = body;
+    }
+    std::mutex mutex;
+    std::shared_mutex rwlock;
+
+    for (int threads : CACHE_THREAD_COUNTS) {
+        std::string n = std::to_string(threads);
+
+        run_bench("cache_lookup/ebr/" + n, 400000, [&](long ops) {
+            run_threads(threads, ops, [&](long first, long count) {
+                for (long i = first; i < first + count; i++) {
+                    ebr_enter();
+                    const CachedResponse* c = response_cache_lookup(&cache, paths[i % CACHE_PATHS], 0);
+                    keep(c->bytes.size());
+                    ebr_exit();
+                }
+            });
+        });
+
+        run_bench("cache_lookup/mutex/" + n, 400000, [&](long ops) {
+            run_threads(threads, ops, [&](long first, long count) {
+                for (long i = first; i < first + count; i++) {
+                    std::lock_guard<std::mutex> guard(mutex);
+                    keep(map.find(paths[i % CACHE_PATHS])->second.size());
+                }
+            });
+        });
+
+        run_bench("cache_lookup/shared_mutex/" + n, 400000, [&](long ops) {
+            run_threads(threads, ops, [&](long first, long count) {
+                for (long i = first; i < first + count; i++) {
+                    std::shared_lock<std::shared_mutex> guard(rwlock);
+                    keep(map.find(paths[i % CACHE_PATHS])->second.size());
+                }
+            });
+        });
+    }
+
+    response_cache_destroy(&cache);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) reps = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--reps N] [--filter SUBSTRING]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench_parser();
+    bench_pool();
+    bench_cache();
+
+    print_json();
+    return 0;
+}
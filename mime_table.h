@@ -0,0 +1,603 @@
+#pragma once
+
+#include "perfect_hash.h"
+
+/**
+ * Compile-time extension -> MIME table and reserved route table.
+ *
+ * Both are looked up through a perfect hash built by the compiler, so
+ * guess_mime() and the route check cost one hash and one compare per request
+ * no matter how many entries there are. Extension matching is
+ * case-insensitive ("PHOTO.JPG" is image/jpeg); routes match exactly.
+ */
+
+// how long a response may be reused by browsers and proxies
+enum MimeCache {
+    CACHE_REVALIDATE,   // documents: "no-cache", always revalidate
+    CACHE_STATIC,       // assets: "public, max-age=86400"
+};
+
+/**
+  * @struct MimeEntry
+  * @brief One known file extension
+  * @var key     Lower-case extension without the dot
+  * @var type    Content-Type value
+  * @var charset Textual type, sent with "; charset=utf-8"
+  * @var cache   Cacheability class for Cache-Control
+*/
+struct MimeEntry {
+    std::string_view key;
+    const char* type;
+    bool charset;
+    MimeCache cache;
+};
+
+constexpr MimeEntry MIME_TABLE[] = {
+    {"html", "text/html", true, CACHE_REVALIDATE},
+    {"htm", "text/html", true, CACHE_REVALIDATE},
+    {"css", "text/css", true, CACHE_STATIC},
+    {"js", "application/javascript", true, CACHE_STATIC},
+    {"mjs", "application/javascript", true, CACHE_STATIC},
+    {"json", "application/json", true, CACHE_REVALIDATE},
+    {"txt", "text/plain", true, CACHE_REVALIDATE},
+    {"png", "image/png", false, CACHE_STATIC},
+    {"jpg", "image/jpeg", false, CACHE_STATIC},
+    {"jpeg", "image/jpeg", false, CACHE_STATIC},
+    {"gif", "image/gif", false, CACHE_STATIC},
+    {"svg", "image/svg+xml", true, CACHE_STATIC},
+    {"webp", "image/webp", false, CACHE_STATIC},
+    {"avif", "image/avif", false, CACHE_STATIC},
+    {"ico", "image/x-icon", false, CACHE_STATIC},
+    {"woff", "font/woff", false, CACHE_STATIC},
+    {"woff2", "font/woff2", false, CACHE_STATIC},
+    {"ttf", "font/ttf", false, CACHE_STATIC},
+    {"otf", "font/otf", false, CACHE_STATIC},
+    {"wasm", "application/wasm", false, CACHE_STATIC},
+    {"mp4", "video/mp4", false, CACHE_STATIC},
+    {"webm", "video/webm", false, CACHE_STATIC},
+    {"mp3", "audio/mpeg", false, CACHE_STATIC},
+    {"ogg", "audio/ogg", false, CACHE_STATIC},
+    {"pdf", "application/pdf", false, CACHE_STATIC},
+    {"xml", "application/xml", true, CACHE_REVALIDATE},
+    {"webmanifest", "application/manifest+json", true, CACHE_REVALIDATE},
+    {"map", "application/json", true, CACHE_REVALIDATE},
+    {"atom", "application/atom+xml", true, CACHE_REVALIDATE},
+    {"epub", "application/epub+zip", false, CACHE_STATIC},
+    {"gz", "application/gzip", false, CACHE_STATIC},
+    {"tgz", "application/gzip", false, CACHE_STATIC},
+    {"jar", "application/java-archive", false, CACHE_STATIC},
+    {"class", "application/java-vm", false, CACHE_STATIC},
+    {"jsonld", "application/ld+json", true, CACHE_REVALIDATE},
+    {"doc", "application/msword", false, CACHE_STATIC},
+    {"bin", "application/octet-stream", false, CACHE_STATIC},
+    {"key", "application/octet-stream", false, CACHE_STATIC},
+    {"ogx", "application/ogg", false, CACHE_STATIC},
+    {"pgp", "application/pgp-encrypted", false, CACHE_STATIC},
+    {"asc", "application/pgp-signature", false, CACHE_STATIC},
+    {"sig", "application/pgp-signature", false, CACHE_STATIC},
+    {"p12", "application/pkcs12", false, CACHE_STATIC},
+    {"pfx", "application/pkcs12", false, CACHE_STATIC},
+    {"p7s", "application/pkcs7-signature", false, CACHE_STATIC},
+    {"cer", "application/pkix-cert", false, CACHE_STATIC},
+    {"crl", "application/pkix-crl", false, CACHE_STATIC},
+    {"eps", "application/postscript", false, CACHE_STATIC},
+    {"ps", "application/postscript", false, CACHE_STATIC},
+    {"rdf", "application/rdf+xml", true, CACHE_STATIC},
+    {"rtf", "application/rtf", false, CACHE_STATIC},
+    {"sql", "application/sql", false, CACHE_STATIC},
+    {"swf", "application/vnd.adobe.flash.movie", false, CACHE_STATIC},
+    {"apk", "application/vnd.android.package-archive", false, CACHE_STATIC},
+    {"m3u8", "application/vnd.apple.mpegurl", false, CACHE_REVALIDATE},
+    {"deb", "application/vnd.debian.binary-package", false, CACHE_STATIC},
+    {"cab", "application/vnd.ms-cab-compressed", false, CACHE_STATIC},
+    {"xls", "application/vnd.ms-excel", false, CACHE_STATIC},
+    {"ppt", "application/vnd.ms-powerpoint", false, CACHE_STATIC},
+    {"odp", "application/vnd.oasis.opendocument.presentation", false, CACHE_STATIC},
+    {"ods", "application/vnd.oasis.opendocument.spreadsheet", false, CACHE_STATIC},
+    {"odt", "application/vnd.oasis.opendocument.text", false, CACHE_STATIC},
+    {"pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation", false, CACHE_STATIC},
+    {"xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet", false, CACHE_STATIC},
+    {"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document", false, CACHE_STATIC},
+    {"rar", "application/vnd.rar", false, CACHE_STATIC},
+    {"wsdl", "application/wsdl+xml", false, CACHE_STATIC},
+    {"7z", "application/x-7z-compressed", false, CACHE_STATIC},
+    {"dmg", "application/x-apple-diskimage", false, CACHE_STATIC},
+    {"torrent", "application/x-bittorrent", false, CACHE_STATIC},
+    {"csh", "application/x-csh", false, CACHE_STATIC},
+    {"iso", "application/x-iso9660-image", false, CACHE_STATIC},
+    {"latex", "application/x-latex", false, CACHE_STATIC},
+    {"dll", "application/x-msdos-program", false, CACHE_STATIC},
+    {"exe", "application/x-msdos-program", false, CACHE_STATIC},
+    {"msi", "application/x-msi", false, CACHE_STATIC},
+    {"pem", "application/x-pem-file", false, CACHE_STATIC},
+    {"rpm", "application/x-redhat-package-manager", false, CACHE_STATIC},
+    {"rss", "application/x-rss+xml", false, CACHE_STATIC},
+    {"sh", "application/x-sh", false, CACHE_STATIC},
+    {"tar", "application/x-tar", false, CACHE_STATIC},
+    {"crt", "application/x-x509-ca-cert", false, CACHE_STATIC},
+    {"xz", "application/x-xz", false, CACHE_STATIC},
+    {"xht", "application/xhtml+xml", true, CACHE_REVALIDATE},
+    {"xhtml", "application/xhtml+xml", true, CACHE_REVALIDATE},
+    {"dtd", "application/xml-dtd", false, CACHE_STATIC},
+    {"xsl", "application/xslt+xml", true, CACHE_STATIC},
+    {"xslt", "application/xslt+xml", true, CACHE_STATIC},
+    {"zip", "application/zip", false, CACHE_STATIC},
+    {"726", "audio/32kadpcm", false, CACHE_STATIC},
+    {"amr", "audio/AMR", false, CACHE_STATIC},
+    {"awb", "audio/AMR-WB", false, CACHE_STATIC},
+    {"aal", "audio/ATRAC-ADVANCED-LOSSLESS", false, CACHE_STATIC},
+    {"atx", "audio/ATRAC-X", false, CACHE_STATIC},
+    {"aa3", "audio/ATRAC3", false, CACHE_STATIC},
+    {"at3", "audio/ATRAC3", false, CACHE_STATIC},
+    {"omg", "audio/ATRAC3", false, CACHE_STATIC},
+    {"evc", "audio/EVRC", false, CACHE_STATIC},
+    {"qcp", "audio/EVRC-QCP", false, CACHE_STATIC},
+    {"evb", "audio/EVRCB", false, CACHE_STATIC},
+    {"enw", "audio/EVRCNW", false, CACHE_STATIC},
+    {"evw", "audio/EVRCWB", false, CACHE_STATIC},
+    {"l16", "audio/L16", false, CACHE_STATIC},
+    {"smv", "audio/SMV", false, CACHE_STATIC},
+    {"aac", "audio/aac", false, CACHE_STATIC},
+    {"adts", "audio/aac", false, CACHE_STATIC},
+    {"ass", "audio/aac", false, CACHE_STATIC},
+    {"ac3", "audio/ac3", false, CACHE_STATIC},
+    {"axa", "audio/annodex", false, CACHE_STATIC},
+    {"acn", "audio/asc", false, CACHE_STATIC},
+    {"au", "audio/basic", false, CACHE_STATIC},
+    {"snd", "audio/basic", false, CACHE_STATIC},
+    {"csd", "audio/csound", false, CACHE_STATIC},
+    {"orc", "audio/csound", false, CACHE_STATIC},
+    {"sco", "audio/csound", false, CACHE_STATIC},
+    {"dls", "audio/dls", false, CACHE_STATIC},
+    {"flac", "audio/flac", false, CACHE_STATIC},
+    {"lbc", "audio/iLBC", false, CACHE_STATIC},
+    {"mhas", "audio/mhas", false, CACHE_STATIC},
+    {"mxmf", "audio/mobile-xmf", false, CACHE_STATIC},
+    {"m4a", "audio/mp4", false, CACHE_STATIC},
+    {"mp1", "audio/mpeg", false, CACHE_STATIC},
+    {"mp2", "audio/mpeg", false, CACHE_STATIC},
+    {"mpega", "audio/mpeg", false, CACHE_STATIC},
+    {"mpga", "audio/mpeg", false, CACHE_STATIC},
+    {"m3u", "audio/mpegurl", false, CACHE_STATIC},
+    {"oga", "audio/ogg", false, CACHE_STATIC},
+    {"opus", "audio/ogg", false, CACHE_STATIC},
+    {"spx", "audio/ogg", false, CACHE_STATIC},
+    {"psid", "audio/prs.sid", false, CACHE_STATIC},
+    {"sid", "audio/prs.sid", false, CACHE_STATIC},
+    {"sofa", "audio/sofa", false, CACHE_STATIC},
+    {"mid", "audio/sp-midi", false, CACHE_STATIC},
+    {"loas", "audio/usac", false, CACHE_STATIC},
+    {"xhe", "audio/usac", false, CACHE_STATIC},
+    {"koz", "audio/vnd.audiokoz", false, CACHE_STATIC},
+    {"uva", "audio/vnd.dece.audio", false, CACHE_STATIC},
+    {"uvva", "audio/vnd.dece.audio", false, CACHE_STATIC},
+    {"eol", "audio/vnd.digital-winds", false, CACHE_STATIC},
+    {"mlp", "audio/vnd.dolby.mlp", false, CACHE_STATIC},
+    {"dts", "audio/vnd.dts", false, CACHE_STATIC},
+    {"dtshd", "audio/vnd.dts.hd", false, CACHE_STATIC},
+    {"plj", "audio/vnd.everad.plj", false, CACHE_STATIC},
+    {"lvp", "audio/vnd.lucent.voice", false, CACHE_STATIC},
+    {"pya", "audio/vnd.ms-playready.media.pya", false, CACHE_STATIC},
+    {"vbk", "audio/vnd.nortel.vbk", false, CACHE_STATIC},
+    {"ecelp4800", "audio/vnd.nuera.ecelp4800", false, CACHE_STATIC},
+    {"ecelp7470", "audio/vnd.nuera.ecelp7470", false, CACHE_STATIC},
+    {"ecelp9600", "audio/vnd.nuera.ecelp9600", false, CACHE_STATIC},
+    {"multitrack", "audio/vnd.presonus.multitrack", false, CACHE_STATIC},
+    {"rip", "audio/vnd.rip", false, CACHE_STATIC},
+    {"s1m", "audio/vnd.sealedmedia.softseal.mpeg", false, CACHE_STATIC},
+    {"smp", "audio/vnd.sealedmedia.softseal.mpeg", false, CACHE_STATIC},
+    {"smp3", "audio/vnd.sealedmedia.softseal.mpeg", false, CACHE_STATIC},
+    {"wav", "audio/wav", false, CACHE_STATIC},
+    {"aif", "audio/x-aiff", false, CACHE_STATIC},
+    {"aifc", "audio/x-aiff", false, CACHE_STATIC},
+    {"aiff", "audio/x-aiff", false, CACHE_STATIC},
+    {"gsm", "audio/x-gsm", false, CACHE_STATIC},
+    {"wax", "audio/x-ms-wax", false, CACHE_STATIC},
+    {"wma", "audio/x-ms-wma", false, CACHE_STATIC},
+    {"ra", "audio/x-pn-realaudio", false, CACHE_STATIC},
+    {"ram", "audio/x-pn-realaudio", false, CACHE_STATIC},
+    {"rm", "audio/x-pn-realaudio", false, CACHE_STATIC},
+    {"pls", "audio/x-scpls", false, CACHE_STATIC},
+    {"sd2", "audio/x-sd2", false, CACHE_STATIC},
+    {"ttc", "font/collection", false, CACHE_STATIC},
+    {"exr", "image/aces", false, CACHE_STATIC},
+    {"apng", "image/apng", false, CACHE_STATIC},
+    {"avci", "image/avci", false, CACHE_STATIC},
+    {"avcs", "image/avcs", false, CACHE_STATIC},
+    {"hif", "image/avif", false, CACHE_STATIC},
+    {"bmp", "image/bmp", false, CACHE_STATIC},
+    {"cgm", "image/cgm", false, CACHE_STATIC},
+    {"drle", "image/dicom-rle", false, CACHE_STATIC},
+    {"dpx", "image/dpx", false, CACHE_STATIC},
+    {"emf", "image/emf", false, CACHE_STATIC},
+    {"fit", "image/fits", false, CACHE_STATIC},
+    {"fits", "image/fits", false, CACHE_STATIC},
+    {"fts", "image/fits", false, CACHE_STATIC},
+    {"heic", "image/heic", false, CACHE_STATIC},
+    {"heics", "image/heic-sequence", false, CACHE_STATIC},
+    {"heif", "image/heif", false, CACHE_STATIC},
+    {"heifs", "image/heif-sequence", false, CACHE_STATIC},
+    {"hej2", "image/hej2k", false, CACHE_STATIC},
+    {"hsj2", "image/hsj2", false, CACHE_STATIC},
+    {"ief", "image/ief", false, CACHE_STATIC},
+    {"jls", "image/jls", false, CACHE_STATIC},
+    {"jp2", "image/jp2", false, CACHE_STATIC},
+    {"jpg2", "image/jp2", false, CACHE_STATIC},
+    {"jfif", "image/jpeg", false, CACHE_STATIC},
+    {"jpe", "image/jpeg", false, CACHE_STATIC},
+    {"jph", "image/jph", false, CACHE_STATIC},
+    {"jhc", "image/jphc", false, CACHE_STATIC},
+    {"jphc", "image/jphc", false, CACHE_STATIC},
+    {"jpgm", "image/jpm", false, CACHE_STATIC},
+    {"jpm", "image/jpm", false, CACHE_STATIC},
+    {"jpf", "image/jpx", false, CACHE_STATIC},
+    {"jpx", "image/jpx", false, CACHE_STATIC},
+    {"jxl", "image/jxl", false, CACHE_STATIC},
+    {"jxr", "image/jxr", false, CACHE_STATIC},
+    {"jxra", "image/jxrA", false, CACHE_STATIC},
+    {"jxrs", "image/jxrS", false, CACHE_STATIC},
+    {"jxs", "image/jxs", false, CACHE_STATIC},
+    {"jxsc", "image/jxsc", false, CACHE_STATIC},
+    {"jxsi", "image/jxsi", false, CACHE_STATIC},
+    {"jxss", "image/jxss", false, CACHE_STATIC},
+    {"ktx", "image/ktx", false, CACHE_STATIC},
+    {"ktx2", "image/ktx2", false, CACHE_STATIC},
+    {"btf", "image/prs.btif", false, CACHE_STATIC},
+    {"btif", "image/prs.btif", false, CACHE_STATIC},
+    {"pti", "image/prs.pti", false, CACHE_STATIC},
+    {"svgz", "image/svg+xml", true, CACHE_STATIC},
+    {"tif", "image/tiff", false, CACHE_STATIC},
+    {"tiff", "image/tiff", false, CACHE_STATIC},
+    {"tfx", "image/tiff-fx", false, CACHE_STATIC},
+    {"psd", "image/vnd.adobe.photoshop", false, CACHE_STATIC},
+    {"azv", "image/vnd.airzip.accelerator.azv", false, CACHE_STATIC},
+    {"uvg", "image/vnd.dece.graphic", false, CACHE_STATIC},
+    {"uvi", "image/vnd.dece.graphic", false, CACHE_STATIC},
+    {"uvvg", "image/vnd.dece.graphic", false, CACHE_STATIC},
+    {"uvvi", "image/vnd.dece.graphic", false, CACHE_STATIC},
+    {"djv", "image/vnd.djvu", false, CACHE_STATIC},
+    {"djvu", "image/vnd.djvu", false, CACHE_STATIC},
+    {"dwg", "image/vnd.dwg", false, CACHE_STATIC},
+    {"dxf", "image/vnd.dxf", false, CACHE_STATIC},
+    {"fbs", "image/vnd.fastbidsheet", false, CACHE_STATIC},
+    {"fpx", "image/vnd.fpx", false, CACHE_STATIC},
+    {"fst", "image/vnd.fst", false, CACHE_STATIC},
+    {"mmr", "image/vnd.fujixerox.edmics-mmr", false, CACHE_STATIC},
+    {"rlc", "image/vnd.fujixerox.edmics-rlc", false, CACHE_STATIC},
+    {"pgb", "image/vnd.globalgraphics.pgb", false, CACHE_STATIC},
+    {"mdi", "image/vnd.ms-modi", false, CACHE_STATIC},
+    {"b16", "image/vnd.pco.b16", false, CACHE_STATIC},
+    {"hdr", "image/vnd.radiance", false, CACHE_STATIC},
+    {"rgbe", "image/vnd.radiance", false, CACHE_STATIC},
+    {"xyze", "image/vnd.radiance", false, CACHE_STATIC},
+    {"s1n", "image/vnd.sealed.png", false, CACHE_STATIC},
+    {"spn", "image/vnd.sealed.png", false, CACHE_STATIC},
+    {"spng", "image/vnd.sealed.png", false, CACHE_STATIC},
+    {"s1g", "image/vnd.sealedmedia.softseal.gif", false, CACHE_STATIC},
+    {"sgi", "image/vnd.sealedmedia.softseal.gif", false, CACHE_STATIC},
+    {"sgif", "image/vnd.sealedmedia.softseal.gif", false, CACHE_STATIC},
+    {"s1j", "image/vnd.sealedmedia.softseal.jpg", false, CACHE_STATIC},
+    {"sjp", "image/vnd.sealedmedia.softseal.jpg", false, CACHE_STATIC},
+    {"sjpg", "image/vnd.sealedmedia.softseal.jpg", false, CACHE_STATIC},
+    {"tap", "image/vnd.tencent.tap", false, CACHE_STATIC},
+    {"vtf", "image/vnd.valve.source.texture", false, CACHE_STATIC},
+    {"wbmp", "image/vnd.wap.wbmp", false, CACHE_STATIC},
+    {"xif", "image/vnd.xiff", false, CACHE_STATIC},
+    {"pcx", "image/vnd.zbrush.pcx", false, CACHE_STATIC},
+    {"wmf", "image/wmf", false, CACHE_STATIC},
+    {"cr2", "image/x-canon-cr2", false, CACHE_STATIC},
+    {"crw", "image/x-canon-crw", false, CACHE_STATIC},
+    {"ras", "image/x-cmu-raster", false, CACHE_STATIC},
+    {"cdr", "image/x-coreldraw", false, CACHE_STATIC},
+    {"pat", "image/x-coreldrawpattern", false, CACHE_STATIC},
+    {"cdt", "image/x-coreldrawtemplate", false, CACHE_STATIC},
+    {"erf", "image/x-epson-erf", false, CACHE_STATIC},
+    {"art", "image/x-jg", false, CACHE_STATIC},
+    {"jng", "image/x-jng", false, CACHE_STATIC},
+    {"nef", "image/x-nikon-nef", false, CACHE_STATIC},
+    {"orf", "image/x-olympus-orf", false, CACHE_STATIC},
+    {"pnm", "image/x-portable-anymap", false, CACHE_STATIC},
+    {"pbm", "image/x-portable-bitmap", false, CACHE_STATIC},
+    {"pgm", "image/x-portable-graymap", false, CACHE_STATIC},
+    {"ppm", "image/x-portable-pixmap", false, CACHE_STATIC},
+    {"rgb", "image/x-rgb", false, CACHE_STATIC},
+    {"xbm", "image/x-xbitmap", false, CACHE_STATIC},
+    {"xcf", "image/x-xcf", false, CACHE_STATIC},
+    {"xpm", "image/x-xpixmap", false, CACHE_STATIC},
+    {"xwd", "image/x-xwindowdump", false, CACHE_STATIC},
+    {"jt", "model/JT", false, CACHE_STATIC},
+    {"gltf", "model/gltf+json", true, CACHE_STATIC},
+    {"glb", "model/gltf-binary", false, CACHE_STATIC},
+    {"iges", "model/iges", false, CACHE_STATIC},
+    {"igs", "model/iges", false, CACHE_STATIC},
+    {"mesh", "model/mesh", false, CACHE_STATIC},
+    {"msh", "model/mesh", false, CACHE_STATIC},
+    {"silo", "model/mesh", false, CACHE_STATIC},
+    {"mtl", "model/mtl", false, CACHE_STATIC},
+    {"obj", "model/obj", false, CACHE_STATIC},
+    {"prc", "model/prc", false, CACHE_STATIC},
+    {"step", "model/step", false, CACHE_STATIC},
+    {"stp", "model/step", false, CACHE_STATIC},
+    {"stpx", "model/step+xml", false, CACHE_STATIC},
+    {"stpz", "model/step+zip", false, CACHE_STATIC},
+    {"stpxz", "model/step-xml+zip", false, CACHE_STATIC},
+    {"stl", "model/stl", false, CACHE_STATIC},
+    {"u3d", "model/u3d", false, CACHE_STATIC},
+    {"cld", "model/vnd.cld", false, CACHE_STATIC},
+    {"dae", "model/vnd.collada+xml", false, CACHE_STATIC},
+    {"dwf", "model/vnd.dwf", false, CACHE_STATIC},
+    {"dor", "model/vnd.gdl", false, CACHE_STATIC},
+    {"gdl", "model/vnd.gdl", false, CACHE_STATIC},
+    {"ism", "model/vnd.gdl", false, CACHE_STATIC},
+    {"lmp", "model/vnd.gdl", false, CACHE_STATIC},
+    {"msm", "model/vnd.gdl", false, CACHE_STATIC},
+    {"rsm", "model/vnd.gdl", false, CACHE_STATIC},
+    {"win", "model/vnd.gdl", false, CACHE_STATIC},
+    {"gtw", "model/vnd.gtw", false, CACHE_STATIC},
+    {"moml", "model/vnd.moml+xml", false, CACHE_STATIC},
+    {"mts", "model/vnd.mts", false, CACHE_STATIC},
+    {"ogex", "model/vnd.opengex", false, CACHE_STATIC},
+    {"x_b", "model/vnd.parasolid.transmit.binary", false, CACHE_STATIC},
+    {"xmt_bin", "model/vnd.parasolid.transmit.binary", false, CACHE_STATIC},
+    {"x_t", "model/vnd.parasolid.transmit.text", false, CACHE_STATIC},
+    {"xmt_txt", "model/vnd.parasolid.transmit.text", false, CACHE_STATIC},
+    {"pyox", "model/vnd.pytha.pyox", false, CACHE_STATIC},
+    {"vds", "model/vnd.sap.vds", false, CACHE_STATIC},
+    {"usda", "model/vnd.usda", false, CACHE_STATIC},
+    {"usdz", "model/vnd.usdz+zip", false, CACHE_STATIC},
+    {"bsp", "model/vnd.valve.source.compiled-map", false, CACHE_STATIC},
+    {"vtu", "model/vnd.vtu", false, CACHE_STATIC},
+    {"vrm", "model/vrml", false, CACHE_STATIC},
+    {"vrml", "model/vrml", false, CACHE_STATIC},
+    {"wrl", "model/vrml", false, CACHE_STATIC},
+    {"x3db", "model/x3d+fastinfoset", false, CACHE_STATIC},
+    {"x3d", "model/x3d+xml", false, CACHE_STATIC},
+    {"x3dz", "model/x3d+xml", false, CACHE_STATIC},
+    {"x3dv", "model/x3d-vrml", false, CACHE_STATIC},
+    {"x3dvz", "model/x3d-vrml", false, CACHE_STATIC},
+    {"sgm", "text/SGML", true, CACHE_STATIC},
+    {"sgml", "text/SGML", true, CACHE_STATIC},
+    {"appcache", "text/cache-manifest", true, CACHE_STATIC},
+    {"manifest", "text/cache-manifest", true, CACHE_STATIC},
+    {"ics", "text/calendar", true, CACHE_STATIC},
+    {"ifb", "text/calendar", true, CACHE_STATIC},
+    {"cql", "text/cql", true, CACHE_STATIC},
+    {"csv", "text/csv", true, CACHE_REVALIDATE},
+    {"csvs", "text/csv-schema", true, CACHE_STATIC},
+    {"soa", "text/dns", true, CACHE_STATIC},
+    {"zone", "text/dns", true, CACHE_STATIC},
+    {"gff3", "text/gff3", true, CACHE_STATIC},
+    {"shtml", "text/html", true, CACHE_REVALIDATE},
+    {"es", "text/javascript", true, CACHE_STATIC},
+    {"cnd", "text/jcr-cnd", true, CACHE_STATIC},
+    {"markdown", "text/markdown", true, CACHE_REVALIDATE},
+    {"md", "text/markdown", true, CACHE_REVALIDATE},
+    {"miz", "text/mizar", true, CACHE_STATIC},
+    {"n3", "text/n3", true, CACHE_STATIC},
+    {"brf", "text/plain", true, CACHE_REVALIDATE},
+    {"pot", "text/plain", true, CACHE_REVALIDATE},
+    {"srt", "text/plain", true, CACHE_REVALIDATE},
+    {"text", "text/plain", true, CACHE_REVALIDATE},
+    {"provn", "text/provenance-notation", true, CACHE_STATIC},
+    {"rst", "text/prs.fallenstein.rst", true, CACHE_STATIC},
+    {"dsc", "text/prs.lines.tag", true, CACHE_STATIC},
+    {"tag", "text/prs.lines.tag", true, CACHE_STATIC},
+    {"shaclc", "text/shaclc", true, CACHE_STATIC},
+    {"shc", "text/shaclc", true, CACHE_STATIC},
+    {"shex", "text/shex", true, CACHE_STATIC},
+    {"spdx", "text/spdx", true, CACHE_STATIC},
+    {"tsv", "text/tab-separated-values", true, CACHE_STATIC},
+    {"tm", "text/texmacs", true, CACHE_STATIC},
+    {"roff", "text/troff", true, CACHE_STATIC},
+    {"t", "text/troff", true, CACHE_STATIC},
+    {"tr", "text/troff", true, CACHE_STATIC},
+    {"ttl", "text/turtle", true, CACHE_STATIC},
+    {"uri", "text/uri-list", true, CACHE_STATIC},
+    {"uris", "text/uri-list", true, CACHE_STATIC},
+    {"vcard", "text/vcard", true, CACHE_STATIC},
+    {"vcf", "text/vcard", true, CACHE_STATIC},
+    {"dms", "text/vnd.DMClientScript", true, CACHE_STATIC},
+    {"a", "text/vnd.a", true, CACHE_STATIC},
+    {"abc", "text/vnd.abc", true, CACHE_STATIC},
+    {"ascii", "text/vnd.ascii-art", true, CACHE_STATIC},
+    {"curl", "text/vnd.curl", true, CACHE_STATIC},
+    {"copyright", "text/vnd.debian.copyright", true, CACHE_STATIC},
+    {"jtd", "text/vnd.esmertec.theme-descriptor", true, CACHE_STATIC},
+    {"vfk", "text/vnd.exchangeable", true, CACHE_STATIC},
+    {"ged", "text/vnd.familysearch.gedcom", true, CACHE_STATIC},
+    {"flt", "text/vnd.ficlab.flt", true, CACHE_STATIC},
+    {"fly", "text/vnd.fly", true, CACHE_STATIC},
+    {"flx", "text/vnd.fmi.flexstor", true, CACHE_STATIC},
+    {"dot", "text/vnd.graphviz", true, CACHE_STATIC},
+    {"gv", "text/vnd.graphviz", true, CACHE_STATIC},
+    {"hans", "text/vnd.hans", true, CACHE_STATIC},
+    {"hgl", "text/vnd.hgl", true, CACHE_STATIC},
+    {"3dm", "text/vnd.in3d.3dml", true, CACHE_STATIC},
+    {"3dml", "text/vnd.in3d.3dml", true, CACHE_STATIC},
+    {"spo", "text/vnd.in3d.spot", true, CACHE_STATIC},
+    {"spot", "text/vnd.in3d.spot", true, CACHE_STATIC},
+    {"mpf", "text/vnd.ms-mediapackage", true, CACHE_STATIC},
+    {"ccc", "text/vnd.net2phone.commcenter.command", true, CACHE_STATIC},
+    {"mc2", "text/vnd.senx.warpscript", true, CACHE_STATIC},
+    {"sos", "text/vnd.sosi", true, CACHE_STATIC},
+    {"jad", "text/vnd.sun.j2me.app-descriptor", true, CACHE_STATIC},
+    {"si", "text/vnd.wap.si", true, CACHE_STATIC},
+    {"sl", "text/vnd.wap.sl", true, CACHE_STATIC},
+    {"wml", "text/vnd.wap.wml", true, CACHE_STATIC},
+    {"wmls", "text/vnd.wap.wmlscript", true, CACHE_STATIC},
+    {"vtt", "text/vtt", true, CACHE_STATIC},
+    {"wgsl", "text/wgsl", true, CACHE_STATIC},
+    {"bib", "text/x-bibtex", true, CACHE_STATIC},
+    {"boo", "text/x-boo", true, CACHE_STATIC},
+    {"h++", "text/x-c++hdr", true, CACHE_STATIC},
+    {"hh", "text/x-c++hdr", true, CACHE_STATIC},
+    {"hpp", "text/x-c++hdr", true, CACHE_STATIC},
+    {"hxx", "text/x-c++hdr", true, CACHE_STATIC},
+    {"c++", "text/x-c++src", true, CACHE_STATIC},
+    {"cc", "text/x-c++src", true, CACHE_STATIC},
+    {"cpp", "text/x-c++src", true, CACHE_STATIC},
+    {"cxx", "text/x-c++src", true, CACHE_STATIC},
+    {"h", "text/x-chdr", true, CACHE_STATIC},
+    {"htc", "text/x-component", true, CACHE_STATIC},
+    {"c", "text/x-csrc", true, CACHE_STATIC},
+    {"diff", "text/x-diff", true, CACHE_STATIC},
+    {"patch", "text/x-diff", true, CACHE_STATIC},
+    {"d", "text/x-dsrc", true, CACHE_STATIC},
+    {"hs", "text/x-haskell", true, CACHE_STATIC},
+    {"java", "text/x-java", true, CACHE_STATIC},
+    {"ly", "text/x-lilypond", true, CACHE_STATIC},
+    {"lhs", "text/x-literate-haskell", true, CACHE_STATIC},
+    {"moc", "text/x-moc", true, CACHE_STATIC},
+    {"p", "text/x-pascal", true, CACHE_STATIC},
+    {"pas", "text/x-pascal", true, CACHE_STATIC},
+    {"gcd", "text/x-pcs-gcd", true, CACHE_STATIC},
+    {"pl", "text/x-perl", true, CACHE_STATIC},
+    {"pm", "text/x-perl", true, CACHE_STATIC},
+    {"py", "text/x-python", true, CACHE_STATIC},
+    {"scala", "text/x-scala", true, CACHE_STATIC},
+    {"etx", "text/x-setext", true, CACHE_STATIC},
+    {"sfv", "text/x-sfv", true, CACHE_STATIC},
+    {"tk", "text/x-tcl", true, CACHE_STATIC},
+    {"cls", "text/x-tex", true, CACHE_STATIC},
+    {"ltx", "text/x-tex", true, CACHE_STATIC},
+    {"sty", "text/x-tex", true, CACHE_STATIC},
+    {"tex", "text/x-tex", true, CACHE_STATIC},
+    {"vcs", "text/x-vcalendar", true, CACHE_STATIC},
+    {"axv", "video/annodex", false, CACHE_STATIC},
+    {"dif", "video/dv", false, CACHE_STATIC},
+    {"dv", "video/dv", false, CACHE_STATIC},
+    {"fli", "video/fli", false, CACHE_STATIC},
+    {"gl", "video/gl", false, CACHE_STATIC},
+    {"m4s", "video/iso.segment", false, CACHE_STATIC},
+    {"mj2", "video/mj2", false, CACHE_STATIC},
+    {"mjp2", "video/mj2", false, CACHE_STATIC},
+    {"ts", "video/mp2t", false, CACHE_STATIC},
+    {"m4v", "video/mp4", false, CACHE_STATIC},
+    {"mpg4", "video/mp4", false, CACHE_STATIC},
+    {"m1v", "video/mpeg", false, CACHE_STATIC},
+    {"m2v", "video/mpeg", false, CACHE_STATIC},
+    {"mpe", "video/mpeg", false, CACHE_STATIC},
+    {"mpeg", "video/mpeg", false, CACHE_STATIC},
+    {"mpg", "video/mpeg", false, CACHE_STATIC},
+    {"ogv", "video/ogg", false, CACHE_STATIC},
+    {"mov", "video/quicktime", false, CACHE_STATIC},
+    {"qt", "video/quicktime", false, CACHE_STATIC},
+    {"uvh", "video/vnd.dece.hd", false, CACHE_STATIC},
+    {"uvvh", "video/vnd.dece.hd", false, CACHE_STATIC},
+    {"uvm", "video/vnd.dece.mobile", false, CACHE_STATIC},
+    {"uvvm", "video/vnd.dece.mobile", false, CACHE_STATIC},
+    {"uvu", "video/vnd.dece.mp4", false, CACHE_STATIC},
+    {"uvvu", "video/vnd.dece.mp4", false, CACHE_STATIC},
+    {"uvp", "video/vnd.dece.pd", false, CACHE_STATIC},
+    {"uvvp", "video/vnd.dece.pd", false, CACHE_STATIC},
+    {"uvs", "video/vnd.dece.sd", false, CACHE_STATIC},
+    {"uvvs", "video/vnd.dece.sd", false, CACHE_STATIC},
+    {"uvv", "video/vnd.dece.video", false, CACHE_STATIC},
+    {"uvvv", "video/vnd.dece.video", false, CACHE_STATIC},
+    {"dvb", "video/vnd.dvb.file", false, CACHE_STATIC},
+    {"fvt", "video/vnd.fvt", false, CACHE_STATIC},
+    {"m4u", "video/vnd.mpegurl", false, CACHE_STATIC},
+    {"mxu", "video/vnd.mpegurl", false, CACHE_STATIC},
+    {"pyv", "video/vnd.ms-playready.media.pyv", false, CACHE_STATIC},
+    {"nim", "video/vnd.nokia.interleaved-multimedia", false, CACHE_STATIC},
+    {"bik", "video/vnd.radgamettools.bink", false, CACHE_STATIC},
+    {"bk2", "video/vnd.radgamettools.bink", false, CACHE_STATIC},
+    {"smk", "video/vnd.radgamettools.smacker", false, CACHE_STATIC},
+    {"s11", "video/vnd.sealed.mpeg1", false, CACHE_STATIC},
+    {"smpg", "video/vnd.sealed.mpeg1", false, CACHE_STATIC},
+    {"s14", "video/vnd.sealed.mpeg4", false, CACHE_STATIC},
+    {"ssw", "video/vnd.sealed.swf", false, CACHE_STATIC},
+    {"sswf", "video/vnd.sealed.swf", false, CACHE_STATIC},
+    {"s1q", "video/vnd.sealedmedia.softseal.mov", false, CACHE_STATIC},
+    {"smo", "video/vnd.sealedmedia.softseal.mov", false, CACHE_STATIC},
+    {"smov", "video/vnd.sealedmedia.softseal.mov", false, CACHE_STATIC},
+    {"viv", "video/vnd.vivo", false, CACHE_STATIC},
+    {"yt", "video/vnd.youtube.yt", false, CACHE_STATIC},
+    {"flv", "video/x-flv", false, CACHE_STATIC},
+    {"lsf", "video/x-la-asf", false, CACHE_STATIC},
+    {"lsx", "video/x-la-asf", false, CACHE_STATIC},
+    {"mkv", "video/x-matroska", false, CACHE_STATIC},
+    {"mpv", "video/x-matroska", false, CACHE_STATIC},
+    {"mng", "video/x-mng", false, CACHE_STATIC},
+    {"wm", "video/x-ms-wm", false, CACHE_STATIC},
+    {"wmv", "video/x-ms-wmv", false, CACHE_STATIC},
+    {"wmx", "video/x-ms-wmx", false, CACHE_STATIC},
+    {"wvx", "video/x-ms-wvx", false, CACHE_STATIC},
+    {"avi", "video/x-msvideo", false, CACHE_STATIC},
+    {"movie", "video/x-sgi-movie", false, CACHE_STATIC},
+};
+
+constexpr size_t MIME_COUNT = sizeof(MIME_TABLE) / sizeof(MIME_TABLE[0]);
+constexpr auto MIME_HASH = make_perfect_hash(MIME_TABLE);
+
+static_assert(MIME_COUNT >= 300, "MIME table lost entries");
+static_assert(MIME_HASH.ok, "duplicate extension in MIME_TABLE");
+static_assert(ph_verify(MIME_TABLE, MIME_HASH), "MIME perfect hash is not collision-free");
+
+/**
+ * @brief Finds the MIME entry for a path's extension.
+ *
+ * @param path File path or URI ("./www/index.html").
+ * @return Matching entry, or nullptr if the extension is unknown or missing
+ */
+constexpr const MimeEntry* mime_lookup(std::string_view path) {
+    size_t dot = path.rfind('.');
+    size_t slash = path.rfind('/');
+    if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash)) return nullptr;
+
+    std::string_view ext = path.substr(dot + 1);
+    int i = MIME_HASH.find(ext);
+    if (i < 0 || !ph_iequals(MIME_TABLE[i].key, ext)) return nullptr;
+    return &MIME_TABLE[i];
+}
+
+static_assert(std::string_view(mime_lookup("./www/index.html")->type) == "text/html");
+static_assert(std::string_view(mime_lookup("./www/PHOTO.JPG")->type) == "image/jpeg");
+static_assert(std::string_view(mime_lookup("/fonts/a.woff2")->type) == "font/woff2");
+static_assert(mime_lookup("./www/index.html")->cache == CACHE_REVALIDATE);
+static_assert(mime_lookup("./www/no_extension") == nullptr);
+static_assert(mime_lookup("./www.d/README") == nullptr);
+static_assert(mime_lookup("./www/file.notarealext") == nullptr);
+
+// URIs answered by the server itself instead of a file under ./www
+enum RouteId {
+    ROUTE_HEALTHZ,      // liveness: always 200
+    ROUTE_READYZ,       // readiness: 503 while draining for shutdown/upgrade
+    ROUTE_STATS,        // internal counters as JSON
+};
+
+/**
+  * @struct RouteEntry
+  * @brief One reserved URI
+  * @var key Exact request target
+  * @var id  Which built-in handler serves it
+*/
+struct RouteEntry {
+    std::string_view key;
+    RouteId id;
+};
+
+constexpr RouteEntry ROUTE_TABLE[] = {
+    {"/healthz", ROUTE_HEALTHZ},
+    {"/readyz",  ROUTE_READYZ},
+    {"/__stats", ROUTE_STATS},
+};
+
+constexpr auto ROUTE_HASH = make_perfect_hash(ROUTE_TABLE);
+static_assert(ph_verify(ROUTE_TABLE, ROUTE_HASH), "route perfect hash is not collision-free");
+
+/**
+ * @brief Checks whether a request target is a reserved route.
+ *
+ * @param uri Request target from the request line.
+ * @return Matching route, or nullptr for ordinary file requests
+ */
+constexpr const RouteEntry* route_lookup(std::string_view uri) {
+    int i = ROUTE_HASH.find(uri);
+    if (i < 0 || ROUTE_TABLE[i].key != uri) return nullptr;
+    return &ROUTE_TABLE[i];
+}
+
+static_assert(route_lookup("/healthz")->id == ROUTE_HEALTHZ);
+static_assert(route_lookup("/HEALTHZ") == nullptr);
+static_assert(route_lookup("/index.html") == nullptr);
@@ -0,0 +1,31 @@
+/**
+ * @file pack_www.cpp
+ * @brief Packs a docroot into a bundle for the servers' --bundle option
+ *
+ *   ./pack_www www www.bundle
+ *   ./server_pool --bundle www.bundle
+ *
+ * Run it again after every deploy; the new bundle replaces the old one
+ * atomically, and a server picks it up on its next start (or handover).
+ */
+
+#include "bundle.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s DOCROOT BUNDLE\n", argv[0]);
+        return 1;
+    }
+
+    int files = bundle_pack(argv[1], argv[2]);
+    if (files < 0) {
+        fprintf(stderr, "packing %s into %s failed: %s\n", argv[1], argv[2], strerror(errno));
+        return 1;
+    }
+    printf("packed %d files from %s into %s\n", files, argv[1], argv[2]);
+    return 0;
+}
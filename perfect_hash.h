@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Compile-time perfect hashing for small static string tables.
+ *
+ * Keys are spread over buckets by one 64-bit hash; each bucket then gets a
+ * displacement, found at compile time, that sends all of its keys to distinct
+ * free slots (the "hash and displace" scheme). A lookup is one pass over the
+ * key to hash it, two array reads and a single compare against the one
+ * candidate entry, however large the table is.
+ *
+ * Tables are arrays of structs whose first member is `std::string_view key`.
+ */
+
+// case-insensitive (ASCII) FNV-1a with a murmur3 finalizer, so that every
+// bit range used for buckets and slots is well mixed even for short keys
+constexpr uint64_t ph_hash(std::string_view s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (char c : s) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        h ^= (unsigned char)c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+constexpr bool ph_iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x = (char)(x - 'A' + 'a');
+        if (y >= 'A' && y <= 'Z') y = (char)(y - 'A' + 'a');
+        if (x != y) return false;
+    }
+    return true;
+}
+
+constexpr size_t ph_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+template <size_t N>
+struct PerfectHash {
+    // ~2 keys per bucket, slots kept at most half full
+    static constexpr size_t BUCKETS = N / 2 + 1;
+    static constexpr size_t SLOTS = ph_pow2(N * 2);
+    // give up on a bucket after this many displacements (never hit in practice)
+    static constexpr uint32_t MAX_TRIES = 1u << 16;
+
+    std::array<uint32_t, BUCKETS> disp{};
+    std::array<int32_t, SLOTS> slot_key{};
+    bool ok = false;
+
+    static constexpr size_t bucket_of(uint64_t h) {
+        return (uint32_t)h % BUCKETS;
+    }
+
+    // displacement d encodes the pair (d0, d1): slot = f1 + d0 * f2 + d1
+    static constexpr size_t slot_of(uint64_t h, uint32_t d) {
+        uint64_t f1 = h >> 32;
+        uint64_t f2 = ((h >> 16) & 0xffff) | 1;
+        uint64_t d0 = d / SLOTS, d1 = d % SLOTS;
+        return (size_t)((f1 + d0 * f2 + d1) & (SLOTS - 1));
+    }
+
+    /** @brief Index of the only entry key could be, or -1; the caller compares keys. */
+    constexpr int find(std::string_view key) const {
+        uint64_t h = ph_hash(key);
+        return slot_key[slot_of(h, disp[bucket_of(h)])];
+    }
+};
+
+/**
+ * @brief Builds the perfect hash for a table at compile time.
+ * ok stays false if two keys collide on the full 64-bit hash (duplicates)
+ * or a bucket cannot be placed, so callers can static_assert on it.
+ */
+template <typename T, size_t N>
+constexpr PerfectHash<N> make_perfect_hash(const T (&table)[N]) {
+    using PH = PerfectHash<N>;
+    PH ph{};
+    ph.slot_key.fill(-1);
+
+    std::array<uint64_t, N> hashes{};
+    std::array<size_t, PH::BUCKETS> bucket_size{};
+    for (size_t i = 0; i < N; i++) {
+        hashes[i] = ph_hash(table[i].key);
+        for (size_t j = 0; j < i; j++) {
+            if (hashes[j] == hashes[i]) return ph;
+        }
+        bucket_size[PH::bucket_of(hashes[i])]++;
+    }
+
+    size_t largest = 0;
+    for (size_t b = 0; b < PH::BUCKETS; b++) {
+        if (bucket_size[b] > largest) largest = bucket_size[b];
+    }
+
+    // place the most crowded buckets first, while the slots are still empty
+    std::array<size_t, N> members{};
+    std::array<size_t, N> slots{};
+    for (size_t size = largest; size > 0; size--) {
+        for (size_t b = 0; b < PH::BUCKETS; b++) {
+            if (bucket_size[b] != size) continue;
+
+            size_t count = 0;
+            for (size_t i = 0; i < N; i++) {
+                if (PH::bucket_of(hashes[i]) == b) members[count++] = i;
+            }
+
+            bool placed = false;
+            for (uint32_t d = 0; d < PH::MAX_TRIES && !placed; d++) {
+                placed = true;
+                for (size_t j = 0; j < count && placed; j++) {
+                    slots[j] = PH::slot_of(hashes[members[j]], d);
+                    if (ph.slot_key[slots[j]] != -1) placed = false;
+                    for (size_t k = 0; k < j && placed; k++) {
+                        if (slots[k] == slots[j]) placed = false;
+                    }
+                }
+                if (placed) {
+                    ph.disp[b] = d;
+                    for (size_t j = 0; j < count; j++) ph.slot_key[slots[j]] = (int32_t)members[j];
+                }
+            }
+            if (!placed) return ph;
+        }
+    }
+
+    ph.ok = true;
+    return ph;
+}
+
+/** @brief True if every key of the table maps back to its own index. */
+template <typename T, size_t N>
+constexpr bool ph_verify(const T (&table)[N], const PerfectHash<N> &ph) {
+    if (!ph.ok) return false;
+    for (size_t i = 0; i < N; i++) {
+        if (ph.find(table[i].key) != (int)i) return false;
+    }
+    return true;
+}
@@ -0,0 +1,180 @@
+#include "prefork.h"
+#include "lifecycle.h"
+#include "ratelimit.h"
+#include "trace.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <new>
+
+namespace {
+
+PreforkSlot* slots = NULL;
+int num_slots = 0;
+
+long long now_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// runs in a freshly forked worker before it returns to the server's main()
+void become_worker(int index, pid_t supervisor) {
+    // a worker must not outlive its supervisor and keep the port busy
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != supervisor) _exit(0);
+    // Ctrl-C reaches only the supervisor, which passes one SIGTERM on;
+    // a second signal would make the worker skip its drain
+    setpgid(0, 0);
+
+    lifecycle_forked();
+    trace_forked();
+    http_set_counters(&slots[index].counters);
+    http_register_stats("workers", prefork_write_stats, NULL);
+}
+
+// forks the worker for a slot; returns 0 in the child, the pid (or -1) in the parent
+pid_t spawn(int index) {
+    pid_t supervisor = getpid();
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        become_worker(index, supervisor);
+        return 0;
+    }
+    slots[index].pid = pid;
+    printf("[+] Worker %d started (pid %d)\n", index, pid);
+    return pid;
+}
+
+// slot of a worker pid, -1 if it is not one of ours
+int slot_of(pid_t pid) {
+    for (int i = 0; i < num_slots; i++) {
+        if (slots[i].pid == pid) return i;
+    }
+    return -1;
+}
+
+void write_counters(std::ostream &out, uint64_t requests, uint64_t s2, uint64_t s4, uint64_t s5, uint64_t bytes) {
+    out << "\"requests\": " << requests << ", \"status_2xx\": " << s2 << ", \"status_4xx\": " << s4
+        << ", \"status_5xx\": " << s5 << ", \"bytes_sent\": " << bytes;
+}
+
+} // namespace
+
+int prefork_workers(int argc, char** argv){
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--prefork") != 0) continue;
+    int n = atoi(argv[i + 1]);
+    if (n > PREFORK_MAX_WORKERS){
+      fprintf(stderr, "[!] --prefork %d is too many, using %d\n", n, PREFORK_MAX_WORKERS);
+      n = PREFORK_MAX_WORKERS;
+    }
+    return n > 0 ? n : 0;
+  }
+  return 0;
+}
+
+int prefork_run(int workers, const int* listen_fds, int n){
+  // one shared, zero-filled segment, mapped at the same address in every worker:
+  // the slots, then the rate limit table (slots keep it 64-byte aligned)
+  size_t slots_size = sizeof(PreforkSlot) * workers;
+  size_t mem_size = slots_size + ratelimit_shared_size();
+  void* mem = mmap(NULL, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED){
+    perror("Failed to map worker statistics");
+    return -1;
+  }
+  slots = (PreforkSlot*)mem;
+  num_slots = workers;
+  for (int i = 0; i < workers; i++) new (&slots[i]) PreforkSlot();
+  if (mem_size > slots_size) ratelimit_share((char*)mem + slots_size);
+
+  // every worker is woken for each connection; the losers must not block in accept()
+  for (int i = 0; i < n; i++){
+    fcntl(listen_fds[i], F_SETFL, fcntl(listen_fds[i], F_GETFL) | O_NONBLOCK);
+  }
+
+  long long restart_at[PREFORK_MAX_WORKERS];
+  long long started_at[PREFORK_MAX_WORKERS];
+  for (int i = 0; i < workers; i++){
+    if (spawn(i) == 0) return i;
+    started_at[i] = now_ms();
+    restart_at[i] = 0;
+  }
+  lifecycle_ready();
+  printf("Supervising %d worker processes\n", workers);
+
+  while (lifecycle_running(listen_fds, n)){
+    pollfd p = { lifecycle_wakeup_fd(), POLLIN, 0 };
+    poll(&p, 1, PREFORK_POLL_MS);
+
+    int status;
+    pid_t pid;
+    long long now = now_ms();
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0){
+      int i = slot_of(pid);
+      if (i < 0) continue;
+      if (WIFSIGNALED(status)) fprintf(stderr, "[!] Worker %d (pid %d) killed by signal %d\n", i, pid, WTERMSIG(status));
+      else fprintf(stderr, "[!] Worker %d (pid %d) exited with status %d\n", i, pid, WEXITSTATUS(status));
+      slots[i].pid = 0;
+      // back off when a worker crashes right after starting, instead of fork-looping
+      restart_at[i] = now - started_at[i] < PREFORK_MIN_UPTIME_MS ? now + PREFORK_MIN_UPTIME_MS : now;
+    }
+
+    for (int i = 0; i < workers; i++){
+      if (slots[i].pid != 0 || now < restart_at[i]) continue;
+      slots[i].restarts++;
+      pid_t child = spawn(i);
+      if (child == 0) return i;
+      if (child < 0) restart_at[i] = now + PREFORK_MIN_UPTIME_MS;
+      started_at[i] = now;
+    }
+  }
+
+  // drain: every worker finishes what it accepted, then exits
+  for (int i = 0; i < workers; i++){
+    if (slots[i].pid > 0) kill(slots[i].pid, SIGTERM);
+  }
+  // only our workers: a binary started by an upgrade is our child as well
+  for (int i = 0; i < workers; i++){
+    if (slots[i].pid > 0) waitpid(slots[i].pid, NULL, 0);
+  }
+
+  std::ostringstream totals;
+  prefork_write_stats(totals, NULL);
+  printf("Workers served: %s\n", totals.str().c_str());
+  if (mem_size > slots_size) ratelimit_share(NULL);
+  munmap(mem, mem_size);
+  slots = NULL;
+  return -1;
+}
+
+void prefork_write_stats(std::ostream &out, void*){
+  uint64_t requests = 0, s2 = 0, s4 = 0, s5 = 0, bytes = 0;
+  out << "{\"slots\": [";
+  for (int i = 0; i < num_slots; i++){
+    const HttpCounters &c = slots[i].counters;
+    uint64_t r = c.requests.load(), a = c.status_2xx.load(), b = c.status_4xx.load();
+    uint64_t d = c.status_5xx.load(), n = c.bytes_sent.load();
+    out << (i ? ", " : "") << "{\"pid\": " << slots[i].pid.load() << ", \"restarts\": " << slots[i].restarts.load() << ", ";
+    write_counters(out, r, a, b, d, n);
+    out << "}";
+    requests += r; s2 += a; s4 += b; s5 += d; bytes += n;
+  }
+  out << "], \"total\": {";
+  write_counters(out, requests, s2, s4, s5, bytes);
+  out << "}}";
+}
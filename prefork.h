@@ -0,0 +1,67 @@
+#pragma once
+
+#include "http_parser.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// most worker processes --prefork accepts
+const int PREFORK_MAX_WORKERS = 64;
+// a worker that dies sooner than this after starting is restarted only after this delay
+const int PREFORK_MIN_UPTIME_MS = 1000;
+// how often the supervisor checks on its workers when no signal arrives
+const int PREFORK_POLL_MS = 100;
+
+/**
+  * @struct PreforkSlot
+  * @brief One worker's corner of the shared-memory segment
+  * Alone on its cache line, so workers counting requests never write to a
+  * line another process is writing to.
+  * @var pid      Worker currently running in the slot, 0 while it is being restarted
+  * @var restarts Times the slot's worker was replaced after dying
+  * @var counters Responses served by the slot's workers (survive restarts)
+*/
+typedef struct alignas(64){
+    std::atomic<int> pid;
+    std::atomic<uint32_t> restarts;
+    HttpCounters counters;
+  } PreforkSlot;
+
+/**
+ * @brief Reads the worker count from "--prefork N" on the command line.
+ *
+ * @param argc main()'s argc.
+ * @param argv main()'s argv.
+ * @return N, or 0 to keep serving from this one process
+ */
+int prefork_workers(int argc, char** argv);
+
+/**
+ * @brief Forks worker processes that all accept on the same listening sockets.
+ * Call after the listeners exist and before any server state (fd cache,
+ * docroot watcher, thread pool) is created, so each worker builds its own.
+ *
+ * In each worker this returns the worker's slot index and the caller goes
+ * on to run its usual accept loop. The parent becomes the supervisor: it
+ * restarts workers that die, and on SIGTERM (or after handing the sockets
+ * to a new binary on SIGUSR2) it asks every worker to drain, waits for
+ * them and returns -1, after which the caller just exits.
+ *
+ * Each worker counts its responses in a cache-line-padded slot of a
+ * shared anonymous mapping; /__stats in any worker reports every slot.
+ *
+ * @param workers    Number of worker processes.
+ * @param listen_fds Listening sockets (made non-blocking, as workers race to accept).
+ * @param n          Number of sockets.
+ * @return Slot index in a worker, -1 in the supervisor once it is done
+ */
+int prefork_run(int workers, const int* listen_fds, int n);
+
+/**
+ * @brief Writes per-worker and total counters as JSON (the "workers" /__stats section).
+ *
+ * @param out Stream receiving a JSON object.
+ * @param ctx Unused.
+ */
+void prefork_write_stats(std::ostream &out, void* ctx);
@@ -0,0 +1,427 @@
+#include "proxy.h"
+#include "body_io.h"
+#include "http_parser.h"
+#include "socket.h"
+#include "trace.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+// one prefix and its upstream's pool of idle keep-alive connections
+struct Route {
+    std::string prefix;
+    sockaddr_storage addr;
+    socklen_t addr_len;
+    size_t pool_size;
+    pthread_mutex_t lock;
+    std::vector<int> idle;
+};
+
+Route routes[PROXY_MAX_ROUTES];
+int route_count = 0;
+
+std::atomic<uint64_t> forwarded(0);
+std::atomic<uint64_t> connects(0);
+std::atomic<uint64_t> reused(0);
+std::atomic<uint64_t> retried(0);
+std::atomic<uint64_t> failed(0);
+std::atomic<uint64_t> body_bytes(0);
+
+// headers that describe one connection (RFC 9110 7.6.1), never forwarded;
+// Expect is answered here rather than by the upstream
+const char* HOP_BY_HOP[] = {
+    "connection", "keep-alive", "proxy-connection", "te", "trailer", "transfer-encoding", "upgrade", "expect",
+};
+
+bool send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool send_all(int fd, const std::string &data) {
+    return send_all(fd, data.data(), data.size());
+}
+
+// longest matching prefix wins, so /api/v2/ can go elsewhere than /api/
+Route* match(const std::string &uri) {
+    Route* best = NULL;
+    for (int i = 0; i < route_count; i++) {
+        Route &r = routes[i];
+        if (uri.compare(0, r.prefix.size(), r.prefix) == 0 && (!best || r.prefix.size() > best->prefix.size())) {
+            best = &r;
+        }
+    }
+    return best;
+}
+
+int connect_upstream(Route* r) {
+    int fd = socket(r->addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    timeval timeout = { PROXY_IO_TIMEOUT_S, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (r->addr.ss_family != AF_UNIX) {
+        // request heads are small writes followed by a wait for the answer
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    if (connect(fd, (sockaddr*)&r->addr, r->addr_len) < 0) {
+        close(fd);
+        return -1;
+    }
+    connects++;
+    return fd;
+}
+
+// an idle connection if one is still open, a new one otherwise
+int take_upstream(Route* r, bool* was_idle) {
+    pthread_mutex_lock(&r->lock);
+    while (!r->idle.empty()) {
+        int fd = r->idle.back();
+        r->idle.pop_back();
+        // anything readable on an idle connection is the upstream closing it
+        char c;
+        ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pthread_mutex_unlock(&r->lock);
+            *was_idle = true;
+            reused++;
+            return fd;
+        }
+        close(fd);
+    }
+    pthread_mutex_unlock(&r->lock);
+    *was_idle = false;
+    return connect_upstream(r);
+}
+
+void give_back(Route* r, int fd) {
+    pthread_mutex_lock(&r->lock);
+    if (r->idle.size() < r->pool_size) {
+        r->idle.push_back(fd);
+        fd = -1;
+    }
+    pthread_mutex_unlock(&r->lock);
+    if (fd >= 0) close(fd);
+}
+
+bool hop_by_hop(const std::string &name, const std::string &connection) {
+    std::string lower = name;
+    for (char &c : lower) c = tolower((unsigned char)c);
+    for (const char* h : HOP_BY_HOP) {
+        if (lower == h) return true;
+    }
+    // so are the headers the sender listed in Connection
+    return has_token(connection, lower.c_str());
+}
+
+/**
+ * Copies the header lines of a block (status or request line excluded,
+ * blank line excluded) minus the hop-by-hop ones, and of those only the
+ * lines keep(name) returns true for.
+ */
+template <typename F>
+void copy_headers(const char* block, size_t len, std::string &out, F keep) {
+    std::string connection = header_value(block, len, "Connection");
+    const char* end = block + len;
+    const char* line = (const char*)memmem(block, len, "\r\n", 2);
+    while (line && line + 2 < end) {
+        line += 2;
+        const char* eol = (const char*)memmem(line, end - line, "\r\n", 2);
+        if (!eol || eol == line) break;
+        const char* colon = (const char*)memchr(line, ':', eol - line);
+        if (colon) {
+            std::string name(line, colon - line);
+            if (!hop_by_hop(name, connection) && keep(name)) out.append(line, eol - line + 2);
+        }
+        line = eol;
+    }
+}
+
+/**
+ * Relays a chunked body (RFC 9112 7.1). Chunk data is spliced; the size
+ * lines and trailers are forwarded for an HTTP/1.1 client and dropped for
+ * an HTTP/1.0 one, which gets the plain body delimited by the close.
+ */
+bool relay_chunks(BodyReader* r, int to_fd, bool forward_framing, const int pipe_fds[2], off_t* relayed) {
+    std::string line;
+    for (;;) {
+        unsigned long long size;
+        if (!body_read_line(r, line, PROXY_HEAD_MAX) || !body_chunk_size(line, &size)) return false;
+        if (forward_framing && !send_all(to_fd, line + "\r\n")) return false;
+        if (size == 0) break;
+        if (!body_splice(r, to_fd, NULL, (off_t)size, pipe_fds, PROXY_PIPE_SIZE, relayed)) return false;
+        if (!body_read_line(r, line, PROXY_HEAD_MAX) || !line.empty()) return false;
+        if (forward_framing && !send_all(to_fd, "\r\n", 2)) return false;
+    }
+    do {
+        if (!body_read_line(r, line, PROXY_HEAD_MAX)) return false;
+        if (forward_framing && !send_all(to_fd, line + "\r\n")) return false;
+    } while (!line.empty());
+    return true;
+}
+
+// methods a proxy may send twice (RFC 9110 9.2.2); POST and PATCH never are
+bool idempotent(const std::string &method) {
+    return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "TRACE" ||
+           method == "PUT" || method == "DELETE";
+}
+
+// answers the client directly when the upstream cannot
+void fail(int client_fd, ProxyResult* result, int status, const char* reason) {
+    std::string body = std::to_string(status) + " " + reason + "\n";
+    std::string resp = serialize_headers(status, reason, "text/plain", body.size(), "no-store") + body;
+    if (send_all(client_fd, resp)) result->bytes_sent = resp.size();
+    result->status = status;
+    failed++;
+}
+
+// fail() for a request whose body was not read: drained first, so the client is not reset
+void refuse(int client_fd, ProxyResult* result, int status, const char* reason) {
+    fail(client_fd, result, status, reason);
+    body_linger(client_fd, PROXY_LINGER_MS);
+}
+
+std::string client_address(int client_fd) {
+    sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    char text[INET6_ADDRSTRLEN] = "";
+    if (getpeername(client_fd, (sockaddr*)&addr, &len) < 0) return "";
+    if (addr.ss_family == AF_INET) inet_ntop(AF_INET, &((sockaddr_in*)&addr)->sin_addr, text, sizeof(text));
+    else if (addr.ss_family == AF_INET6) inet_ntop(AF_INET6, &((sockaddr_in6*)&addr)->sin6_addr, text, sizeof(text));
+    return text;
+}
+
+// the request head as the upstream sees it: HTTP/1.1, keep-alive, X-Forwarded-*
+std::string upstream_head(const char* req, size_t head_len, int client_fd, off_t length) {
+    std::string method, uri, version;
+    parse_request_line(req, head_len, method, uri, version);
+    std::string head = method + " " + uri + " HTTP/1.1\r\n";
+    bool has_host = false;
+    std::string forwarded_for;
+    copy_headers(req, head_len, head, [&](const std::string &name) {
+        if (strcasecmp(name.c_str(), "Host") == 0) has_host = true;
+        if (strcasecmp(name.c_str(), "Content-Length") == 0) return false;
+        if (strcasecmp(name.c_str(), "X-Forwarded-For") == 0) {
+            forwarded_for = header_value(req, head_len, "X-Forwarded-For") + ", ";
+            return false;
+        }
+        return true;
+    });
+    if (!has_host) head += "Host: localhost\r\n";
+    std::string client = client_address(client_fd);
+    if (!client.empty()) head += "X-Forwarded-For: " + forwarded_for + client + "\r\n";
+    head += "X-Forwarded-Proto: http\r\n";
+    if (length > 0 || method == "POST" || method == "PUT") head += "Content-Length: " + std::to_string(length) + "\r\n";
+    head += "Connection: keep-alive\r\n\r\n";
+    return head;
+}
+
+/**
+ * Reads the upstream's response header block, skipping interim 1xx
+ * responses. Body bytes that came along stay in buf after head_len.
+ * Returns the status, 0 if the connection closed before any byte, -1 on
+ * a timeout and -2 on anything else.
+ */
+int read_response_head(int fd, std::string &buf, size_t* head_len) {
+    buf.clear();
+    for (;;) {
+        ssize_t end = body_read_head(fd, buf, PROXY_HEAD_MAX);
+        if (end == 0) return buf.empty() ? 0 : -2;
+        if (end < 0) return errno == EAGAIN || errno == EWOULDBLOCK ? -1 : -2;
+        int status = 0;
+        if (buf.compare(0, 5, "HTTP/") != 0 || sscanf(buf.c_str(), "HTTP/%*d.%*d %d", &status) != 1) return -2;
+        if (status >= 200 || status == 101) {
+            *head_len = end;
+            return status;
+        }
+        buf.erase(0, end);
+    }
+}
+
+} // namespace
+
+int proxy_init(int argc, char** argv){
+  int pool_size = PROXY_DEFAULT_POOL;
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--proxy-pool") == 0) pool_size = atoi(argv[++i]);
+  }
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--proxy") != 0) continue;
+    std::string route = argv[++i];
+    size_t eq = route.find('=');
+    if (eq == std::string::npos || eq == 0 || route[0] != '/' ||
+        proxy_add_route(route.substr(0, eq).c_str(), route.c_str() + eq + 1, pool_size) < 0){
+      fprintf(stderr, "bad --proxy route (want /prefix=SPEC): %s\n", route.c_str());
+      return -1;
+    }
+    printf("Proxying %s to %s\n", route.substr(0, eq).c_str(), route.c_str() + eq + 1);
+  }
+  if (route_count > 0) http_register_stats("proxy", proxy_write_stats, NULL);
+  return 0;
+}
+
+int proxy_add_route(const char* prefix, const char* spec, int pool_size){
+  if (route_count >= PROXY_MAX_ROUTES) return -1;
+  Route &r = routes[route_count];
+  if (resolve_socket_spec(spec, &r.addr, &r.addr_len) < 0) return -1;
+  r.prefix = prefix;
+  r.pool_size = std::max(pool_size, 0);
+  pthread_mutex_init(&r.lock, NULL);
+  route_count++;
+  return 0;
+}
+
+bool proxy_request(const char* req, size_t len){
+  if (route_count == 0) return false;
+  std::string method, uri, version;
+  parse_request_line(req, len, method, uri, version);
+  return !uri.empty() && match(uri) != NULL;
+}
+
+void proxy_forward(int client_fd, const char* received, size_t received_len, ProxyResult* result){
+  result->status = 0;
+  result->bytes_sent = 0;
+  timeval idle = { PROXY_IO_TIMEOUT_S, 0 };
+  setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+  std::string method, uri, version;
+  parse_request_line(received, received_len, method, uri, version);
+  std::cout << "[REQ] " << method << " " << uri << std::endl;
+  Route* route = match(uri);
+
+  // the first read may have ended inside the headers
+  std::string buf(received, received_len);
+  ssize_t read_head = body_read_head(client_fd, buf, PROXY_HEAD_MAX);
+  if (read_head < 0 && errno == EMSGSIZE) return refuse(client_fd, result, 431, "Request Header Fields Too Large");
+  if (read_head <= 0) return fail(client_fd, result, 400, "Bad Request");
+  const char* req = buf.data();
+  size_t len = buf.size();
+  size_t head_len = read_head;
+  const char* body = req + head_len;
+
+  // request bodies are spliced by length; chunked ones would need re-framing
+  if (!header_value(req, head_len, "Transfer-Encoding").empty()) return refuse(client_fd, result, 411, "Length Required");
+  off_t length = 0;
+  std::string length_header = header_value(req, head_len, "Content-Length");
+  if (!length_header.empty()){
+    char* end;
+    length = strtoll(length_header.c_str(), &end, 10);
+    if (*end || length < 0) return refuse(client_fd, result, 400, "Bad Request");
+  }
+  size_t buffered = std::min((off_t)(len - head_len), length);
+  // the whole request is in hand unless the body continues on the socket, and
+  // an upstream that closed without answering may still have acted on it
+  bool replayable = (off_t)buffered == length && idempotent(method);
+
+  int pipe_fds[2];
+  if (body_open_pipe(pipe_fds, PROXY_PIPE_SIZE) < 0) return fail(client_fd, result, 500, "Internal Server Error");
+  forwarded++;
+
+  std::string up_head = upstream_head(req, head_len, client_fd, length);
+  std::string resp;
+  size_t resp_head_len = 0;
+  int status = 0;
+  int upstream = -1;
+  off_t relayed = 0;
+  uint64_t t = trace_clock();
+  // a pooled connection the upstream closed meanwhile fails on first use; retry
+  // an idempotent request once on a new one (RFC 9112 9.3.1.1)
+  for (int attempt = 0; attempt < 2; attempt++){
+    bool was_idle;
+    upstream = take_upstream(route, &was_idle);
+    if (upstream < 0) break;
+    if (attempt == 0 && has_token(header_value(req, head_len, "Expect"), "100-continue") && (off_t)buffered < length){
+      const char* go_on = "HTTP/1.1 100 Continue\r\n\r\n";
+      send_all(client_fd, go_on, strlen(go_on));
+    }
+    // a retry only happens when the whole body was buffered, so it is sent again from there
+    BodyReader reader = { client_fd, body, buffered };
+    bool sent = send_all(upstream, up_head) && body_splice(&reader, upstream, NULL, length, pipe_fds, PROXY_PIPE_SIZE, &relayed);
+    status = sent ? read_response_head(upstream, resp, &resp_head_len) : 0;
+    if (status != 0 || !was_idle || !replayable) break;
+    retried++;
+    close(upstream);
+    upstream = -1;
+  }
+  trace_span(client_fd, TRACE_UPSTREAM, t, status);
+
+  // an upstream that failed part way through the request body leaves the rest unread
+  auto give_up = relayed < length ? refuse : fail;
+  if (upstream < 0 || status == 0 || status == -2){
+    if (upstream >= 0) close(upstream);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return give_up(client_fd, result, 502, "Bad Gateway");
+  }
+  if (status == -1){
+    close(upstream);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return give_up(client_fd, result, 504, "Gateway Timeout");
+  }
+
+  // response framing (RFC 9112 6.3)
+  const char* h = resp.data();
+  bool chunked = has_token(header_value(h, resp_head_len, "Transfer-Encoding"), "chunked");
+  std::string resp_length = header_value(h, resp_head_len, "Content-Length");
+  bool no_body = method == "HEAD" || status == 204 || status == 304;
+  off_t resp_body = no_body ? 0 : chunked ? -1 : resp_length.empty() ? -1 : atoll(resp_length.c_str());
+  bool keep_alive = resp.compare(0, 8, "HTTP/1.1") == 0 && !has_token(header_value(h, resp_head_len, "Connection"), "close");
+  // an HTTP/1.0 client cannot take chunks: it gets the plain body, ended by the close
+  bool client_chunks = chunked && !no_body && version == "HTTP/1.1";
+
+  std::string out(resp, 0, resp.find("\r\n") + 2);
+  copy_headers(h, resp_head_len, out, [](const std::string &) { return true; });
+  if (client_chunks) out += "Transfer-Encoding: chunked\r\n";
+  out += "Connection: close\r\n\r\n";
+  result->status = status;
+  t = trace_clock();
+  bool ok = send_all(client_fd, out);
+  if (ok) result->bytes_sent = out.size();
+
+  BodyReader reader = { upstream, resp.data() + resp_head_len, resp.size() - resp_head_len };
+  off_t body_sent = 0;
+  if (ok && !no_body){
+    if (chunked) ok = relay_chunks(&reader, client_fd, client_chunks, pipe_fds, &body_sent);
+    else ok = body_splice(&reader, client_fd, NULL, resp_body, pipe_fds, PROXY_PIPE_SIZE, &body_sent);
+  }
+  result->bytes_sent += body_sent;
+  body_bytes += relayed + body_sent;
+  trace_span(client_fd, TRACE_SEND, t, result->bytes_sent);
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+
+  // only a response read to its exact end leaves the connection reusable
+  if (ok && keep_alive && (resp_body >= 0 || chunked) && reader.left == 0) give_back(route, upstream);
+  else close(upstream);
+}
+
+void proxy_write_stats(std::ostream &out, void*){
+  out << "{\"forwarded\": " << forwarded.load() << ", \"connects\": " << connects.load()
+      << ", \"reused\": " << reused.load() << ", \"retried\": " << retried.load()
+      << ", \"failed\": " << failed.load() << ", \"body_bytes\": " << body_bytes.load() << ", \"idle\": {";
+  for (int i = 0; i < route_count; i++){
+    pthread_mutex_lock(&routes[i].lock);
+    out << (i ? ", " : "") << "\"" << routes[i].prefix << "\": " << routes[i].idle.size();
+    pthread_mutex_unlock(&routes[i].lock);
+  }
+  out << "}}";
+}
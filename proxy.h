@@ -0,0 +1,97 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * Reverse proxy to local application backends.
+ *
+ * Requests whose URI starts with a configured prefix are forwarded to that
+ * prefix's upstream (TCP or Unix domain socket, same spec syntax as
+ * --listen) instead of being looked up in ./www. Upstream connections are
+ * HTTP/1.1 keep-alive and pooled per upstream, so most requests skip the
+ * connect. Request and response bodies are relayed with splice() through a
+ * pipe, socket to socket: only headers and chunk-size lines are read into
+ * user space.
+ *
+ * The client side stays as it is for static files: one request per
+ * connection, closed after the response. Plain HTTP/1 on the blocking
+ * servers only; chunked request bodies are refused with 411.
+ */
+
+// most upstreams a server can be configured with
+const int PROXY_MAX_ROUTES = 16;
+// idle keep-alive connections kept per upstream unless --proxy-pool says otherwise
+const int PROXY_DEFAULT_POOL = 8;
+// an upstream (or client) sending nothing for this long fails the request
+const int PROXY_IO_TIMEOUT_S = 30;
+// largest header block accepted, from the client or from an upstream
+const size_t PROXY_HEAD_MAX = 16 * 1024;
+// how long a refused request's remaining body is read and dropped before the close
+const int PROXY_LINGER_MS = 2000;
+// capacity requested for the splice pipe (capped by /proc/sys/fs/pipe-max-size)
+const int PROXY_PIPE_SIZE = 1 << 20;
+
+/**
+ * @struct ProxyResult
+ * @brief Outcome of one forwarded request, for the server's counters
+ * @var status     Status relayed to the client (502/504 if the upstream failed), 0 if nothing was sent
+ * @var bytes_sent Bytes written to the client, headers included
+*/
+typedef struct{
+    int status;
+    off_t bytes_sent;
+  } ProxyResult;
+
+/**
+ * @brief Adds proxy routes if the command line asks for them.
+ * Understands "--proxy PREFIX=SPEC" (repeatable, e.g. /api/=127.0.0.1:9000
+ * or /app/=unix:/run/app.sock) and "--proxy-pool N" idle connections per
+ * upstream.
+ *
+ * @param argc main()'s argc.
+ * @param argv main()'s argv.
+ * @return 0 if successful (or no proxy requested), -1 if a route is malformed
+ */
+int proxy_init(int argc, char** argv);
+
+/**
+ * @brief Adds one route directly (tests, embedding). Call before serving.
+ *
+ * @param prefix    URI prefix to forward, e.g. "/api/".
+ * @param spec      Upstream address in resolve_socket_spec() syntax.
+ * @param pool_size Idle connections kept for reuse.
+ * @return 0 if successful, -1 if the spec is malformed or too many routes exist
+ */
+int proxy_add_route(const char* prefix, const char* spec, int pool_size);
+
+/**
+ * @brief Whether a request goes to an upstream.
+ *
+ * @param req Raw request bytes.
+ * @param len Number of bytes in req.
+ * @return True if proxy_forward() should take the request
+ */
+bool proxy_request(const char* req, size_t len);
+
+/**
+ * @brief Forwards a request and relays the upstream's response to the client.
+ * The socket must be positioned right after the len bytes already received;
+ * headers that did not fit in them are read first (431 past PROXY_HEAD_MAX),
+ * and the rest of the request body is spliced from it.
+ *
+ * @param client_fd The connected client (blocking); its address goes into X-Forwarded-For.
+ * @param req       Bytes received so far: at least the request line, maybe the whole head and some body.
+ * @param len       Number of bytes in req.
+ * @param result    Receives the outcome.
+ */
+void proxy_forward(int client_fd, const char* req, size_t len, ProxyResult* result);
+
+/**
+ * @brief Writes proxy counters as JSON (the "proxy" /__stats section).
+ *
+ * @param out Stream receiving a JSON object.
+ * @param ctx Unused.
+ */
+void proxy_write_stats(std::ostream &out, void* ctx);
@@ -0,0 +1,331 @@
+#include "ratelimit.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <new>
+
+namespace {
+
+const uint64_t TOKEN_ONE = 16;              // tokens are counted in 1/16ths
+const uint64_t TOKEN_MASK = (1 << 24) - 1;  // lower 24 bits of the bucket word
+
+struct Shard {
+    pthread_mutex_t lock;
+    RateLimitEntry entries[RATELIMIT_SHARD_ENTRIES];
+};
+
+// everything every process must see the same: entries and counters
+struct Table {
+    Shard shards[RATELIMIT_SHARDS];
+    std::atomic<uint64_t> admitted;
+    std::atomic<uint64_t> rejected_rate;
+    std::atomic<uint64_t> rejected_conns;
+    std::atomic<uint64_t> table_full;
+    std::atomic<uint64_t> claimed;
+    std::atomic<uint64_t> reused;
+};
+
+Table own_table;
+// own_table, or the copy in a segment shared by --prefork workers
+Table* table = &own_table;
+std::atomic<bool> enabled(false);
+RateLimit host_limit;
+RateLimit net_limit;
+// an idle entry is reused only once its bucket would be full again
+long long reuse_after_ms = RATELIMIT_IDLE_MS;
+long long epoch_ms = 0;
+
+// entries (index + 1, 0 for none) an open connection counts against; written
+// on the accepting thread before the fd is handed to a worker
+uint32_t conn_entries[RATELIMIT_MAX_FDS][2];
+
+long long now_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// splitmix64 finalizer; spreads neighbouring addresses over all shards
+uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x ? x : 1; // 0 marks a free entry
+}
+
+uint64_t load_be64(const unsigned char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = v << 8 | p[i];
+    return v;
+}
+
+// keys of the client's address and of its /24 or /64; false for non-IP clients
+bool client_keys(const sockaddr_storage &addr, uint64_t* host, uint64_t* net) {
+    uint32_t v4;
+    if (addr.ss_family == AF_INET) {
+        v4 = ntohl(((const sockaddr_in &)addr).sin_addr.s_addr);
+    } else if (addr.ss_family == AF_INET6) {
+        const in6_addr &a = ((const sockaddr_in6 &)addr).sin6_addr;
+        if (!IN6_IS_ADDR_V4MAPPED(&a)) {
+            uint64_t hi = load_be64(a.s6_addr), lo = load_be64(a.s6_addr + 8);
+            *host = mix(mix(hi + 3) ^ lo);
+            *net = mix(hi + 4);
+            return true;
+        }
+        // a dual-stack listener sees IPv4 clients as ::ffff:a.b.c.d
+        v4 = ntohl(*(const uint32_t*)(a.s6_addr + 12));
+    } else {
+        return false;
+    }
+    *host = mix(1ULL << 32 | v4);
+    *net = mix(2ULL << 32 | (v4 & 0xffffff00));
+    return true;
+}
+
+uint64_t bucket_word(long long now, uint64_t tokens) {
+    return (uint64_t)now << 24 | tokens;
+}
+
+uint64_t capacity(const RateLimit &limit) {
+    return std::min((uint64_t)(limit.burst * TOKEN_ONE), TOKEN_MASK);
+}
+
+RateLimitEntry* entry_at(uint32_t index) {
+    return &table->shards[index / RATELIMIT_SHARD_ENTRIES].entries[index % RATELIMIT_SHARD_ENTRIES];
+}
+
+/**
+ * Index of the key's entry, claiming one if the key is new; -1 if every
+ * entry in its probe window is in use. Only claiming takes the shard lock.
+ * A reused entry may still be touched by a thread that matched its old key
+ * a moment before; as reuse needs a minute of idleness, that costs at most
+ * one token.
+ */
+int64_t find_entry(uint64_t key, const RateLimit &limit, long long now) {
+    uint32_t s = key % RATELIMIT_SHARDS;
+    uint32_t start = (key / RATELIMIT_SHARDS) % RATELIMIT_SHARD_ENTRIES;
+    Shard &shard = table->shards[s];
+
+    for (int i = 0; i < RATELIMIT_PROBE_MAX; i++) {
+        uint32_t slot = (start + i) % RATELIMIT_SHARD_ENTRIES;
+        uint64_t k = shard.entries[slot].key.load(std::memory_order_acquire);
+        if (k == key) return (int64_t)s * RATELIMIT_SHARD_ENTRIES + slot;
+        if (k == 0) break; // entries are never freed, so the key is not further on
+    }
+
+    // a worker process that died holding the lock leaves at most one entry half claimed
+    if (pthread_mutex_lock(&shard.lock) == EOWNERDEAD) pthread_mutex_consistent(&shard.lock);
+    int64_t found = -1, free_slot = -1;
+    for (int i = 0; i < RATELIMIT_PROBE_MAX && found < 0; i++) {
+        uint32_t slot = (start + i) % RATELIMIT_SHARD_ENTRIES;
+        RateLimitEntry &e = shard.entries[slot];
+        uint64_t k = e.key.load(std::memory_order_relaxed);
+        if (k == key) found = slot;
+        if (free_slot >= 0) continue;
+        if (k == 0) {
+            free_slot = slot;
+            break;
+        }
+        long long last = (long long)(e.bucket.load(std::memory_order_relaxed) >> 24);
+        if (e.conns.load(std::memory_order_relaxed) == 0 && now - last >= reuse_after_ms) free_slot = slot;
+    }
+    if (found < 0 && free_slot >= 0) {
+        RateLimitEntry &e = shard.entries[free_slot];
+        if (e.key.load(std::memory_order_relaxed)) table->reused++;
+        else table->claimed++;
+        e.bucket.store(bucket_word(now, capacity(limit)), std::memory_order_relaxed);
+        e.conns.store(0, std::memory_order_relaxed);
+        e.key.store(key, std::memory_order_release);
+        found = free_slot;
+    }
+    pthread_mutex_unlock(&shard.lock);
+    return found < 0 ? -1 : (int64_t)s * RATELIMIT_SHARD_ENTRIES + found;
+}
+
+// refills the bucket for the time since its last refill and takes one token
+bool take_token(RateLimitEntry* e, const RateLimit &limit, long long now) {
+    if (limit.rate <= 0) return true;
+    uint64_t cap = capacity(limit);
+    uint64_t old = e->bucket.load(std::memory_order_relaxed);
+    for (;;) {
+        long long last = (long long)(old >> 24);
+        uint64_t tokens = old & TOKEN_MASK;
+        long long at = std::max(now, last);
+        tokens = std::min(cap, tokens + (uint64_t)((at - last) * limit.rate * TOKEN_ONE / 1000));
+        // out of tokens: nothing is written, the refill is recomputed next time
+        if (tokens < TOKEN_ONE) return false;
+        if (e->bucket.compare_exchange_weak(old, bucket_word(at, tokens - TOKEN_ONE), std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+// counts the connection as open unless that would exceed the limit
+bool take_conn(RateLimitEntry* e, const RateLimit &limit) {
+    int32_t open = e->conns.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (limit.max_conns <= 0 || open <= limit.max_conns) return true;
+    e->conns.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+}
+
+// empties the table; the locks work across processes, for a table in shared memory
+void clear_table(Table* t) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    for (Shard &s : t->shards) {
+        pthread_mutex_init(&s.lock, &attr);
+        for (RateLimitEntry &e : s.entries) {
+            e.key.store(0, std::memory_order_relaxed);
+            e.bucket.store(0, std::memory_order_relaxed);
+            e.conns.store(0, std::memory_order_relaxed);
+        }
+    }
+    pthread_mutexattr_destroy(&attr);
+    for (std::atomic<uint64_t>* c : { &t->admitted, &t->rejected_rate, &t->rejected_conns, &t->table_full, &t->claimed,
+                                      &t->reused }) {
+        c->store(0, std::memory_order_relaxed);
+    }
+}
+
+// "R" or "R/B"; the burst defaults to two seconds' worth
+void parse_rate(const char* arg, RateLimit* limit) {
+    char* end;
+    limit->rate = strtod(arg, &end);
+    limit->burst = *end == '/' ? strtod(end + 1, NULL) : 2 * limit->rate;
+    limit->burst = std::max(limit->burst, 1.0);
+}
+
+} // namespace
+
+int ratelimit_init(int argc, char** argv){
+  RateLimit host = {0, 0, 0}, net = {0, 0, 0};
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--rate-limit") == 0) parse_rate(argv[++i], &host);
+    else if (strcmp(argv[i], "--conn-limit") == 0) host.max_conns = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--net-rate-limit") == 0) parse_rate(argv[++i], &net);
+    else if (strcmp(argv[i], "--net-conn-limit") == 0) net.max_conns = atoi(argv[++i]);
+  }
+  if (host.rate <= 0 && host.max_conns <= 0 && net.rate <= 0 && net.max_conns <= 0) return 0;
+
+  ratelimit_configure(host, net);
+  printf("Rate limits per address: %.1f/s (burst %.0f), %d open; per network: %.1f/s (burst %.0f), %d open\n",
+         host.rate, host.burst, host.max_conns, net.rate, net.burst, net.max_conns);
+  return 1;
+}
+
+void ratelimit_configure(const RateLimit &host, const RateLimit &net){
+  host_limit = host;
+  net_limit = net;
+  reuse_after_ms = RATELIMIT_IDLE_MS;
+  for (const RateLimit* l : { &host_limit, &net_limit }){
+    if (l->rate > 0) reuse_after_ms = std::max(reuse_after_ms, (long long)(l->burst / l->rate * 1000) + 1);
+  }
+  // bucket timestamps count from here, so 40 bits last for decades
+  epoch_ms = now_ms() - reuse_after_ms;
+
+  clear_table(table);
+  memset(conn_entries, 0, sizeof(conn_entries));
+  enabled.store(true, std::memory_order_release);
+}
+
+size_t ratelimit_shared_size(){
+  return enabled.load(std::memory_order_relaxed) ? sizeof(Table) : 0;
+}
+
+void ratelimit_share(void* mem){
+  if (!mem){
+    table = &own_table;
+    return;
+  }
+  table = new (mem) Table();
+  clear_table(table);
+}
+
+RateLimitVerdict ratelimit_admit(int client_fd, const sockaddr_storage &client_addr){
+  if (!enabled.load(std::memory_order_acquire)) return RATELIMIT_ADMIT;
+  uint64_t host_key, net_key;
+  if (!client_keys(client_addr, &host_key, &net_key)) return RATELIMIT_ADMIT;
+
+  long long now = now_ms() - epoch_ms;
+  bool host_on = host_limit.rate > 0 || host_limit.max_conns > 0;
+  bool net_on = net_limit.rate > 0 || net_limit.max_conns > 0;
+  int64_t host = host_on ? find_entry(host_key, host_limit, now) : -1;
+  int64_t net = net_on ? find_entry(net_key, net_limit, now) : -1;
+  // a full table must not lock everybody out: unknown clients go unlimited
+  if ((host_on && host < 0) || (net_on && net < 0)) table->table_full++;
+
+  // open connections are only tracked for fds the release table can hold
+  bool tracked = client_fd >= 0 && client_fd < RATELIMIT_MAX_FDS;
+  RateLimitEntry* h = host >= 0 ? entry_at(host) : NULL;
+  RateLimitEntry* n = net >= 0 ? entry_at(net) : NULL;
+  if (tracked){
+    if (h && !take_conn(h, host_limit)){
+      table->rejected_conns++;
+      return RATELIMIT_CONNS;
+    }
+    if (n && !take_conn(n, net_limit)){
+      if (h) h->conns.fetch_sub(1, std::memory_order_relaxed);
+      table->rejected_conns++;
+      return RATELIMIT_CONNS;
+    }
+  }
+
+  if ((h && !take_token(h, host_limit, now)) || (n && !take_token(n, net_limit, now))){
+    if (tracked && h) h->conns.fetch_sub(1, std::memory_order_relaxed);
+    if (tracked && n) n->conns.fetch_sub(1, std::memory_order_relaxed);
+    table->rejected_rate++;
+    return RATELIMIT_RATE;
+  }
+
+  if (tracked){
+    conn_entries[client_fd][0] = h ? (uint32_t)host + 1 : 0;
+    conn_entries[client_fd][1] = n ? (uint32_t)net + 1 : 0;
+  }
+  table->admitted++;
+  return RATELIMIT_ADMIT;
+}
+
+void ratelimit_reject(int client_fd, RateLimitVerdict verdict, bool tls){
+  // with unread data in the receive queue, close() would send a reset
+  char buf[4096];
+  for (int i = 0; i < 4 && recv(client_fd, buf, sizeof(buf), MSG_DONTWAIT) > 0; i++){}
+  // a TLS client would take plaintext for a broken handshake; it just sees the close
+  if (tls){
+    close(client_fd);
+    return;
+  }
+
+  const char* body = verdict == RATELIMIT_CONNS ? "too many open connections\n" : "too many requests\n";
+  char resp[256];
+  int len = snprintf(resp, sizeof(resp),
+                     "HTTP/1.0 429 Too Many Requests\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n"
+                     "Retry-After: 1\r\nConnection: close\r\n\r\n%s",
+                     strlen(body), body);
+  send(client_fd, resp, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+  close(client_fd);
+}
+
+void ratelimit_release(int client_fd){
+  if (!enabled.load(std::memory_order_relaxed) || client_fd < 0 || client_fd >= RATELIMIT_MAX_FDS) return;
+  for (uint32_t &index : conn_entries[client_fd]){
+    if (index) entry_at(index - 1)->conns.fetch_sub(1, std::memory_order_relaxed);
+    index = 0;
+  }
+}
+
+void ratelimit_write_stats(std::ostream &out, void*){
+  const Table &t = *table;
+  out << "{\"admitted\": " << t.admitted.load() << ", \"rejected_rate\": " << t.rejected_rate.load()
+      << ", \"rejected_conns\": " << t.rejected_conns.load() << ", \"table_full\": " << t.table_full.load()
+      << ", \"entries\": " << t.claimed.load() << ", \"reused\": " << t.reused.load() << "}";
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <sys/socket.h>
+
+/**
+ * Per-client admission control, checked right after accept().
+ *
+ * Every client address is charged against two token buckets and two
+ * concurrent-connection counters: one for the address itself and one for
+ * its network (the /24 of an IPv4 address, the /64 of an IPv6 one), so a
+ * client cannot dodge the limit by rotating through its neighbours'
+ * addresses. A connection over either limit is answered with 429 and
+ * closed before it reaches a worker. Unix domain clients are not limited.
+ *
+ * The state lives in a fixed table of cache-line-sized entries, split into
+ * shards with open addressing. Lookups and token updates are lock-free (one
+ * compare-and-swap on a packed timestamp/tokens word); only claiming an
+ * entry for a new client takes the shard's lock. There is no sweeper:
+ * an entry idle long enough to have refilled its bucket is simply reused.
+ * Under --prefork the table moves into the workers' shared segment, so the
+ * limits hold for the server as a whole rather than for each process.
+ */
+
+// shards of the table, each with its own insert lock
+const int RATELIMIT_SHARDS = 64;
+// entries per shard (power of two); 64 * 1024 clients and networks in all
+const int RATELIMIT_SHARD_ENTRIES = 1024;
+// entries probed for a key before the table counts as full
+const int RATELIMIT_PROBE_MAX = 16;
+// an entry idle this long (and at least until its bucket is full) may be reused
+const int RATELIMIT_IDLE_MS = 60 * 1000;
+// client fds above this are admitted without a connection limit
+const int RATELIMIT_MAX_FDS = 64 * 1024;
+
+/**
+ * @struct RateLimit
+ * @brief Limits applied to one client address or one network
+ * @var rate      Connections per second refilled into the bucket, 0 for no rate limit
+ * @var burst     Bucket capacity: connections allowed at once after a quiet period
+ * @var max_conns Connections open at the same time, 0 for no limit
+*/
+typedef struct{
+    double rate;
+    double burst;
+    int max_conns;
+  } RateLimit;
+
+/**
+ * @struct RateLimitEntry
+ * @brief State of one client address or network, alone on its cache line
+ * @var key    Hash of the address or network, 0 while the entry is free
+ * @var bucket Last refill in ms (upper 40 bits) and tokens in 1/16ths (lower 24 bits)
+ * @var conns  Connections currently open
+*/
+typedef struct alignas(64){
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> bucket;
+    std::atomic<int32_t> conns;
+  } RateLimitEntry;
+
+enum RateLimitVerdict {
+    RATELIMIT_ADMIT,      // serve the connection
+    RATELIMIT_RATE,       // the address or its network is out of tokens
+    RATELIMIT_CONNS,      // too many connections open from the address or its network
+};
+
+/**
+ * @brief Turns rate limiting on if the command line asks for it.
+ * Understands "--rate-limit R[/B]" (R connections per second per address,
+ * bursts of B, default 2R), "--conn-limit N" (open connections per address)
+ * and "--net-rate-limit R[/B]", "--net-conn-limit N" for the /24 or /64.
+ *
+ * @param argc main()'s argc.
+ * @param argv main()'s argv.
+ * @return 1 if limits are on, 0 if none were requested
+ */
+int ratelimit_init(int argc, char** argv);
+
+/**
+ * @brief Sets the limits directly (tests, embedding) and clears the table and counters.
+ * Call before any connection is admitted.
+ *
+ * @param host Limits per client address.
+ * @param net  Limits per /24 (IPv4) or /64 (IPv6) network.
+ */
+void ratelimit_configure(const RateLimit &host, const RateLimit &net);
+
+/**
+ * @brief Bytes of shared memory the table needs to be shared between processes.
+ *
+ * @return Size of the table, 0 while limits are off
+ */
+size_t ratelimit_shared_size();
+
+/**
+ * @brief Moves the table into memory shared by worker processes (prefork_run()).
+ * Call after the limits are configured and before any process admits a
+ * connection; the table starts out empty. Connections a worker had open
+ * when it died stay counted against their address: nobody is left to
+ * release them.
+ *
+ * @param mem ratelimit_shared_size() bytes of MAP_SHARED memory, 64-byte aligned;
+ *            NULL goes back to the process's own table.
+ */
+void ratelimit_share(void* mem);
+
+/**
+ * @brief Decides whether a freshly accepted connection may be served.
+ * An admitted connection counts as open until ratelimit_release().
+ *
+ * @param client_fd   Accepted client socket.
+ * @param client_addr Address accept_client() filled in.
+ * @return RATELIMIT_ADMIT, or why the connection must be turned away
+ */
+RateLimitVerdict ratelimit_admit(int client_fd, const sockaddr_storage &client_addr);
+
+/**
+ * @brief Answers a turned-away connection with 429 and closes it.
+ * Never blocks: whatever request bytes have arrived are discarded first,
+ * so the close does not reset the connection before the client reads the answer.
+ * A connection on an HTTPS listener is closed without an answer, as
+ * nothing has been negotiated to send one over.
+ *
+ * @param client_fd Accepted client socket (closed on return).
+ * @param verdict   Why it was turned away.
+ * @param tls       Whether the client came in on an HTTPS listener (https_client()).
+ */
+void ratelimit_reject(int client_fd, RateLimitVerdict verdict, bool tls);
+
+/**
+ * @brief Ends an admitted connection's share of its open-connection limits.
+ * Call right before closing the client socket; no-op if limits are off.
+ *
+ * @param client_fd Client socket passed to ratelimit_admit().
+ */
+void ratelimit_release(int client_fd);
+
+/**
+ * @brief Writes admission counters as JSON (the "ratelimit" /__stats section).
+ *
+ * @param out Stream receiving a JSON object.
+ * @param ctx Unused.
+ */
+void ratelimit_write_stats(std::ostream &out, void* ctx);
@@ -0,0 +1,218 @@
+#include "reactor.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace {
+
+// max events handled per epoll_wait() call
+const int MAX_EVENTS = 256;
+
+// runs the operation once without blocking
+ssize_t try_op(IoAwaitable* io) {
+    switch (io->op) {
+    case IoAwaitable::ACCEPT: {
+        socklen_t len = sizeof(sockaddr_storage);
+        return accept4(io->fd, (sockaddr*)io->buf, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    }
+    case IoAwaitable::RECV:
+        return recv(io->fd, io->buf, io->len, 0);
+    case IoAwaitable::SEND:
+        return send(io->fd, io->buf, io->len, MSG_NOSIGNAL);
+    case IoAwaitable::SENDFILE:
+        return sendfile(io->fd, io->file_fd, io->offset, io->len);
+    case IoAwaitable::SLEEP:
+        return 0;
+    }
+    return -1;
+}
+
+bool would_block(ssize_t r) {
+    return r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+bool out_of_fds(ssize_t r) {
+    return r < 0 && (errno == EMFILE || errno == ENFILE);
+}
+
+long long now_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// epoll_wait() timeout until the earliest timer, -1 if none is pending
+int next_timeout(Reactor* reactor) {
+    if (reactor->timers.empty()) return -1;
+    long long first = reactor->timers[0].first;
+    for (const auto &t : reactor->timers) first = std::min(first, t.first);
+    return (int)std::max(0LL, first - now_ms());
+}
+
+// resumes every coroutine whose deadline has passed
+void fire_timers(Reactor* reactor) {
+    if (reactor->timers.empty()) return;
+    long long now = now_ms();
+    std::vector<void*> due;
+    for (size_t i = 0; i < reactor->timers.size();) {
+        if (reactor->timers[i].first <= now) {
+            due.push_back(reactor->timers[i].second);
+            reactor->timers[i] = reactor->timers.back();
+            reactor->timers.pop_back();
+        } else {
+            i++;
+        }
+    }
+    // resumed coroutines may add timers of their own
+    for (void* h : due) std::coroutine_handle<>::from_address(h).resume();
+}
+
+IoAwaitable make_io(Reactor* reactor, IoAwaitable::Op op, int fd) {
+    IoAwaitable io{};
+    io.reactor = reactor;
+    io.op = op;
+    io.fd = fd;
+    io.file_fd = -1;
+    io.offset = NULL;
+    io.sleep_ms = 0;
+    io.result = -1;
+    io.suspended = false;
+    return io;
+}
+
+} // namespace
+
+bool IoAwaitable::await_ready() {
+    if (op == SLEEP) return false;
+    result = try_op(this);
+    // accepting again right away would fail again and never let the
+    // clients that hold the descriptors run, so wait for some to close
+    if (op == ACCEPT && out_of_fds(result)) {
+        sleep_ms = REACTOR_ACCEPT_BACKOFF_MS;
+        return false;
+    }
+    return !would_block(result);
+}
+
+bool IoAwaitable::await_suspend(std::coroutine_handle<> h) {
+    if (sleep_ms > 0) {
+        reactor->timers.push_back(std::make_pair(now_ms() + sleep_ms, h.address()));
+        suspended = true;
+        return true;
+    }
+
+    // one-shot interest: the fd is disarmed again as soon as it fires,
+    // so each wakeup resumes exactly the coroutine that asked for it
+    epoll_event ev{};
+    ev.events = (op == ACCEPT || op == RECV ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+    ev.data.ptr = h.address();
+
+    if ((size_t)fd >= reactor->registered.size()) reactor->registered.resize(fd + 1, 0);
+    int ctl = reactor->registered[fd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(reactor->epfd, ctl, fd, &ev) < 0) {
+        perror("epoll_ctl");
+        // don't suspend; await_resume() reports the failure
+        result = -1;
+        return false;
+    }
+    reactor->registered[fd] = 1;
+    suspended = true;
+    return true;
+}
+
+ssize_t IoAwaitable::await_resume() {
+    // errno from the first try is long gone by now, so retry on the flag
+    if (suspended) result = try_op(this);
+    return result;
+}
+
+int reactor_init(Reactor* reactor){
+  reactor->clients = 0;
+  reactor->draining = false;
+  reactor->stop = false;
+  reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (reactor->epfd < 0){
+    perror("epoll_create1");
+    return -1;
+  }
+  return 0;
+}
+
+void reactor_run(Reactor* reactor){
+  epoll_event events[MAX_EVENTS];
+
+  while (!reactor->stop){
+    int n = epoll_wait(reactor->epfd, events, MAX_EVENTS, next_timeout(reactor));
+    if (n < 0){
+      if (errno == EINTR) continue;
+      perror("epoll_wait");
+      break;
+    }
+    for (int i = 0; i < n; i++){
+      std::coroutine_handle<>::from_address(events[i].data.ptr).resume();
+    }
+    fire_timers(reactor);
+  }
+}
+
+void reactor_destroy(Reactor* reactor){
+  close(reactor->epfd);
+  reactor->registered.clear();
+  reactor->timers.clear();
+}
+
+void reactor_close(Reactor* reactor, int fd){
+  if ((size_t)fd < reactor->registered.size() && reactor->registered[fd]){
+    epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, fd, NULL);
+    reactor->registered[fd] = 0;
+  }
+  close(fd);
+}
+
+int set_nonblocking(int fd){
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0){
+    perror("fcntl");
+    return -1;
+  }
+  return 0;
+}
+
+IoAwaitable async_accept(Reactor* reactor, int listen_fd, sockaddr_storage* addr){
+  IoAwaitable io = make_io(reactor, IoAwaitable::ACCEPT, listen_fd);
+  io.buf = addr;
+  return io;
+}
+
+IoAwaitable async_recv(Reactor* reactor, int fd, void* buf, size_t len){
+  IoAwaitable io = make_io(reactor, IoAwaitable::RECV, fd);
+  io.buf = buf;
+  io.len = len;
+  return io;
+}
+
+IoAwaitable async_send(Reactor* reactor, int fd, const void* buf, size_t len){
+  IoAwaitable io = make_io(reactor, IoAwaitable::SEND, fd);
+  io.buf = (void*)buf;
+  io.len = len;
+  return io;
+}
+
+IoAwaitable async_sendfile(Reactor* reactor, int fd, int file_fd, off_t* offset, size_t count){
+  IoAwaitable io = make_io(reactor, IoAwaitable::SENDFILE, fd);
+  io.file_fd = file_fd;
+  io.offset = offset;
+  io.len = count;
+  return io;
+}
+
+IoAwaitable async_sleep(Reactor* reactor, int ms){
+  IoAwaitable io = make_io(reactor, IoAwaitable::SLEEP, -1);
+  io.sleep_ms = ms > 0 ? ms : 1;
+  return io;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+// how long async_accept() waits before retrying when the process is out of descriptors
+const int REACTOR_ACCEPT_BACKOFF_MS = 100;
+
+/**
+  * @struct Reactor
+  * @brief Single-threaded epoll event loop that resumes suspended coroutines
+  * @var epfd       epoll instance
+  * @var registered Per-fd flag: has this fd already been added to epfd
+  * @var timers     Coroutines sleeping until a CLOCK_MONOTONIC deadline (ms)
+  * @var clients    Number of client coroutines still running
+  * @var draining   No new clients are accepted; stop once clients reaches 0
+  * @var stop       Flag to make reactor_run() return
+*/
+typedef struct{
+    int epfd;
+    std::vector<char> registered;
+    std::vector<std::pair<long long, void*>> timers;
+    int clients;
+    bool draining;
+    bool stop;
+  } Reactor;
+
+/**
+ * @struct Task
+ * @brief Fire-and-forget coroutine type.
+ * The coroutine starts running immediately and its frame is freed as soon
+ * as it finishes, so a connection costs one small heap frame and nothing else.
+ */
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/**
+ * @struct IoAwaitable
+ * @brief Awaitable for one non-blocking socket operation.
+ * The operation is tried first; only if it would block does the coroutine
+ * suspend until epoll reports the fd ready, then the operation is retried.
+ * co_await yields the syscall result (-1 with errno set on error).
+ * SLEEP has no syscall: it suspends on the reactor's timer list instead.
+ */
+struct IoAwaitable {
+    enum Op { ACCEPT, RECV, SEND, SENDFILE, SLEEP };
+
+    Reactor* reactor;
+    Op op;
+    int fd;
+    void* buf;        // RECV/SEND buffer, or sockaddr_storage* for ACCEPT
+    size_t len;
+    int file_fd;      // SENDFILE source
+    off_t* offset;    // SENDFILE position, advanced by the kernel
+    int sleep_ms;     // > 0: wait on a timer rather than on the fd
+    ssize_t result;
+    bool suspended;   // true once we had to wait, so the op must be retried
+
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> h);
+    ssize_t await_resume();
+};
+
+/**
+ * @brief Creates the epoll instance.
+ *
+ * @param reactor Pointer to the Reactor to initialize.
+ *
+ * @return 0 if successful, -1 on error
+ */
+int reactor_init(Reactor* reactor);
+
+/**
+ * @brief Runs the event loop until reactor->stop is set.
+ * Every ready event resumes the coroutine that was waiting on it.
+ *
+ * @param reactor Pointer to the initialized Reactor.
+ */
+void reactor_run(Reactor* reactor);
+
+/**
+ * @brief Closes the epoll instance.
+ *
+ * @param reactor Pointer to the Reactor to destroy.
+ */
+void reactor_destroy(Reactor* reactor);
+
+/**
+ * @brief Removes an fd from the reactor and closes it.
+ * Use this instead of close() for sockets that were ever awaited on.
+ *
+ * @param reactor Pointer to the Reactor.
+ * @param fd      Socket to close.
+ */
+void reactor_close(Reactor* reactor, int fd);
+
+/**
+ * @brief Puts a socket into non-blocking mode, as every awaited fd must be.
+ *
+ * @param fd Socket to change.
+ *
+ * @return 0 if successful, -1 on error
+ */
+int set_nonblocking(int fd);
+
+/**
+ * @brief Awaitable accept(); the new socket is already non-blocking.
+ * If the process or system is out of descriptors (EMFILE/ENFILE) the
+ * coroutine sleeps REACTOR_ACCEPT_BACKOFF_MS and tries once more instead of
+ * failing at once, so an accept loop cannot starve the clients whose
+ * close() would free a descriptor.
+ */
+IoAwaitable async_accept(Reactor* reactor, int listen_fd, sockaddr_storage* addr);
+
+/** @brief Awaitable recv() of up to len bytes. */
+IoAwaitable async_recv(Reactor* reactor, int fd, void* buf, size_t len);
+
+/** @brief Awaitable send() of up to len bytes (may be partial). */
+IoAwaitable async_send(Reactor* reactor, int fd, const void* buf, size_t len);
+
+/** @brief Awaitable sendfile() of up to count bytes from file_fd at *offset. */
+IoAwaitable async_sendfile(Reactor* reactor, int fd, int file_fd, off_t* offset, size_t count);
+
+/** @brief Awaitable pause of ms milliseconds; yields 0. */
+IoAwaitable async_sleep(Reactor* reactor, int ms);
@@ -0,0 +1,150 @@
+#include "response_cache.h"
+#include "ebr.h"
+#include <algorithm>
+#include <stdio.h>
+#include <vector>
+
+namespace {
+
+// FNV-1a with a murmur3 finalizer so the low bits used for buckets are mixed
+uint64_t hash_path(const std::string &path) {
+    uint64_t h = 1469598103934665603ULL;
+    for (char c : path) {
+        h ^= (unsigned char)c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+size_t pow2_at_least(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+void free_entry(void* p) {
+    delete (CachedResponse*)p;
+}
+
+// unlinks an entry from its chain and retires it; caller holds write_lock
+void remove_locked(ResponseCache* cache, CachedResponse* e) {
+    std::atomic<CachedResponse*>* link = &cache->buckets[e->hash & cache->mask];
+    CachedResponse* cur;
+    while ((cur = link->load(std::memory_order_relaxed)) != e) link = &cur->next;
+    // readers standing on e still find the rest of the chain through e->next
+    link->store(e->next.load(std::memory_order_relaxed), std::memory_order_release);
+
+    cache->fifo.erase(std::find(cache->fifo.begin(), cache->fifo.end(), e));
+    ebr_retire(e, free_entry);
+}
+
+// entry for a path, or NULL; caller holds write_lock
+CachedResponse* find_locked(ResponseCache* cache, const std::string &path, uint64_t hash) {
+    CachedResponse* e = cache->buckets[hash & cache->mask].load(std::memory_order_relaxed);
+    for (; e; e = e->next.load(std::memory_order_relaxed)) {
+        if (e->hash == hash && e->path == path) return e;
+    }
+    return NULL;
+}
+
+} // namespace
+
+int response_cache_init(ResponseCache* cache, size_t capacity){
+  cache->capacity = capacity > 0 ? capacity : 1;
+  // about two buckets per entry keeps chains at one entry or none
+  size_t num_buckets = pow2_at_least(cache->capacity * 2);
+  cache->buckets = new std::atomic<CachedResponse*>[num_buckets];
+  for (size_t i = 0; i < num_buckets; i++) cache->buckets[i].store(NULL, std::memory_order_relaxed);
+  cache->mask = num_buckets - 1;
+  cache->generation.store(0, std::memory_order_relaxed);
+  cache->inserts = cache->replacements = cache->invalidations = cache->evictions = 0;
+
+  if (pthread_mutex_init(&cache->write_lock, NULL) != 0){
+    perror("Failed to init response cache lock");
+    delete[] cache->buckets;
+    return -1;
+  }
+  return 0;
+}
+
+void response_cache_destroy(ResponseCache* cache){
+  // entries already retired may still sit in the EBR limbo list
+  ebr_synchronize();
+  for (CachedResponse* e : cache->fifo) delete e;
+  cache->fifo.clear();
+  delete[] cache->buckets;
+  pthread_mutex_destroy(&cache->write_lock);
+}
+
+const CachedResponse* response_cache_lookup(const ResponseCache* cache, const std::string &path, long long now_ms){
+  uint64_t hash = hash_path(path);
+  const CachedResponse* e = cache->buckets[hash & cache->mask].load(std::memory_order_acquire);
+  for (; e; e = e->next.load(std::memory_order_acquire)){
+    if (e->hash == hash && e->path == path) return now_ms < e->expires_ms ? e : NULL;
+  }
+  return NULL;
+}
+
+uint64_t response_cache_generation(const ResponseCache* cache){
+  return cache->generation.load(std::memory_order_acquire);
+}
+
+bool response_cache_insert(ResponseCache* cache, CachedResponse* entry, uint64_t generation){
+  entry->hash = hash_path(entry->path);
+
+  pthread_mutex_lock(&cache->write_lock);
+  if (cache->generation.load(std::memory_order_relaxed) != generation){
+    // the file may have changed while this response was being built
+    pthread_mutex_unlock(&cache->write_lock);
+    delete entry;
+    return false;
+  }
+
+  if (CachedResponse* old = find_locked(cache, entry->path, entry->hash)){
+    remove_locked(cache, old);
+    cache->replacements++;
+  } else if (cache->fifo.size() >= cache->capacity){
+    remove_locked(cache, cache->fifo.front());
+    cache->evictions++;
+  }
+
+  // fully built before the release store makes it reachable
+  std::atomic<CachedResponse*>* head = &cache->buckets[entry->hash & cache->mask];
+  entry->next.store(head->load(std::memory_order_relaxed), std::memory_order_relaxed);
+  head->store(entry, std::memory_order_release);
+  cache->fifo.push_back(entry);
+  cache->inserts++;
+  pthread_mutex_unlock(&cache->write_lock);
+  return true;
+}
+
+void response_cache_invalidate(ResponseCache* cache, const std::string &path){
+  uint64_t hash = hash_path(path);
+
+  pthread_mutex_lock(&cache->write_lock);
+  cache->generation.store(cache->generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  if (CachedResponse* e = find_locked(cache, path, hash)){
+    remove_locked(cache, e);
+    cache->invalidations++;
+  }
+  pthread_mutex_unlock(&cache->write_lock);
+}
+
+void response_cache_invalidate_prefix(ResponseCache* cache, const std::string &prefix){
+  std::string dir = prefix + "/";
+
+  pthread_mutex_lock(&cache->write_lock);
+  cache->generation.store(cache->generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  std::vector<CachedResponse*> stale;
+  for (CachedResponse* e : cache->fifo){
+    if (e->path == prefix || e->path.compare(0, dir.size(), dir) == 0) stale.push_back(e);
+  }
+  for (CachedResponse* e : stale){
+    remove_locked(cache, e);
+    cache->invalidations++;
+  }
+  pthread_mutex_unlock(&cache->write_lock);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// max number of responses kept (bodies are at most INLINE_BODY_MAX bytes each)
+const size_t RESPONSE_CACHE_CAPACITY = 512;
+
+/**
+ * Read-mostly cache of complete small responses, keyed by file path.
+ *
+ * Lookups take no lock and do no atomic read-modify-write: the table has a
+ * fixed number of buckets whose chains are only ever changed by swapping a
+ * single pointer, and readers run inside an EBR read section (ebr.h), so a
+ * replaced or evicted entry is freed only after every reader has moved on.
+ * Writers (inserts after a miss, invalidations from the docroot watcher)
+ * serialize on one mutex and never wait for readers.
+ */
+
+/**
+  * @struct CachedResponse
+  * @brief One cached 200 response; immutable once published
+  * @var path          Resolved file path (the key)
+  * @var hash          Hash of path
+  * @var bytes         Status line, headers and body, ready to send
+  * @var header_len    Bytes of bytes taken by the headers
+  * @var mime          Content-Type value
+  * @var cache_control Cache-Control value (a string literal)
+  * @var expires_ms    Monotonic time after which the entry is ignored
+  * @var next          Next entry in the bucket chain
+*/
+typedef struct CachedResponse{
+    std::string path;
+    uint64_t hash;
+    std::string bytes;
+    size_t header_len;
+    std::string mime;
+    const char* cache_control;
+    long long expires_ms;
+    std::atomic<CachedResponse*> next;
+  } CachedResponse;
+
+/**
+  * @struct ResponseCache
+  * @brief Fixed-size chained hash table of CachedResponse
+  * @var buckets     Chain heads, read without locking
+  * @var mask        Number of buckets - 1 (a power of two)
+  * @var capacity    Max number of entries
+  * @var generation  Bumped by every invalidation (see response_cache_insert())
+  * @var write_lock  Serializes inserts, invalidations and evictions
+  * @var fifo        Entries in insertion order, oldest evicted first (writers only)
+  * @var inserts, replacements, invalidations, evictions  Counters (writers only)
+*/
+typedef struct{
+    std::atomic<CachedResponse*>* buckets;
+    size_t mask;
+    size_t capacity;
+    std::atomic<uint64_t> generation;
+
+    pthread_mutex_t write_lock;
+    std::deque<CachedResponse*> fifo;
+
+    unsigned long inserts;
+    unsigned long replacements;
+    unsigned long invalidations;
+    unsigned long evictions;
+  } ResponseCache;
+
+/**
+ * @brief Sets up an empty cache.
+ *
+ * @param cache    Cache to initialize.
+ * @param capacity Max number of entries kept at once.
+ * @return 0 if successful, -1 on error
+ */
+int response_cache_init(ResponseCache* cache, size_t capacity);
+
+/**
+ * @brief Frees every entry. No reader may use the cache any more.
+ *
+ * @param cache Cache to destroy.
+ */
+void response_cache_destroy(ResponseCache* cache);
+
+/**
+ * @brief Finds the response cached for a path.
+ * Must be called inside ebr_enter() / ebr_exit(); the entry stays valid
+ * until ebr_exit(), so copy what is needed before leaving the section.
+ *
+ * @param cache  Cache to search.
+ * @param path   Resolved file path.
+ * @param now_ms Current CLOCK_MONOTONIC time in milliseconds.
+ * @return Entry, or NULL if the path is not cached or its entry has expired
+ */
+const CachedResponse* response_cache_lookup(const ResponseCache* cache, const std::string &path, long long now_ms);
+
+/**
+ * @brief Reads the invalidation generation before building a response to insert.
+ *
+ * @param cache Cache.
+ * @return Value to hand to response_cache_insert()
+ */
+uint64_t response_cache_generation(const ResponseCache* cache);
+
+/**
+ * @brief Publishes a response, replacing any entry for the same path.
+ * If an invalidation happened since generation was read, the response may
+ * have been built from the old file and is dropped instead. The oldest
+ * entry is evicted when the cache is full.
+ *
+ * @param cache      Cache.
+ * @param entry      Filled-in entry allocated with new; the cache takes ownership.
+ * @param generation Result of response_cache_generation() taken before the file was read.
+ * @return true if the entry was published
+ */
+bool response_cache_insert(ResponseCache* cache, CachedResponse* entry, uint64_t generation);
+
+/**
+ * @brief Drops the response cached for a path, if any.
+ *
+ * @param cache Cache.
+ * @param path  Resolved file path.
+ */
+void response_cache_invalidate(ResponseCache* cache, const std::string &path);
+
+/**
+ * @brief Drops a path and every response cached below it.
+ *
+ * @param cache  Cache.
+ * @param prefix Directory path; entries equal to it or under prefix + "/" are dropped.
+ */
+void response_cache_invalidate_prefix(ResponseCache* cache, const std::string &prefix);
@@ -0,0 +1,129 @@
+#include "socket.h"
+#include "bundle.h"
+#include "http_parser.h"
+#include "http_async.h"
+#include "lifecycle.h"
+#include "ratelimit.h"
+#include "reactor.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <iostream>
+#include <unistd.h>
+#include <csignal>
+
+/**
+ * @brief Accept loop as a coroutine.
+ * Every accepted client gets its own handle_client_async() coroutine, so
+ * thousands of connections share this one thread instead of one
+ * pthread stack each as in server_multithread.cpp.
+ *
+ * @param reactor   Reactor driving every connection.
+ * @param listen_fd Non-blocking listening socket.
+ */
+Task accept_loop(Reactor* reactor, int listen_fd) {
+    while (!reactor->draining) {
+        sockaddr_storage client;
+        int client_fd = (int)co_await async_accept(reactor, listen_fd, &client);
+
+        if (client_fd < 0) {
+            int err = errno;
+            // the client gave up while queued, or the backlog emptied during an EMFILE backoff
+            if (err == ECONNABORTED || err == EINTR || err == EAGAIN || err == EWOULDBLOCK) continue;
+            perror("accept");
+            // EMFILE/ENFILE already waited inside async_accept(); anything else
+            // (ENOBUFS, a failed epoll_ctl) must not turn into a busy loop either
+            if (err != EMFILE && err != ENFILE) co_await async_sleep(reactor, REACTOR_ACCEPT_BACKOFF_MS);
+            continue;
+        }
+
+        RateLimitVerdict verdict = ratelimit_admit(client_fd, client);
+        if (verdict != RATELIMIT_ADMIT) {
+            ratelimit_reject(client_fd, verdict, false);
+            continue;
+        }
+
+        // starts running right away and suspends at its first blocking point
+        handle_client_async(reactor, client_fd);
+    }
+}
+
+/**
+ * @brief Waits for SIGTERM/SIGUSR2 on the lifecycle wakeup socket.
+ * Once the server should stop accepting (shutdown or successful upgrade
+ * handoff) the listening socket is dropped and the reactor keeps running
+ * only until the clients already in flight have been served.
+ *
+ * @param reactor       Reactor driving every connection.
+ * @param listen_fds    Listening sockets to hand over or close.
+ * @param num_listeners Number of listening sockets.
+ */
+Task lifecycle_watcher(Reactor* reactor, const int* listen_fds, int num_listeners) {
+    char c;
+    while (lifecycle_running(listen_fds, num_listeners)) {
+        co_await async_recv(reactor, lifecycle_wakeup_fd(), &c, 1);
+    }
+
+    for (int i = 0; i < num_listeners; i++) reactor_close(reactor, listen_fds[i]);
+    reactor->draining = true;
+    if (reactor->clients == 0) reactor->stop = true;
+}
+
+int main(int argc, char** argv) {
+    // Graceful drain on SIGTERM, binary upgrade on SIGUSR2 (before any thread starts)
+    lifecycle_init(argv);
+    // A client hanging up mid-sendfile must not kill the whole server
+    signal(SIGPIPE, SIG_IGN);
+    // the reactor's non-blocking handlers do not speak TLS, relay to upstreams or store uploads
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--https") == 0 || strcmp(argv[i], "--proxy") == 0 ||
+            strcmp(argv[i], "--uploads") == 0 || strcmp(argv[i], "--upload-max") == 0) {
+            std::cerr << "server_coro does not support " << argv[i] << ", use server_pool\n";
+            return 1;
+        }
+    }
+    // --bundle FILE serves the files packed by pack_www from one mapping
+    if (bundle_init(argc, argv) < 0) return 1;
+    // --rate-limit / --conn-limit (and --net-* for the /24 or /64) per client address
+    if (ratelimit_init(argc, argv)) http_register_stats("ratelimit", ratelimit_write_stats, NULL);
+    // This is the Server Socket
+    // Asks the OS for a TCP (Transmission Control Protocol) socket boudn to port 8080
+    // Puts it into "Listening Mode"
+    // After a SIGUSR2 upgrade the previous binary hands us its socket instead
+    // Extra --listen SPEC options add IPv6 and Unix domain socket listeners
+    int listen_fds[MAX_LISTENERS];
+    int num_listeners = lifecycle_inherited(listen_fds, MAX_LISTENERS);
+    if (num_listeners == 0) {
+        num_listeners = open_listeners(argc, argv, listen_fds, MAX_LISTENERS, SOMAXCONN);
+    }
+
+    if (num_listeners < 0) {
+        std::cerr << "Failed to open socket\n";
+        return 1;
+    }
+    for (int i = 0; i < num_listeners; i++) {
+        if (set_nonblocking(listen_fds[i]) < 0) {
+            std::cerr << "Failed to open socket\n";
+            return 1;
+        }
+    }
+
+    // Invalidate cached files on change instead of stat()ing them per request
+    http_watch_docroot();
+
+    Reactor reactor;
+    if (reactor_init(&reactor) < 0) {
+        return 1;
+    }
+    printf("Server listening on %d socket(s)...\n", num_listeners);
+
+    lifecycle_ready();
+
+    // one accept coroutine per listener, all on the same reactor
+    for (int i = 0; i < num_listeners; i++) accept_loop(&reactor, listen_fds[i]);
+    lifecycle_watcher(&reactor, listen_fds, num_listeners);
+    reactor_run(&reactor);
+
+    reactor_destroy(&reactor);
+    return 0;
+}
@@ -1,9 +1,17 @@
 #include "socket.h"
+#include "bundle.h"
 #include "http_parser.h"
+#include "lifecycle.h"
+#include "proxy.h"
+#include "https.h"
+#include "ratelimit.h"
+#include "trace.h"
+#include "upload.h"
 
 #include <arpa/inet.h>
 #include <iostream>
 #include <unistd.h>
+#include <csignal>
 #include <pthread.h>
 #include <semaphore.h>
 
@@ -21,39 +29,84 @@ void* client_worker(void* arg) {
 
     handle_client(client_fd);
     
+    ratelimit_release(client_fd);
     close(client_fd);
     printf("[-] Client disconnected (FD: %d)\n", client_fd);
     sem_post(&thread_limiter);
     return NULL;
 }
 
-int main() { 
-    int port = 8080;
+int main(int argc, char** argv) { 
+    // --trace N records spans of 1 in N requests, dumped on SIGUSR1 (before lifecycle_init)
+    trace_init(argc, argv);
+    // Graceful drain on SIGTERM, binary upgrade on SIGUSR2 (before any thread starts)
+    lifecycle_init(argv);
+    // A client hanging up mid-sendfile must not kill the whole server
+    signal(SIGPIPE, SIG_IGN);
+    // --https SPEC adds TLS listeners; the kernel encrypts responses where it can (kTLS)
+    if (https_init(argc, argv) < 0) return 1;
+    // --uploads DIR accepts PUT/POST into ./www/DIR, spliced straight to disk
+    if (upload_init(argc, argv) < 0) return 1;
+    // --bundle FILE serves the files packed by pack_www from one mapping
+    if (bundle_init(argc, argv) < 0) return 1;
+    // --proxy /prefix=SPEC forwards matching URIs to a local upstream
+    if (proxy_init(argc, argv) < 0) return 1;
+    // --rate-limit / --conn-limit (and --net-* for the /24 or /64) per client address
+    if (ratelimit_init(argc, argv)) http_register_stats("ratelimit", ratelimit_write_stats, NULL);
     // This is the Server Socket 
     // Asks the OS for a TCP (Transmission Control Protocol) socket boudn to port 8080
     // Puts it into "Listening Mode"
-    int listen_fd = create_listen_socket(port);
+    // After a SIGUSR2 upgrade the previous binary hands us its socket instead
+    // Extra --listen SPEC options add IPv6 and Unix domain socket listeners
+    int listen_fds[MAX_LISTENERS];
+    int num_listeners = lifecycle_inherited(listen_fds, MAX_LISTENERS);
+    if (num_listeners == 0) {
+        num_listeners = open_listeners(argc, argv, listen_fds, MAX_LISTENERS);
+    }
+    if (num_listeners < 0) {
+        std::cerr << "Failed to open socket\n";
+        return 1;
+    }
+
+    // Invalidate cached files on change instead of stat()ing them per request
+    http_watch_docroot();
 
     sem_init(&thread_limiter, 0, 5);
-    printf("http://localhost:8080/\n");
-    printf("Server listening on port %d...\n", port);
+    printf("Server listening on %d socket(s)...\n", num_listeners);
+
+    lifecycle_ready();
 
-    // This is the "Accept" Loop
-    while (1) {
+    // This is the "Accept" Loop, left on SIGTERM or after handing off to a new binary
+    while (lifecycle_running(listen_fds, num_listeners)) {
             sem_wait(&thread_limiter);
 
-            sockaddr_in client;
-            int client_fd = accept_client(listen_fd, client);
+            int ready = lifecycle_wait(listen_fds, num_listeners);
+            if (ready < 0) {
+                sem_post(&thread_limiter);
+                continue;
+            }
+
+            sockaddr_storage client;
+            int client_fd = accept_client(listen_fds[ready], client);
 
             if (client_fd < 0) {
                 sem_post(&thread_limiter);
                 continue;
             }
 
+            // Clients over their rate or connection limit never get a thread
+            RateLimitVerdict verdict = ratelimit_admit(client_fd, client);
+            if (verdict != RATELIMIT_ADMIT) {
+                ratelimit_reject(client_fd, verdict, https_client(client_fd));
+                sem_post(&thread_limiter);
+                continue;
+            }
+
             pthread_t thread_id;
             
             if (pthread_create(&thread_id, NULL, client_worker, (void*)(intptr_t)client_fd) != 0) {
                 perror("Thread creation failed");
+                ratelimit_release(client_fd);
                 close(client_fd);
                 sem_post(&thread_limiter);
             } else {
@@ -61,7 +114,11 @@ int main() {
             }
         }
 
+        // Drain: every slot comes back once its client thread has finished
+        for (int i = 0; i < num_listeners; i++) close(listen_fds[i]);
+        for (int i = 0; i < 5; i++) {
+            sem_wait(&thread_limiter);
+        }
         sem_destroy(&thread_limiter);
-        close(listen_fd);
         return 0;
     }
\ No newline at end of file
@@ -1,10 +1,20 @@
 #include "socket.h"
+#include "bundle.h"
 #include "http_parser.h"
+#include "lifecycle.h"
+#include "prefork.h"
+#include "proxy.h"
+#include "https.h"
+#include "ratelimit.h"
+#include "trace.h"
+#include "upload.h"
 #include "thread_pool.h"
 
 #include <arpa/inet.h>
 #include <iostream>
 #include <unistd.h>
+#include <csignal>
+#include <netinet/tcp.h>
 
 sem_t thread_limiter;
 
@@ -25,13 +35,57 @@ void client_worker(void* arg) {
     printf("[-] Client disconnected (FD: %d)\n", client_fd);
 }
 
-int main() { 
-    int port = 8080;
+// /__stats section: queue wait times per priority lane
+void write_pool_stats(std::ostream &out, void* ctx) {
+    pool_write_stats((ThreadPool*)ctx, out);
+}
+
+int main(int argc, char** argv) { 
+    // --trace N records spans of 1 in N requests, dumped on SIGUSR1 (before lifecycle_init)
+    trace_init(argc, argv);
+    // Graceful drain on SIGTERM, binary upgrade on SIGUSR2 (before any thread starts)
+    lifecycle_init(argv);
+    // A client hanging up mid-sendfile must not kill the whole server
+    signal(SIGPIPE, SIG_IGN);
+    // --https SPEC adds TLS listeners; the kernel encrypts responses where it can (kTLS)
+    if (https_init(argc, argv) < 0) return 1;
+    // --uploads DIR accepts PUT/POST into ./www/DIR, spliced straight to disk
+    if (upload_init(argc, argv) < 0) return 1;
+    // --bundle FILE serves the files packed by pack_www from one mapping
+    if (bundle_init(argc, argv) < 0) return 1;
+    // --proxy /prefix=SPEC forwards matching URIs to a local upstream
+    if (proxy_init(argc, argv) < 0) return 1;
+    // --rate-limit / --conn-limit (and --net-* for the /24 or /64) per client address
+    if (ratelimit_init(argc, argv)) http_register_stats("ratelimit", ratelimit_write_stats, NULL);
     // This is the Server Socket 
     // Asks the OS for a TCP (Transmission Control Protocol) socket boudn to port 8080
     // Puts it into "Listening Mode"
-    int listen_fd = create_listen_socket(port);
-    printf("Server listening on port %d...\n", port);
+    // After a SIGUSR2 upgrade the previous binary hands us its socket instead
+    // Extra --listen SPEC options add IPv6 and Unix domain socket listeners
+    int listen_fds[MAX_LISTENERS];
+    int num_listeners = lifecycle_inherited(listen_fds, MAX_LISTENERS);
+    if (num_listeners == 0) {
+        num_listeners = open_listeners(argc, argv, listen_fds, MAX_LISTENERS);
+    }
+    if (num_listeners < 0) {
+        std::cerr << "Failed to open socket\n";
+        return 1;
+    }
+
+    // Only wake the accept loop once the request has arrived, so it can be
+    // classified by size right away (no effect on Unix domain sockets)
+    for (int i = 0; i < num_listeners; i++) {
+        int defer_s = 1;
+        setsockopt(listen_fds[i], IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_s, sizeof(defer_s));
+    }
+
+    // --prefork N: N processes each run their own pool, a supervisor restarts them
+    int workers = prefork_workers(argc, argv);
+    if (workers > 0 && prefork_run(workers, listen_fds, num_listeners) < 0) return 0;
+
+    // Invalidate cached files on change instead of stat()ing them per request
+    http_watch_docroot();
+    printf("Server listening on %d socket(s)...\n", num_listeners);
 
     ThreadPool pool;
     int created = pool_init(&pool, 5);
@@ -39,21 +93,41 @@ int main() {
         fprintf(stderr, "Error allocating memory\n");
         return(-1);
     }
+    http_register_stats("pool", write_pool_stats, &pool);
 
-    // Accept look where clients are queued to threadpool
-    while (1) {
-        sockaddr_in client;
-        int client_fd = accept_client(listen_fd, client);
+    lifecycle_ready();
+
+    // Accept look where clients are queued to threadpool,
+    // left on SIGTERM or after handing off to a new binary
+    while (lifecycle_running(listen_fds, num_listeners)) {
+        int ready = lifecycle_wait(listen_fds, num_listeners);
+        if (ready < 0) continue;
+
+        sockaddr_storage client;
+        int client_fd = accept_client(listen_fds[ready], client);
 
         if (client_fd < 0) {
             continue;
         }
 
-        // Enqueue the client where the workers will handle it
-        pool_enqueue(&pool, client_fd);
+        // Clients over their rate or connection limit never take a queue slot
+        RateLimitVerdict verdict = ratelimit_admit(client_fd, client);
+        if (verdict != RATELIMIT_ADMIT) {
+            ratelimit_reject(client_fd, verdict, https_client(client_fd));
+            continue;
+        }
+
+        // Enqueue the client in the lane for its expected response size,
+        // so small pages are not stuck behind large downloads
+        pool_enqueue_lane(&pool, client_fd, pool_lane_for_cost(http_peek_cost(client_fd)));
     }
-    
+
+    // Stop accepting, then let the workers finish everything already queued
+    for (int i = 0; i < num_listeners; i++) close(listen_fds[i]);
+
+    std::ostringstream lanes;
+    pool_write_stats(&pool, lanes);
+    printf("Queue wait per lane: %s\n", lanes.str().c_str());
     pool_destroy(&pool);
-    close(listen_fd);
     return 0;
 }
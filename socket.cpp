@@ -1,4 +1,24 @@
 #include "socket.h"
+#include "trace.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <sys/un.h>
+
+namespace {
+
+// true if something still accepts connections on a filesystem Unix socket
+bool unix_socket_alive(const sockaddr_storage &addr, socklen_t len) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return true;
+    bool alive = connect(fd, (const sockaddr *)&addr, len) == 0 || errno != ECONNREFUSED;
+    close(fd);
+    return alive;
+}
+
+} // namespace
 
 int create_listen_socket(int port, int backlog) {
     // Creates a TCP socket for IPv4 Networking 
@@ -36,11 +56,154 @@ int create_listen_socket(int port, int backlog) {
 }
 
 int accept_client(int listen_fd, sockaddr_in &client_addr) {
+    uint64_t t = trace_clock();
+    socklen_t len = sizeof(client_addr);
+    int client_fd = accept(listen_fd, (sockaddr *)&client_addr, &len);
+    if (client_fd < 0) {
+        // another prefork worker took it first
+        if (errno != EAGAIN) std::perror("accept");
+        return -1;
+    }
+    trace_accept(client_fd, t);
+    return client_fd;
+}
+
+int resolve_socket_spec(const char* spec, sockaddr_storage* addr, socklen_t* len) {
+    memset(addr, 0, sizeof(*addr));
+
+    if (strncmp(spec, "unix:", 5) == 0) {
+        const char* path = spec + 5;
+        sockaddr_un* un = (sockaddr_un *)addr;
+        size_t n = strlen(path);
+        // leave room for the terminating NUL (or, for abstract names, the leading one)
+        if (n == 0 || n >= sizeof(un->sun_path)) return -1;
+
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path, n);
+        if (path[0] == '@') {
+            // abstract namespace: leading NUL, name is not NUL-terminated
+            un->sun_path[0] = '\0';
+            *len = offsetof(sockaddr_un, sun_path) + n;
+        } else {
+            *len = offsetof(sockaddr_un, sun_path) + n + 1;
+        }
+        return 0;
+    }
+
+    // split "host:port"; a bare port means every IPv4 interface
+    std::string host;
+    const char* port_str = spec;
+    if (spec[0] == '[') {
+        const char* end = strchr(spec, ']');
+        if (!end || end[1] != ':') return -1;
+        host.assign(spec + 1, end - spec - 1);
+        port_str = end + 2;
+    } else if (const char* colon = strrchr(spec, ':')) {
+        host.assign(spec, colon - spec);
+        port_str = colon + 1;
+    }
+
+    char* rest;
+    long port = strtol(port_str, &rest, 10);
+    if (*port_str == '\0' || *rest != '\0' || port < 0 || port > 65535) return -1;
+
+    if (spec[0] == '[') {
+        sockaddr_in6* in6 = (sockaddr_in6 *)addr;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port   = htons(port);
+        if (inet_pton(AF_INET6, host.c_str(), &in6->sin6_addr) != 1) return -1;
+        *len = sizeof(*in6);
+    } else {
+        sockaddr_in* in = (sockaddr_in *)addr;
+        in->sin_family      = AF_INET;
+        in->sin_port        = htons(port);
+        in->sin_addr.s_addr = INADDR_ANY;
+        if (!host.empty() && inet_pton(AF_INET, host.c_str(), &in->sin_addr) != 1) return -1;
+        *len = sizeof(*in);
+    }
+    return 0;
+}
+
+int create_listener(const char* spec, int backlog) {
+    sockaddr_storage addr;
+    socklen_t len;
+    if (resolve_socket_spec(spec, &addr, &len) < 0) {
+        std::cerr << "bad listen address: " << spec << std::endl;
+        return -1;
+    }
+
+    int listen_fd = ::socket(addr.ss_family, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::perror("socket");
+        return -1;
+    }
+
+    int opt = 1;
+    if (addr.ss_family != AF_UNIX) {
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    }
+    if (addr.ss_family == AF_INET6) {
+        // leave the IPv4 side of the port to an IPv4 listener
+        setsockopt(listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt));
+    }
+
+    int rc = bind(listen_fd, (sockaddr *)&addr, len);
+    const sockaddr_un* un = (const sockaddr_un *)&addr;
+    if (rc < 0 && errno == EADDRINUSE && addr.ss_family == AF_UNIX && un->sun_path[0] != '\0'
+        && !unix_socket_alive(addr, len)) {
+        // stale socket file from a server that did not shut down cleanly
+        unlink(un->sun_path);
+        rc = bind(listen_fd, (sockaddr *)&addr, len);
+    }
+    if (rc < 0) {
+        std::perror("bind");
+        close(listen_fd);
+        return -1;
+    }
+
+    if (listen(listen_fd, backlog) < 0) {
+        std::perror("listen");
+        close(listen_fd);
+        return -1;
+    }
+
+    std::cout << "[+] Listening on " << spec << std::endl;
+    return listen_fd;
+}
+
+int open_listeners(int argc, char** argv, int* fds, int max, int backlog) {
+    int n = 0;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--listen") != 0 && strcmp(argv[i], "--https") != 0) continue;
+        if (n == max) {
+            std::cerr << "too many listeners (max " << max << ")" << std::endl;
+            break;
+        }
+        fds[n] = create_listener(argv[++i], backlog);
+        if (fds[n] < 0) {
+            while (n > 0) close(fds[--n]);
+            return -1;
+        }
+        n++;
+    }
+
+    if (n == 0) {
+        fds[0] = create_listen_socket(8080, backlog);
+        if (fds[0] < 0) return -1;
+        n = 1;
+    }
+    return n;
+}
+
+int accept_client(int listen_fd, sockaddr_storage &client_addr) {
+    uint64_t t = trace_clock();
     socklen_t len = sizeof(client_addr);
     int client_fd = accept(listen_fd, (sockaddr *)&client_addr, &len);
     if (client_fd < 0) {
-        std::perror("accept");
+        // another prefork worker took it first
+        if (errno != EAGAIN) std::perror("accept");
         return -1;
     }
+    trace_accept(client_fd, t);
     return client_fd;
-}
\ No newline at end of file
+}
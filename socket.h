@@ -1,6 +1,7 @@
 #pragma once
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
 #include <cstring>
 #include <unistd.h>
 #include <iostream>
@@ -19,6 +20,48 @@
  */
 int create_listen_socket(int port, int backlog = 10);
 
+/**
+ * @brief Resolves a listener spec into a socket address.
+ *
+ * Accepted forms:
+ *   8080 or :8080          IPv4, all interfaces
+ *   127.0.0.1:8080         IPv4, one address
+ *   [::]:8080, [::1]:8080  IPv6 (IPv6 only, so it can share a port with IPv4)
+ *   unix:/run/www.sock     Unix domain socket in the filesystem
+ *   unix:@www              Unix domain socket in the abstract namespace
+ *
+ * @param spec Listener spec as above.
+ * @param addr Receives the address.
+ * @param len  Receives the length of the address.
+ * @return 0 if successful, -1 if the spec is malformed
+ */
+int resolve_socket_spec(const char* spec, sockaddr_storage* addr, socklen_t* len);
+
+/**
+ * @brief Creates a listening socket for any spec resolve_socket_spec() accepts.
+ * A filesystem Unix socket left behind by a dead server is removed and
+ * bound again; one that still accepts connections is left alone.
+ *
+ * @param spec    Listener spec.
+ * @param backlog The maximum length of the queue connections
+ * @return The file descriptor of the listening socket, or -1 on error.
+ */
+int create_listener(const char* spec, int backlog = 10);
+
+/**
+ * @brief Opens one listener per --listen SPEC or --https SPEC option in argv.
+ * Other arguments are ignored so servers can mix in options of their own.
+ * Without any such option the server listens on IPv4 port 8080.
+ *
+ * @param argc    main()'s argc.
+ * @param argv    main()'s argv.
+ * @param fds     Array receiving the listening sockets.
+ * @param max     Capacity of fds.
+ * @param backlog The maximum length of the queue connections
+ * @return Number of sockets opened, or -1 if any of them failed
+ */
+int open_listeners(int argc, char** argv, int* fds, int max, int backlog = 10);
+
 /**
  * @brief Accepts a new incoming client connection.
  *
@@ -29,4 +72,13 @@ int create_listen_socket(int port, int backlog = 10);
  * @param client_addr Reference to a sockaddr_in struct to store the client's address details.
  * @return The file descriptor for the connected client, or -1 on error.
  */
-int accept_client(int listen_fd, sockaddr_in &client_addr);
\ No newline at end of file
+int accept_client(int listen_fd, sockaddr_in &client_addr);
+
+/**
+ * @brief Accepts a new client on a listener of any address family.
+ *
+ * @param listen_fd The listening socket file descriptor.
+ * @param client_addr Receives the client's address (IPv4, IPv6 or AF_UNIX).
+ * @return The file descriptor for the connected client, or -1 on error.
+ */
+int accept_client(int listen_fd, sockaddr_storage &client_addr);
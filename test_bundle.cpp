@@ -0,0 +1,205 @@
+/**
+ * @file test_bundle.cpp
+ * @brief Test driver for bundle.cpp
+ *
+ * Packs a small docroot under /tmp, maps it and serves requests through
+ * handle_client() on one end of a socketpair.
+ *  Type make test_bundle to compile; run from the repository root (needs www/)
+ */
+
+#include "bundle.h"
+#include "http_parser.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+const char* ROOT = "/tmp/test_bundle_www";
+const char* BUNDLE = "/tmp/test_bundle.bundle";
+const char* BROKEN = "/tmp/test_bundle_broken.bundle";
+
+std::string index_html;
+std::string big_bin;
+
+void write_file(const std::string &path, const std::string &data) {
+    std::ofstream f(path, std::ios::binary);
+    f << data;
+}
+
+std::string read_file(const std::string &path) {
+    std::ifstream f(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+void* serve(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    handle_client(fd);
+    close(fd);
+    return NULL;
+}
+
+// sends one request, returns everything the server wrote
+std::string exchange(const std::string &request) {
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    pthread_t server;
+    pthread_create(&server, NULL, serve, (void*)(intptr_t)sv[1]);
+    send(sv[0], request.data(), request.size(), MSG_NOSIGNAL);
+
+    std::string response;
+    char buf[16384];
+    ssize_t n;
+    while ((n = recv(sv[0], buf, sizeof(buf), 0)) > 0) response.append(buf, n);
+    close(sv[0]);
+    pthread_join(server, NULL);
+    return response;
+}
+
+std::string body_of(const std::string &response) {
+    size_t at = response.find("\r\n\r\n");
+    return at == std::string::npos ? "" : response.substr(at + 4);
+}
+
+std::string gunzip(const std::string &in) {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    inflateInit2(&z, 15 + 16);
+    std::string out(1 << 20, '\0');
+    z.next_in = (Bytef*)in.data();
+    z.avail_in = in.size();
+    z.next_out = (Bytef*)&out[0];
+    z.avail_out = out.size();
+    int rc = inflate(&z, Z_FINISH);
+    out.resize(z.total_out);
+    inflateEnd(&z);
+    return rc == Z_STREAM_END ? out : "";
+}
+
+// TEST 1: the packer indexes every regular file, aligns bodies and compresses text
+bool test_pack() {
+    std::cout << "\n=== Test 1: Pack And Index ===\n";
+    int files = bundle_pack(ROOT, BUNDLE);
+    bool opened = bundle_open(BUNDLE) == 0;
+
+    const BundleIndexEntry* index = bundle_lookup("./www/index.html");
+    const BundleIndexEntry* js = bundle_lookup("./www/sub/app.js");
+    const BundleIndexEntry* big = bundle_lookup("./www/big.bin");
+    const BundleIndexEntry* empty = bundle_lookup("./www/empty.txt");
+    bool absent = !bundle_lookup("./www/.hidden") && !bundle_lookup("./www/sub") && !bundle_lookup("./www/nope");
+
+    bool bodies = index && big && empty && js &&
+                  std::string(bundle_data(index->identity.body_offset), index->identity.body_len) == index_html &&
+                  std::string(bundle_data(big->identity.body_offset), big->identity.body_len) == big_bin &&
+                  empty->identity.body_len == 0 && big->identity.body_offset % BUNDLE_ALIGN == 0;
+    bool variants = index && big && index->gzip.head_len > 0 && index->gzip.body_len < index_html.size() &&
+                    big->gzip.head_len == 0 && strcmp(bundle_data(index->mime_offset), "text/html; charset=utf-8") == 0;
+
+    bool passed = files == 4 && opened && bodies && variants && absent;
+    std::cout << "[Result] " << files << " files packed\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "4 files indexed, bodies page-aligned, gzip only for text\n";
+    return passed;
+}
+
+// TEST 2: requests are answered from the mapping, gzip when the client asks for it
+bool test_serve() {
+    std::cout << "\n=== Test 2: Serving From The Bundle ===\n";
+    std::string plain = exchange("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    std::string zipped = exchange("GET / HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: br, gzip\r\n\r\n");
+    std::string big = exchange("GET /big.bin HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+    std::string empty = exchange("GET /empty.txt HTTP/1.1\r\n\r\n");
+
+    bool identity = plain.find("Vary: Accept-Encoding\r\n") != std::string::npos &&
+                    plain.find("Content-Encoding") == std::string::npos && body_of(plain) == index_html;
+    bool gzip = zipped.find("Content-Encoding: gzip\r\n") != std::string::npos && gunzip(body_of(zipped)) == index_html;
+    bool large = big.find("Content-Type: application/octet-stream\r\n") != std::string::npos &&
+                 big.find("Content-Encoding") == std::string::npos && body_of(big) == big_bin;
+    bool zero = empty.find("Content-Length: 0\r\n") != std::string::npos && body_of(empty).empty();
+
+    bool passed = identity && gzip && large && zero;
+    std::cout << "[Result] gzip body " << body_of(zipped).size() << " of " << index_html.size() << " bytes\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "identity, gzip, 200 KB sendfile body and empty file\n";
+    return passed;
+}
+
+// TEST 3: paths missing from the bundle still come from ./www
+bool test_fallthrough() {
+    std::cout << "\n=== Test 3: Files Outside The Bundle ===\n";
+    std::string disk = exchange("GET /johnpork.jpeg HTTP/1.1\r\n\r\n");
+    std::string missing = exchange("GET /not-there.html HTTP/1.1\r\n\r\n");
+
+    bool passed = disk.compare(0, 15, "HTTP/1.0 200 OK") == 0 && body_of(disk) == read_file("./www/johnpork.jpeg") &&
+                  missing.compare(0, 12, "HTTP/1.0 404") == 0;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "200 from disk, 404 for a file nowhere\n";
+    return passed;
+}
+
+// TEST 4: damaged bundles are refused and the mapped one stays in use
+bool test_malformed() {
+    std::cout << "\n=== Test 4: Malformed Bundles ===\n";
+    std::string good = read_file(BUNDLE);
+    int refused = 0;
+
+    std::string broken[4] = { good.substr(0, good.size() - 1), good, good, good };
+    broken[1][0] = 'X';                                          // magic
+    BundleIndexEntry* e = (BundleIndexEntry*)&broken[2][sizeof(BundleHeader)];
+    e->identity.body_len = good.size();                          // body past the end
+    e = (BundleIndexEntry*)&broken[3][sizeof(BundleHeader)];
+    std::swap(e[0], e[1]);                                       // index out of order
+    for (const std::string &b : broken) {
+        write_file(BROKEN, b);
+        if (bundle_open(BROKEN) < 0 && errno == EINVAL) refused++;
+    }
+    write_file(BROKEN, "");
+    if (bundle_open(BROKEN) < 0) refused++;
+    unlink(BROKEN);
+
+    bool still_mapped = bundle_lookup("./www/index.html") != NULL;
+    bool passed = refused == 5 && still_mapped;
+    std::cout << "[Result] " << refused << " of 5 refused\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "truncated, bad magic, bad offset, unsorted and empty files refused\n";
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Starting Bundle Tests ===\n";
+
+    int passed = 0;
+    int total = 4;
+
+    for (int i = 0; i < 100; i++) index_html += "<p>line " + std::to_string(i) + " of the test page</p>\n";
+    for (int i = 0; i < 200 * 1000; i++) big_bin += (char)(i * 7 + i / 1000);
+    mkdir(ROOT, 0755);
+    mkdir((std::string(ROOT) + "/sub").c_str(), 0755);
+    write_file(std::string(ROOT) + "/index.html", index_html);
+    write_file(std::string(ROOT) + "/sub/app.js", "console.log('bundled');\n");
+    write_file(std::string(ROOT) + "/big.bin", big_bin);
+    write_file(std::string(ROOT) + "/empty.txt", "");
+    write_file(std::string(ROOT) + "/.hidden", "temporary");
+
+    if (test_pack())        passed++;
+    if (test_serve())       passed++;
+    if (test_fallthrough()) passed++;
+    if (test_malformed())   passed++;
+
+    for (const char* f : { "/index.html", "/sub/app.js", "/big.bin", "/empty.txt", "/.hidden" }) {
+        unlink((std::string(ROOT) + f).c_str());
+    }
+    rmdir((std::string(ROOT) + "/sub").c_str());
+    rmdir(ROOT);
+    unlink(BUNDLE);
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+
+    if (passed == total) {
+        std::cout << "[SUCCESS] All tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "[FAILURE] Some tests failed.\n";
+        return 1;
+    }
+}
@@ -0,0 +1,118 @@
+/**
+ * @file test_docroot_watch.cpp
+ * @brief Test driver for docroot_watch.cpp
+ *
+ * Watches a scratch directory in /tmp and checks that file and directory
+ * changes reach the subscriber callback.
+ * Type make test_docroot_watch to compile
+ */
+
+#include "docroot_watch.h"
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+#include <sys/stat.h>
+
+const std::string ROOT = "/tmp/docroot_watch_test";
+
+// paths reported by the watcher thread
+std::mutex seen_lock;
+std::set<std::string> seen_files;
+std::set<std::string> seen_dirs;
+
+void on_change(const std::string &path, bool is_dir, void*) {
+    std::lock_guard<std::mutex> guard(seen_lock);
+    if (is_dir) seen_dirs.insert(path); else seen_files.insert(path);
+}
+
+// polls for up to one second for the watcher to report a path
+bool wait_for(const std::set<std::string> &set, const std::string &path) {
+    for (int i = 0; i < 100; i++) {
+        {
+            std::lock_guard<std::mutex> guard(seen_lock);
+            if (set.count(path)) return true;
+        }
+        usleep(10000);
+    }
+    return false;
+}
+
+// TEST 1: creating and modifying a file is reported
+bool test_file_events() {
+    std::cout << "\n=== Test 1: File Create/Modify ===\n";
+
+    std::string path = ROOT + "/index.html";
+    { std::ofstream f(path); f << "v1"; }
+
+    bool passed = wait_for(seen_files, path);
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "change to " << path << " reported\n";
+    return passed;
+}
+
+// TEST 2: a file in a directory created after startup is still seen
+bool test_new_subdirectory() {
+    std::cout << "\n=== Test 2: New Subdirectory ===\n";
+
+    std::string dir = ROOT + "/assets";
+    mkdir(dir.c_str(), 0755);
+    bool dir_seen = wait_for(seen_dirs, dir);
+
+    std::string path = dir + "/app.css";
+    { std::ofstream f(path); f << "body{}"; }
+    bool file_seen = wait_for(seen_files, path);
+
+    bool passed = dir_seen && file_seen;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "file inside new directory reported\n";
+    return passed;
+}
+
+// TEST 3: deleting a file is reported
+bool test_delete_event() {
+    std::cout << "\n=== Test 3: File Delete ===\n";
+
+    std::string path = ROOT + "/assets/app.css";
+    {
+        std::lock_guard<std::mutex> guard(seen_lock);
+        seen_files.clear();
+    }
+    unlink(path.c_str());
+
+    bool passed = wait_for(seen_files, path);
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "delete of " << path << " reported\n";
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Starting Docroot Watch Tests ===\n";
+
+    mkdir(ROOT.c_str(), 0755);
+    docroot_watch_subscribe(on_change, NULL);
+    if (docroot_watch_start(ROOT.c_str()) < 0) {
+        std::cerr << "[FAIL] Could not start watcher (inotify unavailable?)\n";
+        return 1;
+    }
+
+    int passed = 0;
+    int total = 3;
+
+    if (test_file_events())      passed++;
+    if (test_new_subdirectory()) passed++;
+    if (test_delete_event())     passed++;
+
+    docroot_watch_stop();
+    unlink((ROOT + "/index.html").c_str());
+    rmdir((ROOT + "/assets").c_str());
+    rmdir(ROOT.c_str());
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+
+    if (passed == total) {
+        std::cout << "[SUCCESS] All tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "[FAILURE] Some tests failed.\n";
+        return 1;
+    }
+}
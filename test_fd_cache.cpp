@@ -0,0 +1,201 @@
+/**
+ * @file test_fd_cache.cpp
+ * @brief Test driver for fd_cache.cpp
+ *
+ * Works on scratch files in /tmp so it does not depend on www/.
+ * Type make test_fd_cache to compile
+ */
+
+#include "fd_cache.h"
+#include <iostream>
+#include <fstream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+const char* TMP_FILE = "/tmp/fd_cache_test.txt";
+
+void write_file(const char* path, const std::string &data) {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f << data;
+}
+
+// TEST 1: second lookup of the same path is a hit on the same descriptor
+bool test_hit_reuses_fd() {
+    std::cout << "\n=== Test 1: Hit Reuses FD ===\n";
+    write_file(TMP_FILE, "hello");
+
+    FdCache cache;
+    fd_cache_init(&cache, 8, 60000);
+
+    FdCacheEntry* a = fd_cache_acquire(&cache, TMP_FILE);
+    FdCacheEntry* b = fd_cache_acquire(&cache, TMP_FILE);
+
+    bool passed = a == b && a->fd >= 0 && a->st.st_size == 5 &&
+                  cache.misses == 1 && cache.hits == 1;
+
+    fd_cache_release(&cache, a);
+    fd_cache_release(&cache, b);
+    fd_cache_destroy(&cache);
+
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "misses=1 hits=1 on one fd\n";
+    return passed;
+}
+
+// TEST 2: missing files are cached as negative entries
+bool test_negative_entry() {
+    std::cout << "\n=== Test 2: Negative Entry ===\n";
+
+    FdCache cache;
+    fd_cache_init(&cache, 8, 60000);
+
+    FdCacheEntry* a = fd_cache_acquire(&cache, "/tmp/fd_cache_does_not_exist");
+    fd_cache_release(&cache, a);
+    FdCacheEntry* b = fd_cache_acquire(&cache, "/tmp/fd_cache_does_not_exist");
+
+    bool passed = b->fd < 0 && cache.negative_hits == 1 && cache.misses == 1;
+
+    fd_cache_release(&cache, b);
+    fd_cache_destroy(&cache);
+
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "404 lookup served from cache\n";
+    return passed;
+}
+
+// TEST 3: the cache never holds more than capacity entries
+bool test_bounded_size() {
+    std::cout << "\n=== Test 3: Bounded Size ===\n";
+
+    FdCache cache;
+    fd_cache_init(&cache, 4, 60000);
+
+    for (int i = 0; i < 10; i++) {
+        std::string path = "/tmp/fd_cache_missing_" + std::to_string(i);
+        fd_cache_release(&cache, fd_cache_acquire(&cache, path));
+    }
+
+    size_t size = cache.map.size();
+    bool passed = size == 4 && cache.evictions == 6;
+
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "size=" << size
+              << " evictions=" << cache.evictions << "\n";
+    fd_cache_destroy(&cache);
+    return passed;
+}
+
+// TEST 4: a changed file is picked up once the TTL expires
+bool test_ttl_revalidation() {
+    std::cout << "\n=== Test 4: TTL Revalidation ===\n";
+    write_file(TMP_FILE, "hello");
+
+    FdCache cache;
+    fd_cache_init(&cache, 8, 50);
+
+    FdCacheEntry* a = fd_cache_acquire(&cache, TMP_FILE);
+    off_t old_size = a->st.st_size;
+    fd_cache_release(&cache, a);
+
+    // replace the file (new inode) and wait out the TTL
+    unlink(TMP_FILE);
+    write_file(TMP_FILE, "hello, world");
+    usleep(100000);
+
+    FdCacheEntry* b = fd_cache_acquire(&cache, TMP_FILE);
+    bool passed = old_size == 5 && b->st.st_size == 12;
+    fd_cache_release(&cache, b);
+    fd_cache_destroy(&cache);
+
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "new size seen after TTL\n";
+    return passed;
+}
+
+// TEST 5: invalidating an entry in use does not close the caller's fd
+bool test_invalidate_while_held() {
+    std::cout << "\n=== Test 5: Invalidate While Held ===\n";
+    write_file(TMP_FILE, "hello");
+
+    FdCache cache;
+    fd_cache_init(&cache, 8, 60000);
+
+    FdCacheEntry* a = fd_cache_acquire(&cache, TMP_FILE);
+    fd_cache_invalidate(&cache, TMP_FILE);
+
+    // the descriptor must still be readable until we release it
+    char c = 0;
+    bool passed = pread(a->fd, &c, 1, 0) == 1 && c == 'h' && cache.map.empty();
+
+    fd_cache_release(&cache, a);
+    fd_cache_destroy(&cache);
+
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "fd survives invalidation\n";
+    return passed;
+}
+
+struct RaceArgs {
+    FdCache* cache;
+    FdCacheEntry* entry;
+};
+
+void* acquire_fifo(void* arg) {
+    RaceArgs* a = (RaceArgs*)arg;
+    a->entry = fd_cache_acquire(a->cache, "/tmp/fd_cache_test.fifo");
+    return NULL;
+}
+
+// TEST 6: an invalidation that lands while a miss is opening the path keeps the result out of the cache
+bool test_invalidate_during_open() {
+    std::cout << "\n=== Test 6: Invalidate During Open ===\n";
+    const char* fifo = "/tmp/fd_cache_test.fifo";
+    unlink(fifo);
+    mkfifo(fifo, 0600);
+
+    FdCache cache;
+    fd_cache_init(&cache, 8, 60000);
+
+    // open() of a FIFO blocks until a writer shows up, which holds the miss mid-open
+    RaceArgs args = { &cache, NULL };
+    pthread_t t;
+    pthread_create(&t, NULL, acquire_fifo, &args);
+    usleep(100000);
+    fd_cache_invalidate(&cache, fifo);
+    int writer;
+    while ((writer = open(fifo, O_WRONLY | O_NONBLOCK)) < 0) usleep(1000);
+    pthread_join(t, NULL);
+    close(writer);
+
+    // not a regular file: served as missing, but not remembered as missing
+    bool passed = args.entry && args.entry->fd < 0 && cache.map.empty();
+    fd_cache_release(&cache, args.entry);
+    fd_cache_destroy(&cache);
+    unlink(fifo);
+
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "stale result not cached\n";
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Starting FD Cache Tests ===\n";
+
+    int passed = 0;
+    int total = 6;
+
+    if (test_hit_reuses_fd())         passed++;
+    if (test_negative_entry())        passed++;
+    if (test_bounded_size())          passed++;
+    if (test_ttl_revalidation())      passed++;
+    if (test_invalidate_while_held()) passed++;
+    if (test_invalidate_during_open()) passed++;
+
+    unlink(TMP_FILE);
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+
+    if (passed == total) {
+        std::cout << "[SUCCESS] All tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "[FAILURE] Some tests failed.\n";
+        return 1;
+    }
+}
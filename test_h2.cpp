@@ -0,0 +1,495 @@
+/**
+ * @file test_h2.cpp
+ * @brief Test driver for hpack.cpp and h2.cpp
+ *
+ * The HPACK tests replay the examples of RFC 7541 Appendix C. The HTTP/2
+ * tests run handle_client() in a forked child on one end of a socketpair
+ * and speak raw frames to it from the other end, the same way
+ * test_parser.cpp drives HTTP/1.0.
+ *  Type make test_h2 to compile; run from the repository root (needs www/)
+ */
+
+#include "h2.h"
+#include "hpack.h"
+#include "http_parser.h"
+#include "proxy.h"
+#include "upload.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+std::string unhex(const char* hex) {
+    std::string out;
+    for (const char* p = hex; p[0] && p[1]; ) {
+        if (*p == ' ') { p++; continue; }
+        out += (char)std::stoi(std::string(p, 2), nullptr, 16);
+        p += 2;
+    }
+    return out;
+}
+
+bool decode_block(HpackTable* table, const char* hex, std::vector<HeaderField> &headers) {
+    std::string block = unhex(hex);
+    headers.clear();
+    return hpack_decode(table, (const uint8_t*)block.data(), block.size(), headers) == 0;
+}
+
+bool same_headers(const std::vector<HeaderField> &got, const std::vector<HeaderField> &want) {
+    if (got == want) return true;
+    for (const HeaderField &f : got) std::cerr << "    got " << f.first << ": " << f.second << "\n";
+    return false;
+}
+
+// the three requests of RFC 7541 C.3 (plain) or C.4 (Huffman), sharing one dynamic table
+bool rfc_requests(const char* blocks[3]) {
+    HpackTable table;
+    hpack_table_init(&table);
+    std::vector<HeaderField> h;
+
+    std::vector<HeaderField> first = {
+        {":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}};
+    if (!decode_block(&table, blocks[0], h) || !same_headers(h, first) || table.size != 57) return false;
+
+    std::vector<HeaderField> second = first;
+    second.push_back({"cache-control", "no-cache"});
+    if (!decode_block(&table, blocks[1], h) || !same_headers(h, second) || table.size != 110) return false;
+
+    std::vector<HeaderField> third = {
+        {":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"},
+        {":authority", "www.example.com"}, {"custom-key", "custom-value"}};
+    if (!decode_block(&table, blocks[2], h) || !same_headers(h, third) || table.size != 164) return false;
+
+    return table.entries.size() == 3 && table.entries[0].first == "custom-key";
+}
+
+bool test_hpack_rfc_examples() {
+    std::cout << "\n=== Test 1: HPACK RFC 7541 examples ===\n";
+
+    const char* plain[3] = {
+        "828684410f7777772e6578616d706c652e636f6d",
+        "828684be58086e6f2d6361636865",
+        "828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565",
+    };
+    const char* huffman[3] = {
+        "828684418cf1e3c2e5f23a6ba0ab90f4ff",
+        "828684be5886a8eb10649cbf",
+        "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf",
+    };
+
+    if (!rfc_requests(plain)) {
+        std::cerr << "[FAIL] C.3 requests without Huffman coding\n";
+        return false;
+    }
+    if (!rfc_requests(huffman)) {
+        std::cerr << "[FAIL] C.4 requests with Huffman coding\n";
+        return false;
+    }
+
+    std::string encoded;
+    huffman_encode("www.example.com", encoded);
+    if (encoded != unhex("f1e3c2e5f23a6ba0ab90f4ff")) {
+        std::cerr << "[FAIL] Huffman encoding differs from C.4.1\n";
+        return false;
+    }
+
+    std::cout << "[PASS] C.3 and C.4 decode with the expected dynamic table\n";
+    return true;
+}
+
+bool test_hpack_round_trip() {
+    std::cout << "\n=== Test 2: HPACK encoder round trip ===\n";
+
+    HpackTable enc, dec;
+    hpack_table_init(&enc);
+    hpack_table_init(&dec);
+    std::vector<HeaderField> fields = {
+        {":status", "200"}, {"content-type", "text/html; charset=utf-8"},
+        {"content-length", "322"}, {"cache-control", "no-cache"}};
+
+    std::string first, second;
+    hpack_encode(&enc, fields, first);
+    fields[2].second = "238097";
+    hpack_encode(&enc, fields, second);
+
+    std::vector<HeaderField> h;
+    if (hpack_decode(&dec, (const uint8_t*)first.data(), first.size(), h) != 0) return false;
+    h.clear();
+    if (hpack_decode(&dec, (const uint8_t*)second.data(), second.size(), h) != 0 || h != fields) {
+        std::cerr << "[FAIL] Decoded headers differ from the encoded ones\n";
+        return false;
+    }
+    // repeated fields collapse to one-byte indexes, only content-length stays literal
+    if (second.size() >= first.size() / 2) {
+        std::cerr << "[FAIL] Second block not compressed (" << second.size() << " vs " << first.size() << ")\n";
+        return false;
+    }
+
+    // the peer shrinks its table to 0: the next block must start with a size update
+    hpack_set_limit(&enc, 0);
+    std::string third;
+    hpack_encode(&enc, fields, third);
+    h.clear();
+    if (hpack_decode(&dec, (const uint8_t*)third.data(), third.size(), h) != 0 || h != fields
+        || dec.max_size != 0 || !dec.entries.empty()) {
+        std::cerr << "[FAIL] Table size update not honoured\n";
+        return false;
+    }
+
+    // a truncated block and an index past the tables are compression errors
+    h.clear();
+    std::string bad_index = "\xff\x7f";
+    if (hpack_decode(&dec, (const uint8_t*)second.data(), 3, h) == 0
+        || hpack_decode(&dec, (const uint8_t*)bad_index.data(), bad_index.size(), h) == 0) {
+        std::cerr << "[FAIL] Malformed block accepted\n";
+        return false;
+    }
+
+    std::cout << "[PASS] " << first.size() << " then " << second.size() << " byte header blocks round-trip\n";
+    return true;
+}
+
+// ------------------------------------------------------------- raw client
+
+struct Frame {
+    uint8_t type;
+    uint8_t flags;
+    uint32_t stream;
+    std::string payload;
+};
+
+bool recv_exact(int fd, char* buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = recv(fd, buf + got, len - got, 0);
+        if (n <= 0) return false;
+        got += n;
+    }
+    return true;
+}
+
+bool read_frame(int fd, Frame &f) {
+    unsigned char h[9];
+    if (!recv_exact(fd, (char*)h, 9)) return false;
+    uint32_t len = (h[0] << 16) | (h[1] << 8) | h[2];
+    f.type = h[3];
+    f.flags = h[4];
+    f.stream = ((h[5] & 0x7f) << 24) | (h[6] << 16) | (h[7] << 8) | h[8];
+    f.payload.resize(len);
+    return len == 0 || recv_exact(fd, &f.payload[0], len);
+}
+
+void send_frame(int fd, uint8_t type, uint8_t flags, uint32_t stream, const std::string &payload) {
+    std::string f;
+    f += (char)(payload.size() >> 16);
+    f += (char)(payload.size() >> 8);
+    f += (char)payload.size();
+    f += (char)type;
+    f += (char)flags;
+    f += (char)(stream >> 24);
+    f += (char)(stream >> 16);
+    f += (char)(stream >> 8);
+    f += (char)stream;
+    f += payload;
+    send(fd, f.data(), f.size(), MSG_NOSIGNAL);
+}
+
+std::string u32(uint32_t v) {
+    std::string s;
+    s += (char)(v >> 24);
+    s += (char)(v >> 16);
+    s += (char)(v >> 8);
+    s += (char)v;
+    return s;
+}
+
+std::string setting(uint16_t id, uint32_t value) {
+    std::string s;
+    s += (char)(id >> 8);
+    s += (char)id;
+    return s + u32(value);
+}
+
+void send_get(int fd, HpackTable* enc, uint32_t stream, const std::string &path, const char* method = "GET") {
+    std::string block;
+    hpack_encode(enc, {{":method", method}, {":scheme", "http"}, {":path", path},
+                       {":authority", "localhost"}}, block);
+    send_frame(fd, 0x1, 0x4 | 0x1, stream, block);   // HEADERS, END_HEADERS | END_STREAM
+}
+
+off_t file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+/**
+ * Client side of a connection: reads frames until every stream in want
+ * has ended, granting window as DATA is consumed, and checks that no DATA
+ * frame ever exceeds the window the client granted.
+ */
+struct StreamResult {
+    uint32_t id;
+    off_t bytes;
+    int status;
+    bool done;
+};
+
+bool collect_responses(int fd, std::vector<StreamResult> &want, std::vector<uint32_t> &finish_order,
+                       int32_t stream_window) {
+    HpackTable dec;
+    hpack_table_init(&dec);
+    size_t open_streams = want.size();
+    std::vector<int64_t> windows(want.size(), stream_window);
+    int64_t conn_window = H2_DEFAULT_WINDOW;
+
+    while (open_streams > 0) {
+        Frame f;
+        if (!read_frame(fd, f)) {
+            std::cerr << "    connection closed early\n";
+            return false;
+        }
+        if (f.type == 0x4 && !(f.flags & 0x1)) send_frame(fd, 0x4, 0x1, 0, "");
+        if (f.type == 0x7) {
+            std::cerr << "    GOAWAY from server\n";
+            return false;
+        }
+        if (f.type != 0x0 && f.type != 0x1) continue;
+
+        size_t i = 0;
+        while (i < want.size() && want[i].id != f.stream) i++;
+        if (i == want.size() || want[i].done) {
+            std::cerr << "    frame for unexpected stream " << f.stream << "\n";
+            return false;
+        }
+
+        if (f.type == 0x1) {
+            std::vector<HeaderField> h;
+            if (hpack_decode(&dec, (const uint8_t*)f.payload.data(), f.payload.size(), h) != 0) return false;
+            for (const HeaderField &hf : h) {
+                if (hf.first == ":status") want[i].status = std::stoi(hf.second);
+            }
+        } else {
+            int64_t len = f.payload.size();
+            if (len > windows[i] || len > conn_window) {
+                std::cerr << "    DATA of " << len << " bytes overran the flow-control window\n";
+                return false;
+            }
+            want[i].bytes += len;
+            windows[i] -= len;
+            conn_window -= len;
+            // hand the consumed bytes straight back, like a reading browser
+            if (len > 0) {
+                send_frame(fd, 0x8, 0, 0, u32(len));
+                send_frame(fd, 0x8, 0, f.stream, u32(len));
+                windows[i] += len;
+                conn_window += len;
+            }
+        }
+
+        if (f.flags & 0x1) {
+            want[i].done = true;
+            finish_order.push_back(f.stream);
+            open_streams--;
+        }
+    }
+    return true;
+}
+
+// runs client(fd) against handle_client() in a child process
+bool with_server(bool (*client)(int fd)) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) return false;
+
+    // or the child would print our buffered output a second time
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(sv[0]);
+        handle_client(sv[1]);
+        close(sv[1]);
+        exit(0);
+    }
+
+    close(sv[1]);
+    bool ok = client(sv[0]);
+    close(sv[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool multiplexed_client(int fd) {
+    send(fd, H2_PREFACE, H2_PREFACE_LEN, MSG_NOSIGNAL);
+    // a small stream window forces the server to wait for WINDOW_UPDATEs
+    const int32_t WINDOW = 4096;
+    send_frame(fd, 0x4, 0, 0, setting(0x4, WINDOW));
+
+    HpackTable enc;
+    hpack_table_init(&enc);
+    send_get(fd, &enc, 1, "/johnpork.jpeg");
+    send_get(fd, &enc, 3, "/");
+    send_get(fd, &enc, 5, "/missing.html");
+
+    std::vector<StreamResult> want = {{1, 0, 0, false}, {3, 0, 0, false}, {5, 0, 0, false}};
+    std::vector<uint32_t> order;
+    if (!collect_responses(fd, want, order, WINDOW)) return false;
+
+    bool ok = want[0].status == 200 && want[0].bytes == file_size("www/johnpork.jpeg")
+           && want[1].status == 200 && want[1].bytes == file_size("www/index.html")
+           && want[2].status == 404;
+    if (!ok) {
+        std::cerr << "    statuses " << want[0].status << " " << want[1].status << " " << want[2].status
+                  << ", image bytes " << want[0].bytes << "\n";
+        return false;
+    }
+    // the page must not wait behind the image that was requested first
+    if (order.back() != 1) {
+        std::cerr << "    large stream did not finish last\n";
+        return false;
+    }
+
+    // graceful close: the server answers GOAWAY and hangs up
+    send_frame(fd, 0x7, 0, 0, u32(5) + u32(0));
+    Frame f;
+    while (read_frame(fd, f)) {}
+    return true;
+}
+
+bool test_h2_prior_knowledge() {
+    std::cout << "\n=== Test 3: h2c prior knowledge, three multiplexed streams ===\n";
+    if (!with_server(multiplexed_client)) {
+        std::cerr << "[FAIL] Multiplexed streams\n";
+        return false;
+    }
+    std::cout << "[PASS] Streams interleaved within the flow-control windows\n";
+    return true;
+}
+
+bool upgrade_client(int fd) {
+    const char* req =
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Connection: Upgrade, HTTP2-Settings\r\n"
+        "Upgrade: h2c\r\n"
+        "HTTP2-Settings: AAMAAABkAAQAAP__\r\n"   // MAX_CONCURRENT_STREAMS 100, INITIAL_WINDOW_SIZE 65535
+        "\r\n";
+    send(fd, req, strlen(req), MSG_NOSIGNAL);
+
+    const char* expect = "HTTP/1.1 101";
+    char head[12];
+    if (!recv_exact(fd, head, sizeof(head)) || memcmp(head, expect, sizeof(head)) != 0) return false;
+    // skip the rest of the 101 header block
+    std::string tail;
+    char c;
+    while (tail.size() < 4 || tail.compare(tail.size() - 4, 4, "\r\n\r\n") != 0) {
+        if (recv(fd, &c, 1, 0) != 1) return false;
+        tail += c;
+    }
+
+    send(fd, H2_PREFACE, H2_PREFACE_LEN, MSG_NOSIGNAL);
+    send_frame(fd, 0x4, 0, 0, "");
+
+    std::vector<StreamResult> want = {{1, 0, 0, false}};
+    std::vector<uint32_t> order;
+    return collect_responses(fd, want, order, H2_DEFAULT_WINDOW)
+        && want[0].status == 200 && want[0].bytes == file_size("www/index.html");
+}
+
+bool test_h2_upgrade() {
+    std::cout << "\n=== Test 4: h2c via Upgrade ===\n";
+    if (!with_server(upgrade_client)) {
+        std::cerr << "[FAIL] Upgraded request not answered on stream 1\n";
+        return false;
+    }
+    std::cout << "[PASS] 101 Switching Protocols, response on stream 1\n";
+    return true;
+}
+
+bool protocol_error_client(int fd) {
+    send(fd, H2_PREFACE, H2_PREFACE_LEN, MSG_NOSIGNAL);
+    send_frame(fd, 0x4, 0, 0, "");
+    // HEADERS on stream 0 is a connection error
+    send_frame(fd, 0x1, 0x5, 0, "\x82");
+
+    Frame f;
+    while (read_frame(fd, f)) {
+        if (f.type == 0x7) return f.payload.size() >= 8 && f.payload[7] == H2_PROTOCOL_ERROR;
+    }
+    return false;
+}
+
+bool test_h2_protocol_error() {
+    std::cout << "\n=== Test 5: Connection error ===\n";
+    if (!with_server(protocol_error_client)) {
+        std::cerr << "[FAIL] No GOAWAY(PROTOCOL_ERROR) for HEADERS on stream 0\n";
+        return false;
+    }
+    std::cout << "[PASS] GOAWAY(PROTOCOL_ERROR) and close\n";
+    return true;
+}
+
+bool plain_only_client(int fd) {
+    send(fd, H2_PREFACE, H2_PREFACE_LEN, MSG_NOSIGNAL);
+    send_frame(fd, 0x4, 0, 0, "");
+
+    HpackTable enc;
+    hpack_table_init(&enc);
+    send_get(fd, &enc, 1, "/api/users");
+    send_get(fd, &enc, 3, "/test_h2_uploads/a.txt", "PUT");
+    send_get(fd, &enc, 5, "/");
+
+    std::vector<StreamResult> want = {{1, 0, 0, false}, {3, 0, 0, false}, {5, 0, 0, false}};
+    std::vector<uint32_t> order;
+    if (!collect_responses(fd, want, order, H2_DEFAULT_WINDOW)) return false;
+    send_frame(fd, 0x7, 0, 0, u32(5) + u32(0));
+    Frame f;
+    while (read_frame(fd, f)) {}
+
+    if (want[0].status != 421 || want[1].status != 421 || want[2].status != 200) {
+        std::cerr << "    statuses " << want[0].status << " " << want[1].status << " " << want[2].status << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool test_h2_plain_only_paths() {
+    std::cout << "\n=== Test 6: Proxied and upload paths over h2c ===\n";
+    // nothing listens there: the request must not reach the proxy, nor ./www/api
+    proxy_add_route("/api/", "unix:@test_h2_no_upstream", 1);
+    upload_enable("test_h2_uploads", 1024);
+    bool ok = with_server(plain_only_client);
+    rmdir("./www/test_h2_uploads");
+    if (!ok) {
+        std::cerr << "[FAIL] Proxied or upload path not refused over HTTP/2\n";
+        return false;
+    }
+    std::cout << "[PASS] 421 for the proxied prefix and the upload, 200 for a static page\n";
+    return true;
+}
+
+} // namespace
+
+int main() {
+    std::cout << "=== Starting HTTP/2 Tests ===\n";
+
+    int passed = 0;
+    int total = 6;
+
+    if (test_hpack_rfc_examples()) passed++;
+    if (test_hpack_round_trip()) passed++;
+    if (test_h2_prior_knowledge()) passed++;
+    if (test_h2_upgrade()) passed++;
+    if (test_h2_protocol_error()) passed++;
+    if (test_h2_plain_only_paths()) passed++;
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+    return passed == total ? 0 : 1;
+}
@@ -12,11 +12,16 @@
  */
 
 #include "http_parser.h"
+#include "response_cache.h"
 #include <iostream>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <cstring>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <fstream>
+#include <new>
+#include <pthread.h>
 
 bool test_valid_get_request() {
     std::cout << "\n=== Test 1: Valid GET Request ===\n";
@@ -292,17 +297,151 @@ bool test_malformed_request() {
     }
 }
 
+// TEST 5: a forked server process counts into shared memory (as --prefork does)
+bool test_shared_counters() {
+    std::cout << "\n=== Test 5: Counters In Shared Memory ===\n";
+
+    void* mem = mmap(NULL, sizeof(HttpCounters), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return false;
+    HttpCounters* shared = new (mem) HttpCounters();
+    HttpCounters* previous = http_counters();
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        return false;
+    }
+
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        // CHILD PROCESS (SERVER) counts into the shared segment
+        close(sv[0]);
+        http_set_counters(shared);
+        handle_client(sv[1]);
+        close(sv[1]);
+        exit(0);
+    }
+
+    // PARENT PROCESS (CLIENT)
+    close(sv[1]);
+    const char* request = "GET /chickebutt.html HTTP/1.1\r\n\r\n";
+    send(sv[0], request, strlen(request), 0);
+    char buf[4096];
+    ssize_t n = recv(sv[0], buf, sizeof(buf), 0);
+    close(sv[0]);
+    int status;
+    wait(&status);
+
+    bool passed = n > 0 && shared->requests == 1 && shared->status_4xx == 1 &&
+                  shared->bytes_sent == (uint64_t)n && http_counters() == previous;
+    munmap(mem, sizeof(HttpCounters));
+
+    if (passed) {
+        std::cout << "[PASS] Child's 404 visible to the parent\n";
+    } else {
+        std::cout << "[FAIL] Shared counters not updated\n";
+    }
+    return passed;
+}
+
+// body of a response built in-process (small files are sent inline with the headers)
+std::string fetch(const char* uri) {
+    std::string req = std::string("GET ") + uri + " HTTP/1.1\r\n\r\n";
+    HttpResponse resp;
+    http_build_response(req.data(), req.size(), &resp);
+    std::string body = resp.status == 200 ? resp.head.substr(resp.header_len) : std::to_string(resp.status);
+    http_response_done(&resp);
+    return body;
+}
+
+// TEST 6: every spelling of a path shares one cache entry, so a rewrite reaches all of them
+bool test_path_spellings() {
+    std::cout << "\n=== Test 6: Non-Canonical URIs And Invalidation ===\n";
+    const char* file = "./www/test_parser_spelling.html";
+    const char* spellings[] = { "/test_parser_spelling.html", "/./test_parser_spelling.html",
+                                "//test_parser_spelling.html", "/x/../test_parser_spelling.html" };
+    std::ofstream(file) << "first version";
+    http_watch_docroot();
+
+    bool before = true;
+    for (const char* uri : spellings) before = fetch(uri) == "first version" && before;
+    std::ofstream(file) << "second version";
+    // the watcher thread invalidates the canonical path
+    usleep(200 * 1000);
+    bool after = true;
+    for (const char* uri : spellings) after = fetch(uri) == "second version" && after;
+    bool escape = fetch("/../Makefile") == "400" && fetch("/x/../../Makefile") == "400";
+    unlink(file);
+
+    bool passed = before && after && escape;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "rewrite seen through every spelling, .. above ./www refused\n";
+    return passed;
+}
+
+void* serve(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    handle_client(fd);
+    close(fd);
+    return NULL;
+}
+
+// TEST 7: cache hits sent from the entry itself, also when the socket takes only part of it
+bool test_pinned_hits() {
+    std::cout << "\n=== Test 7: Cache Hits Sent Without A Copy ===\n";
+    const char* file = "./www/test_parser_pinned.html";
+    std::string content(12 * 1024, 'p');
+    std::ofstream(file) << content;
+    std::string req = "GET /test_parser_pinned.html HTTP/1.1\r\n\r\n";
+
+    HttpResponse copied;
+    http_build_response(req.data(), req.size(), &copied); // miss: fills the cache
+    http_response_done(&copied);
+    http_build_response(req.data(), req.size(), &copied);
+    HttpResponse pinned;
+    http_build_response_pinned(req.data(), req.size(), &pinned);
+    bool pinned_hit = pinned.cached && pinned.head.empty() && copied.head.substr(copied.header_len) == content;
+    bool same = pinned_hit && pinned.cached->bytes == copied.head;
+    http_response_done(&pinned);
+    bool released = pinned.cached == NULL;
+
+    // a send buffer smaller than the response: the rest goes out as a copy
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    int small = 4096;
+    setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    pthread_t server;
+    pthread_create(&server, NULL, serve, (void*)(intptr_t)sv[1]);
+    send(sv[0], req.data(), req.size(), 0);
+    usleep(50 * 1000);
+    std::string response;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(sv[0], buf, sizeof(buf), 0)) > 0) response.append(buf, n);
+    close(sv[0]);
+    pthread_join(server, NULL);
+    unlink(file);
+
+    bool passed = same && released && response == copied.head;
+    http_response_done(&copied);
+    std::cout << "[Result] " << response.size() << " of " << copied.head.size() << " bytes received\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "pinned hit matches the copy, partial sends complete\n";
+    return passed;
+}
+
 int main() {
     std::cout << "=== Starting HTTP Parser Tests ===\n";
     std::cout << "Note: Tests expect www/ directory to exist for full validation\n";
     
     int passed = 0;
-    int total = 4;
+    int total = 7;
     
     if (test_valid_get_request()) passed++;
     if (test_invalid_method()) passed++;
     if (test_missing_file()) passed++;
     if (test_malformed_request()) passed++;
+    if (test_shared_counters()) passed++;
+    if (test_path_spellings()) passed++;
+    if (test_pinned_hits()) passed++;
     
     std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
     
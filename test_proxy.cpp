@@ -0,0 +1,298 @@
+/**
+ * @file test_proxy.cpp
+ * @brief Test driver for proxy.cpp
+ *
+ * A stub upstream listens on an abstract Unix socket and answers keep-alive
+ * HTTP/1.1 requests; handle_client() runs on one end of a socketpair while
+ * the main thread plays the client.
+ *  Type make test_proxy to compile
+ */
+
+#include "http_parser.h"
+#include "proxy.h"
+#include "socket.h"
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <pthread.h>
+#include <sys/socket.h>
+
+const char* UPSTREAM = "unix:@test_proxy_upstream";
+const char* NOBODY = "unix:@test_proxy_nobody";
+
+std::atomic<int> upstream_accepts(0);
+std::atomic<int> drops(0); // requests for /api/drop the stub received
+std::mutex seen_lock;
+std::string seen_head; // last request head the stub received
+
+// reads one request (head plus Content-Length body) from a keep-alive connection
+bool read_request(int fd, std::string &head, std::string &body) {
+    std::string buf;
+    char chunk[65536];
+    size_t end;
+    while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buf.append(chunk, n);
+    }
+    head = buf.substr(0, end + 4);
+    size_t length = atol(header_value(head.data(), head.size(), "Content-Length").c_str());
+    body = buf.substr(end + 4);
+    while (body.size() < length) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        body.append(chunk, n);
+    }
+    return true;
+}
+
+bool send_all(int fd, const std::string &data) {
+    return send(fd, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t)data.size();
+}
+
+void* upstream_conn(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    std::string head, body;
+    while (read_request(fd, head, body)) {
+        {
+            std::lock_guard<std::mutex> g(seen_lock);
+            seen_head = head;
+        }
+        std::string method, uri, version;
+        parse_request_line(head.data(), head.size(), method, uri, version);
+        std::string reply;
+        if (uri == "/api/echo") {
+            reply = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        } else if (uri == "/api/chunked") {
+            reply = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nKeep-Alive: timeout=5\r\n\r\n"
+                    "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\nX-Trailer: yes\r\n\r\n";
+        } else if (uri == "/api/eof") {
+            send_all(fd, "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\nuntil the end");
+            break;
+        } else if (uri == "/api/drop") {
+            // reads the request and hangs up without a response, as a crashing backend would
+            drops++;
+            break;
+        } else if (uri == "/api/split") {
+            // the response head in two segments, broken inside the blank line
+            send_all(fd, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r");
+            usleep(20 * 1000);
+            reply = "\nsplit";
+        } else if (uri == "/api/bye") {
+            // answers, then drops the idle connection as a restarting backend would
+            send_all(fd, "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\nbye");
+            usleep(50 * 1000);
+            break;
+        } else {
+            reply = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 5\r\nX-Upstream: stub\r\n"
+                    "Keep-Alive: timeout=5\r\n\r\nhello";
+        }
+        if (!send_all(fd, reply)) break;
+    }
+    close(fd);
+    return NULL;
+}
+
+void* upstream(void* arg) {
+    int listen_fd = (int)(intptr_t)arg;
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        upstream_accepts++;
+        pthread_t t;
+        pthread_create(&t, NULL, upstream_conn, (void*)(intptr_t)fd);
+        pthread_detach(t);
+    }
+    return NULL;
+}
+
+void* serve(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    handle_client(fd);
+    close(fd);
+    return NULL;
+}
+
+// sends one request to handle_client(), returns everything it wrote back;
+// rest, if any, follows in a separate segment a little later
+std::string exchange(const std::string &request, const std::string &rest = "") {
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    pthread_t server;
+    pthread_create(&server, NULL, serve, (void*)(intptr_t)sv[1]);
+    send_all(sv[0], request);
+    if (!rest.empty()) {
+        usleep(20 * 1000);
+        send_all(sv[0], rest);
+    }
+
+    std::string response;
+    char buf[65536];
+    ssize_t n;
+    while ((n = recv(sv[0], buf, sizeof(buf), 0)) > 0) response.append(buf, n);
+    close(sv[0]);
+    pthread_join(server, NULL);
+    return response;
+}
+
+std::string body_of(const std::string &response) {
+    size_t at = response.find("\r\n\r\n");
+    return at == std::string::npos ? "" : response.substr(at + 4);
+}
+
+bool has(const std::string &s, const char* part) {
+    return s.find(part) != std::string::npos;
+}
+
+// TEST 1: matching URIs are forwarded with rewritten hop-by-hop headers
+bool test_forward() {
+    std::cout << "\n=== Test 1: Forwarding And Header Rewriting ===\n";
+    std::string response = exchange("GET /api/hello?x=1 HTTP/1.1\r\nHost: example.test\r\n"
+                                    "Connection: close, X-Secret\r\nX-Secret: 1\r\nKeep-Alive: 300\r\n\r\n");
+    std::string upstream_saw;
+    {
+        std::lock_guard<std::mutex> g(seen_lock);
+        upstream_saw = seen_head;
+    }
+    std::string static_page = exchange("GET /apinot HTTP/1.1\r\n\r\n");
+
+    bool request = upstream_saw.compare(0, 28, "GET /api/hello?x=1 HTTP/1.1\r") == 0 &&
+                   has(upstream_saw, "Host: example.test\r\n") && has(upstream_saw, "Connection: keep-alive\r\n") &&
+                   has(upstream_saw, "X-Forwarded-Proto: http\r\n") && !has(upstream_saw, "X-Secret") &&
+                   !has(upstream_saw, "Keep-Alive");
+    bool relayed = response.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0 && has(response, "X-Upstream: stub\r\n") &&
+                   has(response, "Connection: close\r\n") && !has(response, "Keep-Alive") && body_of(response) == "hello";
+    bool passed = request && relayed && static_page.compare(0, 12, "HTTP/1.0 404") == 0;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "request and response rewritten, other paths stay static\n";
+    return passed;
+}
+
+// TEST 2: large bodies are spliced both ways intact
+bool test_bodies() {
+    std::cout << "\n=== Test 2: Spliced Request And Response Bodies ===\n";
+    std::string body(2 * 1000 * 1000, '\0');
+    for (size_t i = 0; i < body.size(); i++) body[i] = (char)(i * 13 + i / 4096);
+    std::string response = exchange("POST /api/echo HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) +
+                                    "\r\n\r\n" + body);
+    std::string chunked = exchange("POST /api/echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n");
+
+    bool passed = body_of(response) == body && chunked.compare(0, 12, "HTTP/1.0 411") == 0;
+    std::cout << "[Result] " << body_of(response).size() << " bytes echoed\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "2 MB echoed byte for byte, chunked request refused\n";
+    return passed;
+}
+
+// TEST 3: upstream connections are reused, and a stale one is replaced transparently
+bool test_keep_alive() {
+    std::cout << "\n=== Test 3: Pooled Keep-Alive Upstreams ===\n";
+    int before = upstream_accepts;
+    bool all = true;
+    for (int i = 0; i < 10; i++) all = body_of(exchange("GET /api/hello HTTP/1.1\r\n\r\n")) == "hello" && all;
+    int opened = upstream_accepts - before;
+
+    // the stub hangs up 50 ms after answering; the next request must not see that
+    all = body_of(exchange("GET /api/bye HTTP/1.1\r\n\r\n")) == "bye" && all;
+    usleep(100 * 1000);
+    all = body_of(exchange("GET /api/hello HTTP/1.1\r\n\r\n")) == "hello" && all;
+    // a response delimited by the close ends its connection
+    all = body_of(exchange("GET /api/eof HTTP/1.1\r\n\r\n")) == "until the end" && all;
+
+    bool passed = all && opened == 0;
+    std::cout << "[Result] " << opened << " new upstream connections for 10 requests\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "one pooled connection serves them all, stale one replaced\n";
+    return passed;
+}
+
+// TEST 4: chunked responses pass through to HTTP/1.1 clients and are decoded for HTTP/1.0 ones
+bool test_chunked() {
+    std::cout << "\n=== Test 4: Chunked Responses ===\n";
+    std::string v11 = exchange("GET /api/chunked HTTP/1.1\r\n\r\n");
+    std::string v10 = exchange("GET /api/chunked HTTP/1.0\r\n\r\n");
+
+    bool raw = has(v11, "Transfer-Encoding: chunked\r\n") &&
+               body_of(v11) == "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\nX-Trailer: yes\r\n\r\n";
+    bool decoded = !has(v10, "Transfer-Encoding") && body_of(v10) == "hello world";
+    bool passed = raw && decoded;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "framing kept for HTTP/1.1, stripped for HTTP/1.0\n";
+    return passed;
+}
+
+// TEST 5: an unreachable upstream is a 502, not a hang or a reset
+bool test_upstream_down() {
+    std::cout << "\n=== Test 5: Upstream Down ===\n";
+    std::string response = exchange("GET /down/x HTTP/1.1\r\n\r\n");
+    bool passed = response.compare(0, 24, "HTTP/1.0 502 Bad Gateway") == 0;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "502 Bad Gateway\n";
+    return passed;
+}
+
+// TEST 6: only idempotent requests are resent after a pooled connection dies unanswered
+bool test_no_post_retry() {
+    std::cout << "\n=== Test 6: No Retry For POST ===\n";
+    // each exchange first leaves an idle pooled connection behind
+    exchange("GET /api/hello HTTP/1.1\r\n\r\n");
+    int before = drops;
+    std::string get = exchange("GET /api/drop HTTP/1.1\r\n\r\n");
+    int get_sent = drops - before;
+
+    exchange("GET /api/hello HTTP/1.1\r\n\r\n");
+    before = drops;
+    std::string post = exchange("POST /api/drop HTTP/1.1\r\nContent-Length: 5\r\n\r\norder");
+    int post_sent = drops - before;
+
+    bool passed = get_sent == 2 && post_sent == 1 && get.compare(0, 12, "HTTP/1.0 502") == 0 &&
+                  post.compare(0, 12, "HTTP/1.0 502") == 0;
+    std::cout << "[Result] GET sent " << get_sent << " times, POST sent " << post_sent << " times\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "GET retried once, POST answered 502 without a retry\n";
+    return passed;
+}
+
+// TEST 7: header blocks arriving in several segments, from either side
+bool test_split_heads() {
+    std::cout << "\n=== Test 7: Split Header Blocks ===\n";
+    std::string request = exchange("POST /api/echo HTTP/1.1\r\nHost: localhost\r\n", "Content-Length: 4\r\n\r\nping");
+    std::string response = exchange("GET /api/split HTTP/1.1\r\n\r\n");
+    std::string huge = exchange("GET /api/hello HTTP/1.1\r\n", "X-Pad: " + std::string(PROXY_HEAD_MAX, 'p') + "\r\n\r\n");
+
+    bool passed = request.compare(0, 12, "HTTP/1.1 200") == 0 && body_of(request) == "ping" &&
+                  response.compare(0, 12, "HTTP/1.1 200") == 0 && body_of(response) == "split" &&
+                  huge.compare(0, 12, "HTTP/1.0 431") == 0;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "split request and response heads relayed, 431 past the cap\n";
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Starting Proxy Tests ===\n";
+
+    int passed = 0;
+    int total = 7;
+
+    int listen_fd = create_listener(UPSTREAM, 64);
+    if (listen_fd < 0 || proxy_add_route("/api/", UPSTREAM, 4) < 0 || proxy_add_route("/down/", NOBODY, 4) < 0) {
+        std::cerr << "[FAIL] Could not set up the stub upstream\n";
+        return 1;
+    }
+    pthread_t stub;
+    pthread_create(&stub, NULL, upstream, (void*)(intptr_t)listen_fd);
+    pthread_detach(stub);
+
+    if (test_forward())       passed++;
+    if (test_bodies())        passed++;
+    if (test_keep_alive())    passed++;
+    if (test_chunked())       passed++;
+    if (test_upstream_down()) passed++;
+    if (test_no_post_retry()) passed++;
+    if (test_split_heads())   passed++;
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+
+    if (passed == total) {
+        std::cout << "[SUCCESS] All tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "[FAILURE] Some tests failed.\n";
+        return 1;
+    }
+}
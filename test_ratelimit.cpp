@@ -0,0 +1,239 @@
+/**
+ * @file test_ratelimit.cpp
+ * @brief Test driver for ratelimit.cpp
+ *
+ * Uses made-up client addresses and fd numbers; only test 6 opens sockets
+ * and only test 7 forks.
+ *  Type make test_ratelimit to compile
+ */
+
+#include "ratelimit.h"
+#include <arpa/inet.h>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+const RateLimit OFF = {0, 0, 0};
+
+sockaddr_storage ipv4(const char* text) {
+    sockaddr_storage addr;
+    memset(&addr, 0, sizeof(addr));
+    sockaddr_in* a = (sockaddr_in*)&addr;
+    a->sin_family = AF_INET;
+    inet_pton(AF_INET, text, &a->sin_addr);
+    return addr;
+}
+
+sockaddr_storage ipv6(const char* text) {
+    sockaddr_storage addr;
+    memset(&addr, 0, sizeof(addr));
+    sockaddr_in6* a = (sockaddr_in6*)&addr;
+    a->sin6_family = AF_INET6;
+    inet_pton(AF_INET6, text, &a->sin6_addr);
+    return addr;
+}
+
+std::string stats() {
+    std::ostringstream out;
+    ratelimit_write_stats(out, NULL);
+    return out.str();
+}
+
+// TEST 1: a burst drains the bucket, which refills at the configured rate
+bool test_token_bucket() {
+    std::cout << "\n=== Test 1: Token Bucket ===\n";
+    ratelimit_configure({10, 3, 0}, OFF);
+    sockaddr_storage client = ipv4("192.0.2.1");
+
+    int burst = 0;
+    for (int i = 0; i < 5; i++) {
+        if (ratelimit_admit(-1, client) == RATELIMIT_ADMIT) burst++;
+    }
+    bool limited = ratelimit_admit(-1, client) == RATELIMIT_RATE;
+    bool other = ratelimit_admit(-1, ipv4("192.0.2.2")) == RATELIMIT_ADMIT;
+    usleep(150 * 1000); // 10/s: one token every 100 ms
+    bool refilled = ratelimit_admit(-1, client) == RATELIMIT_ADMIT;
+    bool once = ratelimit_admit(-1, client) == RATELIMIT_RATE;
+
+    bool passed = burst == 3 && limited && other && refilled && once;
+    std::cout << "[Result] " << burst << " of 5 admitted in the burst\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "burst of 3, then one per 100 ms, other clients unaffected\n";
+    return passed;
+}
+
+// TEST 2: open connections are counted until released
+bool test_connection_limit() {
+    std::cout << "\n=== Test 2: Open Connection Limit ===\n";
+    ratelimit_configure({0, 0, 2}, OFF);
+    sockaddr_storage client = ipv6("2001:db8::1");
+
+    bool first = ratelimit_admit(100, client) == RATELIMIT_ADMIT;
+    bool second = ratelimit_admit(101, client) == RATELIMIT_ADMIT;
+    bool third = ratelimit_admit(102, client) == RATELIMIT_CONNS;
+    ratelimit_release(100);
+    bool after_close = ratelimit_admit(103, client) == RATELIMIT_ADMIT;
+    ratelimit_release(101);
+    ratelimit_release(103);
+
+    bool passed = first && second && third && after_close;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "third concurrent connection refused until one closes\n";
+    return passed;
+}
+
+// TEST 3: neighbours share their network's limit; IPv4-mapped clients count as IPv4
+bool test_network_limit() {
+    std::cout << "\n=== Test 3: Per-/24 And Per-/64 Limits ===\n";
+    ratelimit_configure(OFF, {0, 0, 2});
+
+    bool v4 = ratelimit_admit(200, ipv4("198.51.100.1")) == RATELIMIT_ADMIT &&
+              ratelimit_admit(201, ipv6("::ffff:198.51.100.2")) == RATELIMIT_ADMIT &&
+              ratelimit_admit(202, ipv4("198.51.100.3")) == RATELIMIT_CONNS &&
+              ratelimit_admit(203, ipv4("198.51.101.1")) == RATELIMIT_ADMIT;
+    bool v6 = ratelimit_admit(204, ipv6("2001:db8:0:1::1")) == RATELIMIT_ADMIT &&
+              ratelimit_admit(205, ipv6("2001:db8:0:1:ffff::2")) == RATELIMIT_ADMIT &&
+              ratelimit_admit(206, ipv6("2001:db8:0:1::3")) == RATELIMIT_CONNS &&
+              ratelimit_admit(207, ipv6("2001:db8:0:2::1")) == RATELIMIT_ADMIT;
+    sockaddr_storage unix_client;
+    unix_client.ss_family = AF_UNIX;
+    bool local = ratelimit_admit(208, unix_client) == RATELIMIT_ADMIT;
+    for (int fd = 200; fd <= 208; fd++) ratelimit_release(fd);
+
+    bool passed = v4 && v6 && local;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "third client of a /24 or /64 refused, next network admitted\n";
+    return passed;
+}
+
+std::atomic<int> admitted(0);
+
+void* hammer(void*) {
+    sockaddr_storage client = ipv4("203.0.113.7");
+    for (int i = 0; i < 5000; i++) {
+        if (ratelimit_admit(-1, client) == RATELIMIT_ADMIT) admitted++;
+        // new addresses as well, so claims race with each other
+        ratelimit_admit(-1, ipv4(("198.18.0." + std::to_string(i % 64)).c_str()));
+    }
+    return NULL;
+}
+
+// TEST 4: concurrent admissions never hand out more tokens than the bucket holds
+bool test_concurrent_tokens() {
+    std::cout << "\n=== Test 4: Concurrent Token Updates ===\n";
+    // refills one token per ~17 minutes, so the burst is all there is
+    ratelimit_configure({0.001, 1000, 0}, OFF);
+    admitted = 0;
+
+    pthread_t threads[8];
+    for (pthread_t &t : threads) pthread_create(&t, NULL, hammer, NULL);
+    for (pthread_t &t : threads) pthread_join(t, NULL);
+
+    // 64 addresses plus 203.0.113.7: every one claimed exactly once
+    std::string s = stats();
+    bool passed = admitted == 1000 && s.find("\"entries\": 65,") != std::string::npos;
+    std::cout << "[Result] " << admitted << " of 40000 admitted, stats " << s << "\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "exactly the burst admitted, one entry per address\n";
+    return passed;
+}
+
+// TEST 5: a full table lets unknown clients through instead of locking them out
+bool test_table_full() {
+    std::cout << "\n=== Test 5: Full Table Fails Open ===\n";
+    ratelimit_configure({1, 1, 0}, OFF);
+    int capacity = RATELIMIT_SHARDS * RATELIMIT_SHARD_ENTRIES;
+    int refused = 0;
+    for (int i = 0; i < capacity * 2; i++) {
+        sockaddr_storage client = ipv4("10.0.0.0");
+        ((sockaddr_in*)&client)->sin_addr.s_addr = htonl(0x0a000000 + i);
+        if (ratelimit_admit(-1, client) != RATELIMIT_ADMIT) refused++;
+    }
+    std::string s = stats();
+    bool passed = refused == 0 && s.find("\"table_full\": 0,") == std::string::npos;
+    std::cout << "[Result] stats " << s << "\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "all " << capacity * 2 << " new clients admitted\n";
+    return passed;
+}
+
+// TEST 6: a refused client reads a 429 instead of a reset
+bool test_reject_response() {
+    std::cout << "\n=== Test 6: 429 Response ===\n";
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    const char* request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(sv[0], request, strlen(request), 0);
+    ratelimit_reject(sv[1], RATELIMIT_CONNS, false);
+
+    char buf[512] = {0};
+    ssize_t n = recv(sv[0], buf, sizeof(buf) - 1, 0);
+    close(sv[0]);
+
+    // a ClientHello must not be answered in plaintext
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    send(sv[0], "\x16\x03\x01\x00\x05hello", 10, 0);
+    ratelimit_reject(sv[1], RATELIMIT_RATE, true);
+    char tls_buf[64];
+    ssize_t tls_n = recv(sv[0], tls_buf, sizeof(tls_buf), 0);
+    close(sv[0]);
+
+    bool passed = n > 0 && strncmp(buf, "HTTP/1.0 429 Too Many Requests", 30) == 0 &&
+                  strstr(buf, "Retry-After: 1") && strstr(buf, "too many open connections") && tls_n == 0;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "429 with Retry-After, a bare close for TLS\n";
+    return passed;
+}
+
+// TEST 7: processes sharing the table share the limits, as --prefork workers do
+bool test_shared_table() {
+    std::cout << "\n=== Test 7: Table Shared Between Processes ===\n";
+    ratelimit_configure({1, 4, 0}, OFF);
+    size_t size = ratelimit_shared_size();
+    void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return false;
+    ratelimit_share(mem);
+    sockaddr_storage client = ipv4("192.0.2.7");
+
+    // the child spends three of the four tokens
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (int i = 0; i < 3; i++) ratelimit_admit(-1, client);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+    bool last = ratelimit_admit(-1, client) == RATELIMIT_ADMIT;
+    bool limited = ratelimit_admit(-1, client) == RATELIMIT_RATE;
+    std::string shared = stats();
+    bool counted = shared.find("\"admitted\": 4,") != std::string::npos;
+
+    ratelimit_share(NULL);
+    munmap(mem, size);
+    bool passed = last && limited && counted;
+    std::cout << "[Result] " << shared << "\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "tokens spent by another process count here\n";
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Starting Rate Limit Tests ===\n";
+
+    int passed = 0;
+    int total = 7;
+
+    if (test_token_bucket())      passed++;
+    if (test_connection_limit())  passed++;
+    if (test_network_limit())     passed++;
+    if (test_concurrent_tokens()) passed++;
+    if (test_table_full())        passed++;
+    if (test_reject_response())   passed++;
+    if (test_shared_table())      passed++;
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+
+    if (passed == total) {
+        std::cout << "[SUCCESS] All tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "[FAILURE] Some tests failed.\n";
+        return 1;
+    }
+}
@@ -0,0 +1,218 @@
+/**
+ * @file test_reactor.cpp
+ * @brief Test driver for reactor.cpp
+ *
+ * Runs pairs of coroutines over a non-blocking socketpair() so every
+ * awaitable has to suspend at least once and be resumed by the reactor.
+ * Type make test_reactor to compile
+ */
+
+#include "reactor.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/un.h>
+
+// the reactor stops once this many coroutines have finished
+int finished = 0;
+int expected = 0;
+
+void done(Reactor* r) {
+    if (++finished == expected) r->stop = true;
+}
+
+// sends len bytes of 'x', suspending whenever the socket buffer is full
+Task writer(Reactor* r, int fd, size_t len, size_t* sent) {
+    std::string data(len, 'x');
+    while (*sent < len) {
+        ssize_t n = co_await async_send(r, fd, data.data() + *sent, len - *sent);
+        if (n <= 0) break;
+        *sent += n;
+    }
+    reactor_close(r, fd);
+    done(r);
+}
+
+// reads until EOF, suspending whenever nothing is buffered yet
+Task reader(Reactor* r, int fd, size_t* received) {
+    char buf[65536];
+    while (true) {
+        ssize_t n = co_await async_recv(r, fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        *received += n;
+    }
+    reactor_close(r, fd);
+    done(r);
+}
+
+Task file_sender(Reactor* r, int fd, int file_fd, off_t size) {
+    off_t offset = 0;
+    while (offset < size) {
+        ssize_t n = co_await async_sendfile(r, fd, file_fd, &offset, size - offset);
+        if (n <= 0) break;
+    }
+    reactor_close(r, fd);
+    done(r);
+}
+
+bool make_pair(int sv[2]) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) return false;
+    return set_nonblocking(sv[0]) == 0 && set_nonblocking(sv[1]) == 0;
+}
+
+// TEST 1: a large transfer where both sides must suspend repeatedly
+bool test_send_recv() {
+    std::cout << "\n=== Test 1: Send/Recv Through Reactor ===\n";
+
+    Reactor r;
+    reactor_init(&r);
+    int sv[2];
+    if (!make_pair(sv)) return false;
+
+    size_t len = 8 * 1024 * 1024, sent = 0, received = 0;
+    finished = 0;
+    expected = 2;
+
+    // reader starts first and has to suspend: nothing has been sent yet
+    reader(&r, sv[1], &received);
+    writer(&r, sv[0], len, &sent);
+    reactor_run(&r);
+    reactor_destroy(&r);
+
+    bool passed = sent == len && received == len;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "sent=" << sent
+              << " received=" << received << "\n";
+    return passed;
+}
+
+// TEST 2: sendfile from a regular file into a socket
+bool test_sendfile() {
+    std::cout << "\n=== Test 2: Sendfile Through Reactor ===\n";
+
+    const char* path = "/tmp/reactor_test.bin";
+    off_t size = 4 * 1024 * 1024;
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f << std::string(size, 'y');
+    }
+    int file_fd = open(path, O_RDONLY);
+
+    Reactor r;
+    reactor_init(&r);
+    int sv[2];
+    if (file_fd < 0 || !make_pair(sv)) return false;
+
+    size_t received = 0;
+    finished = 0;
+    expected = 2;
+
+    file_sender(&r, sv[0], file_fd, size);
+    reader(&r, sv[1], &received);
+    reactor_run(&r);
+    reactor_destroy(&r);
+
+    close(file_fd);
+    unlink(path);
+
+    bool passed = received == (size_t)size;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "received=" << received << "\n";
+    return passed;
+}
+
+Task acceptor(Reactor* r, int listen_fd, int* accepted) {
+    sockaddr_storage addr;
+    *accepted = (int)co_await async_accept(r, listen_fd, &addr);
+    done(r);
+}
+
+// ticks every 10 ms; the fifth tick frees one descriptor for the acceptor
+Task ticker(Reactor* r, int* ticks, std::vector<int>* filler) {
+    while (*ticks < 5) {
+        co_await async_sleep(r, 10);
+        ++*ticks;
+    }
+    close(filler->back());
+    filler->pop_back();
+    done(r);
+}
+
+// TEST 3: accept() failing with EMFILE must suspend, not spin the reactor thread
+bool test_accept_emfile() {
+    std::cout << "\n=== Test 3: Accept Out Of Descriptors ===\n";
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    const char name[] = "@test_reactor_emfile";
+    memcpy(addr.sun_path, name, sizeof(name) - 1);
+    addr.sun_path[0] = '\0';
+    socklen_t addr_len = offsetof(sockaddr_un, sun_path) + sizeof(name) - 1;
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int client_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || client_fd < 0 || bind(listen_fd, (sockaddr*)&addr, addr_len) < 0 ||
+        listen(listen_fd, 8) < 0 || connect(client_fd, (sockaddr*)&addr, addr_len) < 0) {
+        return false;
+    }
+
+    Reactor r;
+    reactor_init(&r);
+
+    // lower the limit a little above what is open, then use up every slot below it
+    rlimit saved;
+    getrlimit(RLIMIT_NOFILE, &saved);
+    int probe = dup(0);
+    close(probe);
+    rlimit low = saved;
+    low.rlim_cur = probe + 8;
+    setrlimit(RLIMIT_NOFILE, &low);
+    std::vector<int> filler;
+    int fd;
+    while ((fd = open("/dev/null", O_RDONLY)) >= 0) filler.push_back(fd);
+    int first_errno = errno;
+
+    int accepted = -1, ticks = 0;
+    finished = 0;
+    expected = 2;
+
+    acceptor(&r, listen_fd, &accepted);
+    ticker(&r, &ticks, &filler);
+    reactor_run(&r);
+    reactor_destroy(&r);
+
+    for (int f : filler) close(f);
+    setrlimit(RLIMIT_NOFILE, &saved);
+    if (accepted >= 0) close(accepted);
+    close(client_fd);
+    close(listen_fd);
+
+    bool passed = first_errno == EMFILE && ticks == 5 && accepted >= 0;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "ticks=" << ticks << " accepted=" << accepted
+              << " after EMFILE\n";
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Starting Reactor Tests ===\n";
+
+    int passed = 0;
+    int total = 3;
+
+    if (test_send_recv())     passed++;
+    if (test_sendfile())      passed++;
+    if (test_accept_emfile()) passed++;
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+
+    if (passed == total) {
+        std::cout << "[SUCCESS] All tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "[FAILURE] Some tests failed.\n";
+        return 1;
+    }
+}
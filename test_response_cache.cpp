@@ -0,0 +1,217 @@
+/**
+ * @file test_response_cache.cpp
+ * @brief Test driver for response_cache.cpp and ebr.cpp
+ *
+ * Type make test_response_cache to compile
+ */
+
+#include "response_cache.h"
+#include "ebr.h"
+#include <atomic>
+#include <iostream>
+#include <pthread.h>
+#include <unistd.h>
+
+const long long NOW = 1000000;
+
+CachedResponse* make_entry(const std::string &path, const std::string &body, long long expires_ms = NOW + 60000) {
+    CachedResponse* e = new CachedResponse();
+    e->path = path;
+    e->bytes = "HTTP/1.0 200 OK\r\n\r\n" + body;
+    e->header_len = e->bytes.size() - body.size();
+    e->mime = "text/plain";
+    e->cache_control = "no-cache";
+    e->expires_ms = expires_ms;
+    return e;
+}
+
+// body of the entry cached for path, or "" on a miss
+std::string lookup_body(ResponseCache* cache, const std::string &path, long long now = NOW) {
+    ebr_enter();
+    const CachedResponse* e = response_cache_lookup(cache, path, now);
+    std::string body = e ? e->bytes.substr(e->header_len) : "";
+    ebr_exit();
+    return body;
+}
+
+// TEST 1: inserted responses are found until they expire; replacing swaps the body
+bool test_insert_lookup() {
+    std::cout << "\n=== Test 1: Insert, Lookup, Replace ===\n";
+
+    ResponseCache cache;
+    response_cache_init(&cache, 8);
+
+    response_cache_insert(&cache, make_entry("./www/a.html", "aaa"), response_cache_generation(&cache));
+    response_cache_insert(&cache, make_entry("./www/b.html", "bbb", NOW + 10), response_cache_generation(&cache));
+    bool found = lookup_body(&cache, "./www/a.html") == "aaa" && lookup_body(&cache, "./www/b.html") == "bbb";
+    bool expired = lookup_body(&cache, "./www/b.html", NOW + 10) == "";
+    bool missing = lookup_body(&cache, "./www/c.html") == "";
+
+    response_cache_insert(&cache, make_entry("./www/a.html", "AAA"), response_cache_generation(&cache));
+    bool replaced = lookup_body(&cache, "./www/a.html") == "AAA" && cache.replacements == 1 &&
+                    cache.fifo.size() == 2;
+
+    response_cache_destroy(&cache);
+
+    bool passed = found && expired && missing && replaced;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "hits, expiry and replacement\n";
+    return passed;
+}
+
+// TEST 2: a response built before an invalidation is not published
+bool test_stale_generation() {
+    std::cout << "\n=== Test 2: Insert Racing An Invalidation ===\n";
+
+    ResponseCache cache;
+    response_cache_init(&cache, 8);
+
+    uint64_t before = response_cache_generation(&cache);
+    response_cache_invalidate(&cache, "./www/a.html");
+    bool dropped = !response_cache_insert(&cache, make_entry("./www/a.html", "old"), before);
+    bool kept = response_cache_insert(&cache, make_entry("./www/a.html", "new"), response_cache_generation(&cache));
+    bool passed = dropped && kept && lookup_body(&cache, "./www/a.html") == "new";
+
+    response_cache_destroy(&cache);
+
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "stale response dropped\n";
+    return passed;
+}
+
+// TEST 3: the cache stays bounded; directory invalidation drops everything below it
+bool test_eviction_and_prefix() {
+    std::cout << "\n=== Test 3: Eviction And Prefix Invalidation ===\n";
+
+    ResponseCache cache;
+    response_cache_init(&cache, 4);
+
+    const char* paths[] = {"./www/1", "./www/css/a.css", "./www/css/b.css", "./www/css2", "./www/5"};
+    for (const char* p : paths) {
+        response_cache_insert(&cache, make_entry(p, p), response_cache_generation(&cache));
+    }
+    bool bounded = cache.fifo.size() == 4 && cache.evictions == 1 && lookup_body(&cache, "./www/1") == "";
+
+    response_cache_invalidate_prefix(&cache, "./www/css");
+    bool prefix = lookup_body(&cache, "./www/css/a.css") == "" && lookup_body(&cache, "./www/css/b.css") == "" &&
+                  lookup_body(&cache, "./www/css2") == "./www/css2" && cache.fifo.size() == 2;
+
+    response_cache_destroy(&cache);
+
+    bool passed = bounded && prefix;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "oldest evicted, css/ dropped, css2 kept\n";
+    return passed;
+}
+
+// state shared with the reader thread of test 4
+std::atomic<bool> reader_inside(false);
+std::atomic<bool> reader_release(false);
+std::atomic<bool> object_freed(false);
+
+void mark_freed(void*) {
+    object_freed = true;
+}
+
+void* hold_section(void*) {
+    ebr_enter();
+    reader_inside = true;
+    while (!reader_release) usleep(1000);
+    ebr_exit();
+    return NULL;
+}
+
+// TEST 4: a retired object outlives every read section that started before it
+bool test_reclamation_waits() {
+    std::cout << "\n=== Test 4: Reclamation Waits For Readers ===\n";
+
+    pthread_t reader;
+    pthread_create(&reader, NULL, hold_section, NULL);
+    while (!reader_inside) usleep(1000);
+
+    static int object;
+    ebr_retire(&object, mark_freed);
+    for (int i = 0; i < 10; i++) ebr_collect();
+    bool held = !object_freed && ebr_pending() == 1;
+
+    reader_release = true;
+    pthread_join(reader, NULL);
+    ebr_synchronize();
+    bool freed = object_freed && ebr_pending() == 0;
+
+    bool passed = held && freed;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "freed only after the reader left\n";
+    return passed;
+}
+
+// state shared with the reader threads of test 5
+const int STRESS_READERS = 4;
+const int STRESS_PATHS = 16;
+std::atomic<bool> stress_stop(false);
+
+void* stress_reader(void* arg) {
+    ResponseCache* cache = (ResponseCache*)arg;
+    long bad = 0;
+    for (long i = 0; !stress_stop; i++) {
+        std::string path = "./www/" + std::to_string(i % STRESS_PATHS);
+        ebr_enter();
+        const CachedResponse* e = response_cache_lookup(cache, path, NOW);
+        // every version of a path's body starts with the path itself
+        if (e && e->bytes.compare(e->header_len, path.size(), path) != 0) bad++;
+        ebr_exit();
+    }
+    return (void*)bad;
+}
+
+// TEST 5: readers never see a torn or freed entry while a writer churns the cache
+bool test_concurrent_churn() {
+    std::cout << "\n=== Test 5: Readers Under Churn ===\n";
+
+    ResponseCache cache;
+    response_cache_init(&cache, STRESS_PATHS / 2);
+    stress_stop = false;
+
+    pthread_t readers[STRESS_READERS];
+    for (int i = 0; i < STRESS_READERS; i++) pthread_create(&readers[i], NULL, stress_reader, &cache);
+
+    for (int round = 0; round < 20000; round++) {
+        std::string path = "./www/" + std::to_string(round % STRESS_PATHS);
+        if (round % 7 == 0) response_cache_invalidate(&cache, path);
+        else response_cache_insert(&cache, make_entry(path, path + "#" + std::to_string(round)),
+                                   response_cache_generation(&cache));
+    }
+    stress_stop = true;
+
+    long bad = 0;
+    for (int i = 0; i < STRESS_READERS; i++) {
+        void* r;
+        pthread_join(readers[i], &r);
+        bad += (long)r;
+    }
+    response_cache_destroy(&cache);
+
+    bool passed = bad == 0 && ebr_pending() == 0;
+    std::cout << "[Result] " << bad << " bad reads\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "consistent reads, nothing left to reclaim\n";
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Starting Response Cache Tests ===\n";
+
+    int passed = 0;
+    int total = 5;
+
+    if (test_insert_lookup())       passed++;
+    if (test_stale_generation())    passed++;
+    if (test_eviction_and_prefix()) passed++;
+    if (test_reclamation_waits())   passed++;
+    if (test_concurrent_churn())    passed++;
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+
+    if (passed == total) {
+        std::cout << "[SUCCESS] All tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "[FAILURE] Some tests failed.\n";
+        return 1;
+    }
+}
@@ -10,6 +10,121 @@
 #include <arpa/inet.h>
 #include <sys/wait.h>
 #include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/**
+ * @brief Listens on spec, connects to it and accepts the connection.
+ * No second process is needed: connect() completes against the backlog
+ * before accept() is called.
+ */
+bool roundtrip(const char* spec) {
+    int listen_fd = create_listener(spec);
+    if (listen_fd < 0) return false;
+
+    sockaddr_storage addr;
+    socklen_t len;
+    bool ok = resolve_socket_spec(spec, &addr, &len) == 0;
+
+    int sock = socket(addr.ss_family, SOCK_STREAM, 0);
+    ok = ok && sock >= 0 && connect(sock, (sockaddr*)&addr, len) == 0;
+
+    sockaddr_storage client;
+    int client_fd = ok ? accept_client(listen_fd, client) : -1;
+    ok = ok && client_fd >= 0 && client.ss_family == addr.ss_family;
+
+    if (client_fd >= 0) close(client_fd);
+    if (sock >= 0) close(sock);
+    close(listen_fd);
+    return ok;
+}
+
+int test_listener_specs() {
+    int failures = 0;
+    sockaddr_storage addr;
+    socklen_t len;
+
+    const char* good[] = {"8080", ":8080", "127.0.0.1:80", "[::]:8080", "[::1]:443",
+                          "unix:/tmp/x.sock", "unix:@abstract"};
+    const char* bad[] = {"", "http", "1.2.3.4", "127.0.0.1:99999", "[::1]8080",
+                         "[nope]:80", "unix:", "localhost:80"};
+    for (const char* spec : good) {
+        if (resolve_socket_spec(spec, &addr, &len) != 0) {
+            std::cerr << "[FAIL] spec rejected: " << spec << "\n";
+            failures++;
+        }
+    }
+    for (const char* spec : bad) {
+        if (resolve_socket_spec(spec, &addr, &len) == 0) {
+            std::cerr << "[FAIL] spec accepted: '" << spec << "'\n";
+            failures++;
+        }
+    }
+
+    resolve_socket_spec("unix:@abstract", &addr, &len);
+    sockaddr_un* un = (sockaddr_un*)&addr;
+    if (un->sun_path[0] != '\0' || len != offsetof(sockaddr_un, sun_path) + 9) {
+        std::cerr << "[FAIL] abstract name not encoded with a leading NUL\n";
+        failures++;
+    }
+
+    if (failures == 0) std::cout << "[PASS] Listener specs parsed\n";
+    return failures;
+}
+
+int test_listener_families() {
+    int failures = 0;
+    const char* path = "/tmp/test_socket.sock";
+    unlink(path);
+
+    std::string fs_spec = std::string("unix:") + path;
+    const char* specs[] = {"127.0.0.1:9091", "[::1]:9091", fs_spec.c_str(), "unix:@test_socket"};
+    for (const char* spec : specs) {
+        if (roundtrip(spec)) {
+            std::cout << "[PASS] Connected through " << spec << "\n";
+        } else {
+            std::cerr << "[FAIL] No connection through " << spec << "\n";
+            failures++;
+        }
+    }
+
+    // the socket file outlives its listener; the next bind must replace it
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISSOCK(st.st_mode) || !roundtrip(fs_spec.c_str())) {
+        std::cerr << "[FAIL] Stale Unix socket file not reclaimed\n";
+        failures++;
+    } else {
+        std::cout << "[PASS] Stale Unix socket file reclaimed\n";
+    }
+
+    // ...but a live one must not be stolen from a running server
+    int live = create_listener(fs_spec.c_str());
+    int second = create_listener(fs_spec.c_str());
+    if (live < 0 || second >= 0) {
+        std::cerr << "[FAIL] Live Unix socket was taken over\n";
+        failures++;
+    } else {
+        std::cout << "[PASS] Live Unix socket left alone\n";
+    }
+    if (live >= 0) close(live);
+    if (second >= 0) close(second);
+    unlink(path);
+
+    // an IPv6 listener must not grab the IPv4 side of its port
+    int v4 = create_listener("9092");
+    int v6 = create_listener("[::]:9092");
+    if (v4 < 0 || v6 < 0) {
+        std::cerr << "[FAIL] IPv4 and IPv6 listeners could not share a port\n";
+        failures++;
+    } else {
+        std::cout << "[PASS] IPv4 and IPv6 listeners share a port\n";
+    }
+    if (v4 >= 0) close(v4);
+    if (v6 >= 0) close(v6);
+
+    return failures;
+}
 
 int main() {
     std::cout << "=== Starting Socket Test ===\n";
@@ -64,5 +179,6 @@ int main() {
         close(listen_fd);
     }
 
-    return 0;
+    int failures = test_listener_specs() + test_listener_families();
+    return failures == 0 ? 0 : 1;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <unistd.h>
 #include <pthread.h>
+#include <vector>
 
 // We use a fake handle_client() so we don't need real networking
 //
@@ -146,18 +147,111 @@ bool test_immediate_shutdown() {
     return true;
 }
 
+// Lane tests record which fds ran, in order; fds >= 2000 are "large" tasks
+std::vector<int> handled_order;
+pthread_mutex_t order_lock = PTHREAD_MUTEX_INITIALIZER;
+volatile bool gate_open = false;
+
+void record_task(int fd) {
+    if (fd == 1) {
+        // blocker: holds the only worker until the test has filled the lanes
+        while (!gate_open) usleep(1000);
+    } else {
+        usleep(fd >= 2000 ? 200000 : 1000);
+    }
+    pthread_mutex_lock(&order_lock);
+    handled_order.push_back(fd);
+    pthread_mutex_unlock(&order_lock);
+}
+
+// TEST 5: Lanes are served in proportion to their weights
+bool test_weighted_lanes() {
+    std::cout << "\n=== Test 5: Weighted Lanes ===\n";
+
+    handled_order.clear();
+    gate_open = false;
+
+    ThreadPool pool;
+    pool_init_handler(&pool, 1, record_task);
+
+    // park the single worker, then queue 10 large and 20 small tasks
+    pool_enqueue_lane(&pool, 1, LANE_SMALL);
+    usleep(50000);
+    for (int i = 0; i < 10; i++) pool_enqueue_lane(&pool, 2000 + i, LANE_LARGE);
+    for (int i = 0; i < 20; i++) pool_enqueue_lane(&pool, 100 + i, LANE_SMALL);
+    gate_open = true;
+    pool_destroy(&pool);
+
+    // after the blocker, every run of 9 dequeues is 8 small : 1 large
+    int small = 0, large = 0;
+    for (size_t i = 1; i < 10 && i < handled_order.size(); i++) {
+        if (handled_order[i] >= 2000) large++;
+        else small++;
+    }
+    std::cout << "[Result] First 9 dequeues: " << small << " small, " << large << " large\n";
+
+    bool passed = handled_order.size() == 31 && small == LANE_WEIGHTS[LANE_SMALL]
+               && large == LANE_WEIGHTS[LANE_LARGE];
+    if (passed) {
+        std::cout << "[PASS] Lanes shared the worker by weight\n";
+    } else {
+        std::cout << "[FAIL] Unexpected dequeue order\n";
+    }
+    return passed;
+}
+
+// TEST 6: Large tasks never take every worker; small ones keep flowing
+bool test_small_not_blocked() {
+    std::cout << "\n=== Test 6: Small Requests Behind Large Ones ===\n";
+
+    handled_order.clear();
+    gate_open = true;
+
+    ThreadPool pool;
+    pool_init_handler(&pool, 2, record_task);
+
+    for (int i = 0; i < 4; i++) pool_enqueue_lane(&pool, 2000 + i, LANE_LARGE);
+    usleep(20000);
+    pool_enqueue_lane(&pool, 100, LANE_SMALL);
+
+    // one 200ms large task is still running: the small one must be done already
+    usleep(100000);
+    pthread_mutex_lock(&order_lock);
+    bool small_done = handled_order.size() == 1 && handled_order[0] == 100;
+    pthread_mutex_unlock(&order_lock);
+
+    pool_destroy(&pool);
+
+    PoolLaneStats small, large;
+    pool_lane_stats(&pool, LANE_SMALL, &small);
+    pool_lane_stats(&pool, LANE_LARGE, &large);
+    std::cout << "[Result] small wait max " << small.max_us << " us, large wait max "
+              << large.max_us << " us\n";
+
+    bool passed = small_done && small.dequeued == 1 && large.dequeued == 4
+               && small.max_us < 50000 && large.max_us > 100000;
+    if (passed) {
+        std::cout << "[PASS] Small task ran on the reserved worker\n";
+    } else {
+        std::cout << "[FAIL] Small task waited behind large ones\n";
+    }
+    return passed;
+}
+
 int main() {
     std::cout << "========================================\n";
     std::cout << "       Thread Pool Test Suite\n";
     std::cout << "========================================\n";
 
     int passed = 0;
-    int total  = 4;
+    int total  = 6;
 
     if (test_init_destroy())        passed++;
     if (test_process_tasks())       passed++;
     if (test_queue_capacity())      passed++;
     if (test_immediate_shutdown())  passed++;
+    if (test_weighted_lanes())      passed++;
+    if (test_small_not_blocked())   passed++;
 
     std::cout << "\n========================================\n";
     std::cout << "           Test Summary\n";
@@ -0,0 +1,155 @@
+/**
+ * @file test_trace.cpp
+ * @brief Test driver for trace.cpp
+ *
+ * Uses made-up fd numbers; no sockets are opened.
+ * Type make test_trace to compile
+ */
+
+#include "trace.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <pthread.h>
+#include <unistd.h>
+
+const char* TRACE_FILE = "/tmp/test_trace.json";
+
+std::string read_file(const char* path) {
+    std::ifstream f(path);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+size_t count(const std::string &s, const std::string &what) {
+    size_t n = 0;
+    for (size_t pos = 0; (pos = s.find(what, pos)) != std::string::npos; pos += what.size()) n++;
+    return n;
+}
+
+// TEST 1: with tracing off nothing is timed or recorded
+bool test_disabled() {
+    std::cout << "\n=== Test 1: Disabled ===\n";
+    trace_enable(0);
+
+    uint64_t t = trace_clock();
+    trace_accept(100, t);
+    trace_span(100, TRACE_RECV, t, 10);
+    int events = trace_dump(TRACE_FILE);
+
+    bool passed = t == 0 && events == 0;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "no clock reads, no events\n";
+    return passed;
+}
+
+// TEST 2: one connection in N is sampled, the others cost nothing
+bool test_sampling() {
+    std::cout << "\n=== Test 2: Sampling 1 In 4 ===\n";
+    trace_enable(4);
+
+    int before = trace_dump(TRACE_FILE);
+    for (int fd = 100; fd < 108; fd++) {
+        trace_accept(fd, trace_clock());
+        trace_span(fd, TRACE_RECV, trace_clock(), 64);
+    }
+    int after = trace_dump(TRACE_FILE);
+    std::string json = read_file(TRACE_FILE);
+
+    // two sampled connections, an accept and a recv span each
+    bool passed = after - before == 4 && count(json, "\"name\": \"recv\"") == 2 &&
+                  count(json, "\"bytes\": 64") == 2;
+    std::cout << "[Result] " << after - before << " events\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "2 of 8 connections traced\n";
+    return passed;
+}
+
+void* serve_fd(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    trace_span(fd, TRACE_DEQUEUE, trace_clock(), 5);
+    trace_bind(fd);
+    trace_here(TRACE_PARSE, trace_clock());
+    trace_here(TRACE_OPEN, trace_clock(), 1234);
+    trace_span(fd, TRACE_CLOSE, trace_clock());
+    return NULL;
+}
+
+// TEST 3: spans from several threads are tied together by the connection id
+bool test_cross_thread() {
+    std::cout << "\n=== Test 3: One Request Across Threads ===\n";
+    trace_enable(1);
+
+    int fd = 200;
+    trace_accept(fd, trace_clock());
+    trace_span(fd, TRACE_ENQUEUE, trace_clock(), 1);
+
+    pthread_t worker;
+    pthread_create(&worker, NULL, serve_fd, (void*)(intptr_t)fd);
+    pthread_join(worker, NULL);
+
+    trace_dump(TRACE_FILE);
+    std::string json = read_file(TRACE_FILE);
+
+    // the connection's six spans are linked by one flow: start, four steps, finish
+    bool names = json.find("\"enqueue\"") != std::string::npos && json.find("\"dequeue\"") != std::string::npos &&
+                 json.find("\"parse\"") != std::string::npos && json.find("\"size\": 1234") != std::string::npos &&
+                 json.find("\"queued_us\": 5") != std::string::npos;
+    bool flow = count(json, "\"ph\": \"s\"") == count(json, "\"ph\": \"f\"") &&
+                json.find("\"bp\": \"e\"") != std::string::npos;
+    bool threads = json.find("\"tid\": " + std::to_string(gettid())) != std::string::npos;
+
+    bool passed = names && flow && threads;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "spans of both threads, linked by a flow\n";
+    return passed;
+}
+
+void* flood(void*) {
+    for (int i = 0; i < 3 * TRACE_BUFFER_EVENTS; i++) trace_span(300, TRACE_SEND, trace_clock(), i);
+    return NULL;
+}
+
+// TEST 4: a busy thread keeps only its most recent events
+bool test_ring_wraps() {
+    std::cout << "\n=== Test 4: Ring Buffer Wraps ===\n";
+    trace_enable(1);
+    trace_accept(300, trace_clock());
+
+    int before = trace_dump(TRACE_FILE);
+    pthread_t t;
+    pthread_create(&t, NULL, flood, NULL);
+    pthread_join(t, NULL);
+    int after = trace_dump(TRACE_FILE);
+    std::string json = read_file(TRACE_FILE);
+
+    bool bounded = after - before <= TRACE_BUFFER_EVENTS;
+    bool newest = json.find("\"bytes\": " + std::to_string(3 * TRACE_BUFFER_EVENTS - 1)) != std::string::npos;
+    bool oldest_gone = json.find("\"bytes\": 0}") == std::string::npos;
+
+    bool passed = bounded && newest && oldest_gone;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "old events overwritten, newest kept\n";
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Starting Trace Tests ===\n";
+
+    int passed = 0;
+    int total = 4;
+
+    if (test_disabled())     passed++;
+    if (test_sampling())     passed++;
+    if (test_cross_thread()) passed++;
+    if (test_ring_wraps())   passed++;
+
+    unlink(TRACE_FILE);
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+
+    if (passed == total) {
+        std::cout << "[SUCCESS] All tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "[FAILURE] Some tests failed.\n";
+        return 1;
+    }
+}
@@ -0,0 +1,245 @@
+/**
+ * @file test_upload.cpp
+ * @brief Test driver for upload.cpp
+ *
+ * Each test runs handle_client() on a thread against one end of a
+ * socketpair while the main thread plays the client. Files land in
+ * www/test_uploads, which is removed at the end.
+ *  Type make test_upload to compile; run from the repository root (needs www/)
+ */
+
+#include "http_parser.h"
+#include "upload.h"
+#include <dirent.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+
+const char* DIR_NAME = "test_uploads";
+const char* DIR_PATH = "./www/test_uploads";
+const off_t MAX_BYTES = 1 << 20;
+
+std::string read_file(const std::string &path) {
+    std::ifstream f(path, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+// files in the upload directory, temporaries included
+int count_files() {
+    int n = 0;
+    DIR* d = opendir(DIR_PATH);
+    while (dirent* e = d ? readdir(d) : NULL) {
+        if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) n++;
+    }
+    if (d) closedir(d);
+    return n;
+}
+
+void* serve(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    handle_client(fd);
+    close(fd);
+    return NULL;
+}
+
+/**
+ * Sends the request in pieces (the headers with the start of the body
+ * first, as a real client would), then reads the response. close_early
+ * hangs up after sending, before the body is complete.
+ */
+std::string exchange(const std::vector<std::string> &pieces, bool close_early = false) {
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    pthread_t server;
+    pthread_create(&server, NULL, serve, (void*)(intptr_t)sv[1]);
+
+    for (const std::string &p : pieces) {
+        send(sv[0], p.data(), p.size(), MSG_NOSIGNAL);
+        usleep(20 * 1000);
+    }
+    if (close_early) shutdown(sv[0], SHUT_WR);
+
+    std::string response;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(sv[0], buf, sizeof(buf), 0)) > 0) response.append(buf, n);
+    close(sv[0]);
+    pthread_join(server, NULL);
+    return response;
+}
+
+bool starts_with(const std::string &s, const char* prefix) {
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// TEST 1: a Content-Length body split across reads is stored whole
+bool test_put_content_length() {
+    std::cout << "\n=== Test 1: PUT With Content-Length ===\n";
+    std::string body(300 * 1000, '\0');
+    for (size_t i = 0; i < body.size(); i++) body[i] = (char)(i * 7 + i / 1000);
+
+    std::string head = "PUT /test_uploads/data.bin HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+                       std::to_string(body.size()) + "\r\n\r\n";
+    std::string response = exchange({ head + body.substr(0, 100), body.substr(100) });
+
+    bool created = starts_with(response, "HTTP/1.0 201 Created") &&
+                   response.find("Location: /test_uploads/data.bin\r\n") != std::string::npos;
+    bool stored = read_file(std::string(DIR_PATH) + "/data.bin") == body;
+    std::string again = exchange({ head + body });
+
+    bool passed = created && stored && starts_with(again, "HTTP/1.0 200 OK") && count_files() == 1;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "300000 bytes stored, 201 then 200 on replace\n";
+    return passed;
+}
+
+// TEST 2: chunked bodies with extensions and trailers, POSTed under a new name
+bool test_post_chunked() {
+    std::cout << "\n=== Test 2: POST With Chunked Transfer Coding ===\n";
+    std::string big(70000, 'x');
+    std::string response = exchange({
+        "POST /test_uploads/ HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n"
+        "Expect: 100-continue\r\n\r\n",
+        "5\r\nhello\r\n1;note=ext\r\n \r\n",
+        "11170\r\n" + big + "\r\n",
+        "0\r\nX-Checksum: none\r\n\r\n",
+    });
+
+    bool continued = starts_with(response, "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.0 201 Created");
+    size_t at = response.find("Location: /test_uploads/upload-");
+    std::string stored;
+    if (at != std::string::npos) {
+        size_t end = response.find("\r\n", at);
+        std::string uri = response.substr(at + 10, end - at - 10);
+        stored = read_file("./www" + uri);
+    }
+
+    bool passed = continued && stored == "hello " + big;
+    std::cout << "[Result] " << stored.size() << " bytes stored\n";
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "chunks reassembled under a generated name\n";
+    return passed;
+}
+
+// TEST 3: bodies over the limit are refused and leave nothing behind
+bool test_size_limits() {
+    std::cout << "\n=== Test 3: Size Limits ===\n";
+    int before = count_files();
+    std::string declared = exchange({ "PUT /test_uploads/huge HTTP/1.1\r\nContent-Length: " +
+                                      std::to_string(MAX_BYTES + 1) + "\r\n\r\n" });
+    std::string chunk(64 * 1024, 'y');
+    std::vector<std::string> pieces = { "PUT /test_uploads/huge HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n" };
+    for (int i = 0; i < 17; i++) pieces.push_back("10000\r\n" + chunk + "\r\n");
+    std::string streamed = exchange(pieces);
+
+    bool passed = starts_with(declared, "HTTP/1.0 413") && starts_with(streamed, "HTTP/1.0 413") &&
+                  count_files() == before;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "413 for declared and streamed oversize bodies, no leftovers\n";
+    return passed;
+}
+
+// TEST 4: malformed or unsafe uploads are rejected
+bool test_rejections() {
+    std::cout << "\n=== Test 4: Rejected Uploads ===\n";
+    int before = count_files();
+    std::string traversal = exchange({ "PUT /test_uploads/../index.html HTTP/1.1\r\nContent-Length: 1\r\n\r\nx" });
+    std::string hidden = exchange({ "PUT /test_uploads/.upload-x HTTP/1.1\r\nContent-Length: 1\r\n\r\nx" });
+    std::string no_length = exchange({ "PUT /test_uploads/a HTTP/1.1\r\n\r\n" });
+    std::string truncated = exchange({ "PUT /test_uploads/a HTTP/1.1\r\nContent-Length: 100\r\n\r\nshort" }, true);
+    std::string elsewhere = exchange({ "PUT /index.html HTTP/1.1\r\nContent-Length: 1\r\n\r\nx" });
+    // strtoull() would take the "0x" prefix; a chunk size is bare hex digits
+    std::string bad_chunk = exchange({ "PUT /test_uploads/a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                       "0x5\r\nhello\r\n0\r\n\r\n" });
+
+    bool passed = starts_with(traversal, "HTTP/1.0 403") && starts_with(hidden, "HTTP/1.0 403") &&
+                  starts_with(no_length, "HTTP/1.0 411") && starts_with(truncated, "HTTP/1.0 400") &&
+                  starts_with(elsewhere, "HTTP/1.0 405") && starts_with(bad_chunk, "HTTP/1.0 400") &&
+                  count_files() == before;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "403, 403, 411, 400, 405, 400 and no files written\n";
+    return passed;
+}
+
+// TEST 5: headers split over several segments; a refused body over TCP still gets its status
+bool test_split_and_refused() {
+    std::cout << "\n=== Test 5: Split Headers And Refused Bodies ===\n";
+    std::string split = exchange({ "PUT /test_uploads/split.txt HTTP/1.1\r\nHost: localhost\r\n",
+                                   "Content-Length: 5\r", "\n\r\nhello" });
+    bool stored = starts_with(split, "HTTP/1.0 201") && read_file(std::string(DIR_PATH) + "/split.txt") == "hello";
+    std::string huge = exchange({ "PUT /test_uploads/a HTTP/1.1\r\nX-Pad: " + std::string(UPLOAD_HEAD_MAX, 'p') +
+                                  "\r\nContent-Length: 1\r\n\r\nx" });
+
+    // over a socketpair a close with unread data is harmless; over TCP it resets the connection
+    // (the unread tail of a body sent in one go)
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    bind(lfd, (sockaddr*)&addr, sizeof(addr));
+    listen(lfd, 1);
+    getsockname(lfd, (sockaddr*)&addr, &addr_len);
+    int cfd = socket(AF_INET, SOCK_STREAM, 0);
+    connect(cfd, (sockaddr*)&addr, sizeof(addr));
+    pthread_t server;
+    pthread_create(&server, NULL, serve, (void*)(intptr_t)accept(lfd, NULL, NULL));
+
+    std::string head = "PUT /test_uploads/huge HTTP/1.1\r\nContent-Length: " + std::to_string(MAX_BYTES * 2) + "\r\n\r\n";
+    std::string body(256 * 1024, 'z');
+    head += body;
+    send(cfd, head.data(), head.size(), MSG_NOSIGNAL);
+    std::string refused;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(cfd, buf, sizeof(buf), 0)) > 0) refused.append(buf, n);
+    bool reset = n < 0 && errno == ECONNRESET;
+    close(cfd);
+    pthread_join(server, NULL);
+    close(lfd);
+
+    bool passed = stored && starts_with(huge, "HTTP/1.0 431") && starts_with(refused, "HTTP/1.0 413") && !reset;
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << "201 for split headers, 431 past the cap, 413 read without a reset\n";
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Starting Upload Tests ===\n";
+
+    int passed = 0;
+    int total = 5;
+
+    if (upload_enable(DIR_NAME, MAX_BYTES) < 0) {
+        std::cerr << "[FAIL] Could not create " << DIR_PATH << "\n";
+        return 1;
+    }
+
+    if (test_put_content_length()) passed++;
+    if (test_post_chunked())       passed++;
+    if (test_size_limits())        passed++;
+    if (test_rejections())         passed++;
+    if (test_split_and_refused())  passed++;
+
+    DIR* d = opendir(DIR_PATH);
+    while (dirent* e = d ? readdir(d) : NULL) {
+        if (e->d_name[0] != '.' || strlen(e->d_name) > 2) unlink((std::string(DIR_PATH) + "/" + e->d_name).c_str());
+    }
+    if (d) closedir(d);
+    rmdir(DIR_PATH);
+
+    std::cout << "\n=== Test Results: " << passed << "/" << total << " passed ===\n";
+
+    if (passed == total) {
+        std::cout << "[SUCCESS] All tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "[FAILURE] Some tests failed.\n";
+        return 1;
+    }
+}
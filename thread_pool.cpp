@@ -1,39 +1,139 @@
 #include "thread_pool.h"
+#include "ebr.h"
+#include "ratelimit.h"
+#include "trace.h"
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-static void* worker_loop(void* arg){
-  ThreadPool* pool = (ThreadPool*)arg;
+static const char* LANE_NAMES[NUM_LANES] = {"small", "medium", "large"};
+
+// default task: serve the client and close the connection
+static void serve_client(int fd){
+  handle_client(fd);
+
+  // close client
+  ratelimit_release(fd);
+  uint64_t t = trace_clock();
+  close(fd);
+  trace_span(fd, TRACE_CLOSE, t);
+  printf("[-] Client disconnected (FD: %d)\n", fd);
+}
 
-  while (!pool->stop){
-    // wait for task
-    sem_wait(&pool->sem_tasks);
+static long long now_ns(){
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-    if(pool->stop) break;
+// histogram bucket of a wait: 4 buckets per power of two microseconds (~19% wide)
+static int wait_bucket(uint64_t ns){
+  uint64_t us = ns / 1000;
+  if (us < 4) return (int)us;
+  int log = 63 - __builtin_clzll(us);
+  int bucket = log * 4 + (int)((us >> (log - 2)) & 3);
+  return bucket < WAIT_BUCKETS ? bucket : WAIT_BUCKETS - 1;
+}
 
-    // pop from queue
-    int fd = pool->tasks[pool->task_start];
-    pool->task_start = (pool->task_start + 1) % MAX_TASKS;
+// smallest wait (us) that falls into bucket b
+static double bucket_floor_us(int b){
+  if (b < 4) return b;
+  int log = b / 4;
+  return (double)(1ULL << log) * (1.0 + (b % 4) / 4.0);
+}
+
+/**
+ * Picks the lane to serve next with smooth weighted round robin (as in
+ * nginx upstreams): every eligible lane gains its weight in credit, the
+ * richest one wins and pays back the total. Over time lanes are served in
+ * proportion to their weights without bursts, and an empty or capped lane
+ * does not accumulate credit. Called with the pool lock held.
+ */
+static int pick_lane(ThreadPool* pool){
+  int best = -1;
+  int total = 0;
+  for (int i = 0; i < NUM_LANES; i++){
+    PoolLaneQueue* lane = &pool->lanes[i];
+    if (lane->count == 0 || lane->busy >= lane->max_busy) continue;
+    lane->current += lane->weight;
+    total += lane->weight;
+    if (best < 0 || lane->current > pool->lanes[best].current) best = i;
+  }
+  if (best >= 0) pool->lanes[best].current -= total;
+  return best;
+}
+
+static void* worker_loop(void* arg){
+  ThreadPool* pool = (ThreadPool*)arg;
+  // claim an epoch slot now rather than on this worker's first cache lookup
+  ebr_register_thread();
+
+  pthread_mutex_lock(&pool->lock);
+  while (1){
+    // wait for a task this worker may take
+    int l;
+    while ((l = pick_lane(pool)) < 0){
+      // pool_destroy() sets stop once nothing new is coming: the queue is drained
+      if (pool->stop && pool->task_count == 0){
+        pthread_mutex_unlock(&pool->lock);
+        ebr_unregister_thread();
+        return NULL;
+      }
+      pthread_cond_wait(&pool->task_ready, &pool->lock);
+    }
+
+    // pop from the lane
+    uint64_t t = trace_clock();
+    PoolLaneQueue* lane = &pool->lanes[l];
+    PoolTask task = lane->tasks[lane->start];
+    lane->start = (lane->start + 1) % MAX_TASKS;
+    lane->count--;
+    lane->busy++;
+    pool->task_count--;
+
+    uint64_t waited = now_ns() - task.enqueued_ns;
+    lane->dequeued++;
+    lane->wait_sum_ns += waited;
+    if (waited > lane->wait_max_ns) lane->wait_max_ns = waited;
+    lane->wait_hist[wait_bucket(waited)]++;
+    pthread_mutex_unlock(&pool->lock);
 
     sem_post(&pool->sem_slots);
+    trace_span(task.fd, TRACE_DEQUEUE, t, waited / 1000);
 
-    // handle client                                                                               
-    handle_client(fd); 
+    // handle client
+    pool->handler(task.fd);
 
-    // close client
-    close(fd);
-    printf("[-] Client disconnected (FD: %d)\n", fd);
-    
+    pthread_mutex_lock(&pool->lock);
+    lane->busy--;
+    // a task held back by this lane's cap may be runnable now
+    if (lane->count > 0) pthread_cond_signal(&pool->task_ready);
   }
-  return NULL;
 }
 
 int pool_init(ThreadPool* pool, int num_threads){
-  // populate struct                                                                                
+  return pool_init_handler(pool, num_threads, serve_client);
+}
+
+int pool_init_handler(ThreadPool* pool, int num_threads, task_handler handler){
+  // populate struct
   pool->num_threads = num_threads;
-  pool->task_start = 0;
-  pool->task_end = 0;
+  pool->handler = handler;
+  pool->task_count = 0;
   pool->stop = false;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->task_ready, NULL);
+
+  for (int i = 0; i < NUM_LANES; i++){
+    PoolLaneQueue* lane = &pool->lanes[i];
+    memset(lane, 0, sizeof(*lane));
+    lane->weight = LANE_WEIGHTS[i];
+    lane->max_busy = num_threads;
+  }
+  // large downloads may never take the last worker away from small requests
+  if (num_threads > 1) pool->lanes[LANE_LARGE].max_busy = num_threads - 1;
 
   pool->threads	= (pthread_t*)malloc(sizeof(pthread_t) * num_threads);
   if (pool->threads == NULL){
@@ -41,11 +141,10 @@ int pool_init(ThreadPool* pool, int num_threads){
     return -1;
   }
 
-  // init semaphores                                                                                
-  sem_init(&pool->sem_tasks, 0, 0);
+  // init semaphores
   sem_init(&pool->sem_slots, 0, MAX_TASKS);
 
-  // launch threads                                                                                 
+  // launch threads
   for(int i = 0; i < num_threads; i++){
     pthread_create(&pool->threads[i], NULL, worker_loop, pool);
   }
@@ -54,30 +153,93 @@ int pool_init(ThreadPool* pool, int num_threads){
 }
 
 void pool_destroy(ThreadPool* pool){
-  // notify threads to stop
+  // notify threads to stop; each one exits once the queue is empty
+  pthread_mutex_lock(&pool->lock);
   pool->stop = true;
-
-  // wake up all sleeping workers
-  for (int i = 0; i < pool->num_threads; i++){
-    sem_post(&pool->sem_tasks);
-  }
+  pthread_cond_broadcast(&pool->task_ready);
+  pthread_mutex_unlock(&pool->lock);
 
   // wait for all to exit
   for (int i = 0; i < pool->num_threads; i++){
     pthread_join(pool->threads[i], NULL);
   }
 
-  sem_destroy(&pool->sem_tasks);
   sem_destroy(&pool->sem_slots);
+  pthread_cond_destroy(&pool->task_ready);
+  pthread_mutex_destroy(&pool->lock);
 
   free(pool->threads);
 }
 
 void pool_enqueue(ThreadPool* pool, int client_fd){
+  pool_enqueue_lane(pool, client_fd, LANE_MEDIUM);
+}
+
+void pool_enqueue_lane(ThreadPool* pool, int client_fd, PoolLane lane_id){
+  uint64_t t = trace_clock();
   sem_wait(&pool->sem_slots);
 
-  pool->tasks[pool->task_end] = client_fd;
-  pool->task_end = (pool->task_end + 1) % MAX_TASKS;
+  pthread_mutex_lock(&pool->lock);
+  PoolLaneQueue* lane = &pool->lanes[lane_id];
+  lane->tasks[lane->end].fd = client_fd;
+  lane->tasks[lane->end].enqueued_ns = now_ns();
+  lane->end = (lane->end + 1) % MAX_TASKS;
+  lane->count++;
+  pool->task_count++;
+  pthread_cond_signal(&pool->task_ready);
+  pthread_mutex_unlock(&pool->lock);
+  trace_span(client_fd, TRACE_ENQUEUE, t, lane_id);
+}
+
+PoolLane pool_lane_for_cost(off_t cost){
+  if (cost < 0) return LANE_MEDIUM;
+  if (cost <= LANE_SMALL_MAX) return LANE_SMALL;
+  if (cost <= LANE_MEDIUM_MAX) return LANE_MEDIUM;
+  return LANE_LARGE;
+}
 
-  sem_post(&pool->sem_tasks);
+void pool_lane_stats(ThreadPool* pool, PoolLane lane_id, PoolLaneStats* stats){
+  pthread_mutex_lock(&pool->lock);
+  PoolLaneQueue* lane = &pool->lanes[lane_id];
+  memset(stats, 0, sizeof(*stats));
+  stats->dequeued = lane->dequeued;
+  stats->queued = lane->count;
+  if (lane->dequeued > 0){
+    stats->mean_us = lane->wait_sum_ns / 1000.0 / lane->dequeued;
+    stats->max_us = lane->wait_max_ns / 1000.0;
+
+    // percentiles from the histogram: lower edge of the bucket they fall in
+    uint64_t p50_rank = (lane->dequeued + 1) / 2;
+    uint64_t p99_rank = (uint64_t)ceil(lane->dequeued * 0.99);
+    uint64_t seen = 0;
+    bool have_p50 = false;
+    for (int b = 0; b < WAIT_BUCKETS; b++){
+      seen += lane->wait_hist[b];
+      if (!have_p50 && seen >= p50_rank){
+        stats->p50_us = bucket_floor_us(b);
+        have_p50 = true;
+      }
+      if (seen >= p99_rank){
+        stats->p99_us = bucket_floor_us(b);
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_write_stats(ThreadPool* pool, std::ostream &out){
+  out << "{";
+  for (int i = 0; i < NUM_LANES; i++){
+    PoolLaneStats s;
+    pool_lane_stats(pool, (PoolLane)i, &s);
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "%s\"%s\": {\"dequeued\": %llu, \"queued\": %d, \"wait_mean_us\": %.1f, "
+             "\"wait_p50_us\": %.1f, \"wait_p99_us\": %.1f, \"wait_max_us\": %.1f}",
+             i ? ", " : "", LANE_NAMES[i], (unsigned long long)s.dequeued, s.queued,
+             s.mean_us, s.p50_us, s.p99_us, s.max_us);
+    out << buf;
+  }
+  out << "}";
 }
@@ -3,34 +3,109 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <ostream>
 #include "http_parser.h"
 
 // number of worker threads
 const int NUM_THREADS = 10;
-// max tasks in queue
+// max tasks in queue (over all lanes)
 const int MAX_TASKS = 50;
 
+/**
+ * Priority lanes, classified by the expected response size at enqueue time
+ * so tiny pages do not queue behind large downloads.
+ */
+enum PoolLane {
+    LANE_SMALL,     // routes, errors and files up to LANE_SMALL_MAX
+    LANE_MEDIUM,    // up to LANE_MEDIUM_MAX, or cost not known yet
+    LANE_LARGE,     // everything bigger
+    NUM_LANES
+};
+const off_t LANE_SMALL_MAX = 64 * 1024;
+const off_t LANE_MEDIUM_MAX = 1024 * 1024;
+// dequeue shares when every lane has work (smooth weighted round robin)
+const int LANE_WEIGHTS[NUM_LANES] = {8, 3, 1};
+// log-scale histogram of queue waits: 4 buckets per power of two microseconds
+const int WAIT_BUCKETS = 4 * 32;
+
+// what a worker does with each dequeued fd
+typedef void (*task_handler)(int client_fd);
+
+typedef struct{
+    int fd;
+    long long enqueued_ns;
+  } PoolTask;
+
+/**
+  * @struct PoolLaneQueue
+  * @brief One priority lane: its queue, scheduling state and wait statistics
+  * @var tasks        Circular buffer of queued tasks
+  * @var start        Index of head of the circular queue
+  * @var end          Index of tail of the circular queue
+  * @var count        Number of queued tasks
+  * @var weight       Share of dequeues when all lanes have work
+  * @var current      Smooth weighted round robin credit
+  * @var busy         Workers currently running a task from this lane
+  * @var max_busy     Cap on busy, so one lane can never hold every worker
+  * @var dequeued     Tasks taken from this lane so far
+  * @var wait_sum_ns  Total time those tasks spent queued
+  * @var wait_max_ns  Longest time one of them spent queued
+  * @var wait_hist    Histogram of queue waits (see wait_bucket())
+*/
+typedef struct{
+    PoolTask tasks[MAX_TASKS];
+    int start;
+    int end;
+    int count;
+
+    int weight;
+    int current;
+    int busy;
+    int max_busy;
+
+    uint64_t dequeued;
+    uint64_t wait_sum_ns;
+    uint64_t wait_max_ns;
+    uint64_t wait_hist[WAIT_BUCKETS];
+  } PoolLaneQueue;
+
+/**
+  * @struct PoolLaneStats
+  * @brief Queue wait summary of one lane, in microseconds
+*/
+typedef struct{
+    uint64_t dequeued;
+    int queued;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+  } PoolLaneStats;
+
 /** 
   * @struct ThreadPool
   * @brief Structure representing a thread pool
   * @var threads      Array of thread handles
   * @var num_threads  Number of worker threads
-  * @var tasks        Circular buffer (array) of client file descriptors
-  * @var task_start   Index of head of the circular queue
-  * @var task_end     Index of tail of the circular queue
-  * @var sem_tasks    Semaphore counting the number of pending tasks
+  * @var handler      Called by a worker for every dequeued task
+  * @var lanes        Priority lanes, indexed by PoolLane
+  * @var task_count   Number of queued tasks (all lanes) not yet picked up by a worker
+  * @var lock         Protects the lanes and task_count between workers
+  * @var task_ready   Signaled when a task is queued or a lane's busy count drops
   * @var sem_slots    Semaphore counting the number of free slots in the queue
   * @var stop         Flag to signal threads to stop processing and exit
 */
 typedef struct{
     pthread_t* threads;
     int num_threads;
+    task_handler handler;
 
-    int tasks[MAX_TASKS];
-    int task_start = 0;
-    int task_end = 0;
+    PoolLaneQueue lanes[NUM_LANES];
+    int task_count = 0;
+    pthread_mutex_t lock;
+    pthread_cond_t task_ready;
 
-    sem_t sem_tasks;
     sem_t sem_slots;
 
     bool stop;
@@ -47,9 +122,23 @@ typedef struct{
  */
 int pool_init(ThreadPool* pool, int num_threads);
 
+/**
+ * @brief Same as pool_init() but with a custom task handler.
+ * pool_init() uses a handler that runs handle_client() and closes the fd;
+ * benchmarks and tests can plug in their own work instead.
+ *
+ * @param pool        Pointer to the ThreadPool structure to initialize.
+ * @param num_threads The number of worker threads to launch.
+ * @param handler     Function run for every dequeued fd; it owns the fd.
+ *
+ * @return 0 if successful, -1 on error
+ */
+int pool_init_handler(ThreadPool* pool, int num_threads, task_handler handler);
+
 /**
  * @brief Shuts down the thread pool and cleans up resources.
- * All threads are signaled to stop and memory is reclaimed
+ * Tasks already queued are still handled (graceful drain), then all
+ * threads are signaled to stop and memory is reclaimed
  *
  * @param pool Pointer to the ThreadPool to destroy.
  *
@@ -59,6 +148,7 @@ void pool_destroy(ThreadPool* pool);
 
 /**
  * @brief Adds a new client file descriptor to the processing queue.
+ * Tasks go to LANE_MEDIUM; use pool_enqueue_lane() when the cost is known.
  * Enqueues a new task (client connection) to the task queue
  * Once the task is added, it signals a sleeping worker thread to wake up
  * and process the request.
@@ -69,4 +159,47 @@ void pool_destroy(ThreadPool* pool);
  *
  * @return void
  */
-void pool_enqueue(ThreadPool* pool, int client_fd);
\ No newline at end of file
+void pool_enqueue(ThreadPool* pool, int client_fd);
+
+/**
+ * @brief Adds a client to one priority lane.
+ * Workers pick lanes by weighted round robin, and no lane may occupy every
+ * worker, so small requests keep moving while large downloads are served.
+ *
+ * @param pool      Pointer to the initialized ThreadPool structure.
+ * @param client_fd The client connection.
+ * @param lane      Lane from pool_lane_for_cost().
+ *
+ * @return void
+ */
+void pool_enqueue_lane(ThreadPool* pool, int client_fd, PoolLane lane);
+
+/**
+ * @brief Maps an expected response size onto a lane.
+ *
+ * @param cost Expected body size in bytes, or -1 if not known yet.
+ *
+ * @return The lane to enqueue in
+ */
+PoolLane pool_lane_for_cost(off_t cost);
+
+/**
+ * @brief Summarizes how long tasks of one lane waited in the queue.
+ *
+ * @param pool  Pointer to the initialized ThreadPool structure.
+ * @param lane  Lane to report on.
+ * @param stats Filled in with the summary.
+ *
+ * @return void
+ */
+void pool_lane_stats(ThreadPool* pool, PoolLane lane, PoolLaneStats* stats);
+
+/**
+ * @brief Writes every lane's wait summary as a JSON object.
+ *
+ * @param pool Pointer to the initialized ThreadPool structure.
+ * @param out  Stream to write to.
+ *
+ * @return void
+ */
+void pool_write_stats(ThreadPool* pool, std::ostream &out);
@@ -0,0 +1,262 @@
+#include "trace.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* SPAN_NAMES[NUM_TRACE_SPANS] = {
+    "accept", "enqueue", "dequeue", "recv", "parse", "open", "upstream", "send", "close",
+};
+// name of each span's arg in the JSON, NULL if it has none
+const char* SPAN_ARGS[NUM_TRACE_SPANS] = {
+    NULL, "lane", "queued_us", "bytes", NULL, "size", "status", "bytes", NULL,
+};
+
+struct TraceEvent {
+    uint64_t start_ns;
+    int64_t arg;
+    uint32_t dur_ns;
+    uint32_t conn;
+    pid_t tid;
+    uint8_t span;
+};
+
+/**
+ * Ring of one thread's events. Only the owner writes; it fills the slot
+ * first and publishes it by bumping head, so a dump can copy the ring
+ * while the owner keeps going and drop whatever was overwritten meanwhile.
+ * Buffers outlive their threads and are handed to the next new thread.
+ */
+struct TraceBuffer {
+    std::atomic<uint64_t> head;
+    bool in_use;
+    TraceBuffer* next;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+std::atomic<int> sample_every(0);
+std::atomic<uint64_t> accepted(0);
+// trace id of the connection on each fd, 0 if it is not sampled
+std::atomic<uint32_t> conn_of_fd[TRACE_MAX_FDS];
+
+pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+TraceBuffer* buffers = NULL;
+std::string dump_path;
+bool default_path = true;
+
+thread_local TraceBuffer* own_buffer = NULL;
+thread_local pid_t own_tid = 0;
+thread_local uint32_t bound_conn = 0;
+
+// hands the buffer to the next thread when this one exits
+struct BufferGuard {
+    ~BufferGuard() {
+        if (!own_buffer) return;
+        pthread_mutex_lock(&buffers_lock);
+        own_buffer->in_use = false;
+        pthread_mutex_unlock(&buffers_lock);
+    }
+};
+thread_local BufferGuard buffer_guard;
+
+uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+TraceBuffer* thread_buffer() {
+    if (own_buffer) return own_buffer;
+
+    pthread_mutex_lock(&buffers_lock);
+    TraceBuffer* b = buffers;
+    while (b && b->in_use) b = b->next;
+    if (!b) {
+        b = new TraceBuffer();
+        b->head.store(0, std::memory_order_relaxed);
+        b->next = buffers;
+        buffers = b;
+    }
+    b->in_use = true;
+    pthread_mutex_unlock(&buffers_lock);
+
+    own_buffer = b;
+    own_tid = gettid();
+    (void)&buffer_guard; // constructs the guard so its destructor runs at exit
+    return b;
+}
+
+void record(uint32_t conn, TraceSpan span, uint64_t start_ns, int64_t arg) {
+    uint64_t end = now_ns();
+    TraceBuffer* b = thread_buffer();
+    uint64_t h = b->head.load(std::memory_order_relaxed);
+
+    TraceEvent &e = b->events[h % TRACE_BUFFER_EVENTS];
+    e.start_ns = start_ns;
+    e.arg = arg;
+    uint64_t dur = end > start_ns ? end - start_ns : 0;
+    e.dur_ns = dur > UINT32_MAX ? UINT32_MAX : (uint32_t)dur;
+    e.conn = conn;
+    e.tid = own_tid;
+    e.span = (uint8_t)span;
+    b->head.store(h + 1, std::memory_order_release);
+}
+
+// copies the events of one ring that were not overwritten during the copy
+void snapshot(TraceBuffer* b, std::vector<TraceEvent> &out) {
+    uint64_t head = b->head.load(std::memory_order_acquire);
+    uint64_t first = head > (uint64_t)TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;
+    std::vector<TraceEvent> copy;
+    for (uint64_t i = first; i < head; i++) copy.push_back(b->events[i % TRACE_BUFFER_EVENTS]);
+
+    // slot after % N may be half written already, and it holds event after - N
+    uint64_t after = b->head.load(std::memory_order_acquire);
+    uint64_t safe = after >= (uint64_t)TRACE_BUFFER_EVENTS ? after - TRACE_BUFFER_EVENTS + 1 : 0;
+    for (uint64_t i = std::max(first, safe); i < head; i++) out.push_back(copy[i - first]);
+}
+
+void* dump_loop(void*) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    while (true) {
+        int sig;
+        if (sigwait(&set, &sig) != 0) continue;
+        int n = trace_dump(dump_path.c_str());
+        if (n < 0) perror(dump_path.c_str());
+        else fprintf(stderr, "[trace] Wrote %d events to %s\n", n, dump_path.c_str());
+    }
+    return NULL;
+}
+
+// SIGUSR1 only ever reaches dump_loop(), which blocks everything else
+int start_dump_thread() {
+    sigset_t usr1, all, old;
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &usr1, NULL);
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    pthread_t tid;
+    int rc = pthread_create(&tid, NULL, dump_loop, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to start trace dump thread\n");
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+} // namespace
+
+int trace_init(int argc, char** argv){
+  int every = 0;
+  dump_path = "trace-" + std::to_string(getpid()) + ".json";
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--trace") == 0) every = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--trace-file") == 0){
+      dump_path = argv[++i];
+      default_path = false;
+    }
+  }
+  if (every <= 0) return 0;
+  if (start_dump_thread() < 0) return -1;
+
+  trace_enable(every);
+  printf("Tracing 1 in %d connections, kill -USR1 %d writes %s\n", every, getpid(), dump_path.c_str());
+  return 0;
+}
+
+int trace_forked(){
+  if (!sample_every.load(std::memory_order_relaxed)) return 0;
+
+  // the dump thread may have held the lock when fork() copied it
+  pthread_mutex_init(&buffers_lock, NULL);
+  // one file per process, or they would overwrite each other
+  if (default_path) dump_path = "trace-" + std::to_string(getpid()) + ".json";
+  else dump_path += "." + std::to_string(getpid());
+  return start_dump_thread();
+}
+
+void trace_enable(int every){
+  sample_every.store(every > 0 ? every : 0, std::memory_order_relaxed);
+}
+
+uint64_t trace_clock(){
+  return sample_every.load(std::memory_order_relaxed) ? now_ns() : 0;
+}
+
+void trace_accept(int fd, uint64_t start_ns){
+  if (!start_ns || fd < 0 || fd >= TRACE_MAX_FDS) return;
+
+  int every = sample_every.load(std::memory_order_relaxed);
+  uint64_t n = accepted.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint32_t conn = (every > 0 && n % every == 0) ? (uint32_t)n : 0;
+  conn_of_fd[fd].store(conn, std::memory_order_relaxed);
+  if (conn) record(conn, TRACE_ACCEPT, start_ns, 0);
+}
+
+void trace_span(int fd, TraceSpan span, uint64_t start_ns, int64_t arg){
+  if (!start_ns || fd < 0 || fd >= TRACE_MAX_FDS) return;
+  uint32_t conn = conn_of_fd[fd].load(std::memory_order_relaxed);
+  if (conn) record(conn, span, start_ns, arg);
+}
+
+void trace_bind(int fd){
+  bound_conn = (fd >= 0 && fd < TRACE_MAX_FDS) ? conn_of_fd[fd].load(std::memory_order_relaxed) : 0;
+}
+
+void trace_here(TraceSpan span, uint64_t start_ns, int64_t arg){
+  if (start_ns && bound_conn) record(bound_conn, span, start_ns, arg);
+}
+
+int trace_dump(const char* path){
+  std::vector<TraceEvent> events;
+  pthread_mutex_lock(&buffers_lock);
+  for (TraceBuffer* b = buffers; b; b = b->next) snapshot(b, events);
+  pthread_mutex_unlock(&buffers_lock);
+
+  // a connection's spans in order, so flow arrows can link them across threads
+  std::sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) {
+    return a.conn != b.conn ? a.conn < b.conn : a.start_ns < b.start_ns;
+  });
+
+  FILE* f = fopen(path, "w");
+  if (!f) return -1;
+
+  int pid = getpid();
+  fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"http server\"}}", pid);
+  for (size_t i = 0; i < events.size(); i++){
+    const TraceEvent &e = events[i];
+    double ts = e.start_ns / 1000.0;
+    fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"http\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, "
+               "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"conn\": %u",
+            SPAN_NAMES[e.span], pid, e.tid, ts, e.dur_ns / 1000.0, e.conn);
+    if (SPAN_ARGS[e.span]) fprintf(f, ", \"%s\": %lld", SPAN_ARGS[e.span], (long long)e.arg);
+    fprintf(f, "}}");
+
+    // flow: starts at the connection's first span, steps through the rest
+    bool first = i == 0 || events[i - 1].conn != e.conn;
+    bool last = i + 1 == events.size() || events[i + 1].conn != e.conn;
+    if (first && last) continue;
+    const char* ph = first ? "s" : (last ? "f" : "t");
+    fprintf(f, ",\n{\"name\": \"request\", \"cat\": \"http\", \"ph\": \"%s\", \"id\": %u, \"pid\": %d, "
+               "\"tid\": %d, \"ts\": %.3f%s}",
+            ph, e.conn, pid, e.tid, ts, last ? ", \"bp\": \"e\"" : "");
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  return (int)events.size();
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Opt-in per-request tracing, exported in the Chrome trace-event format.
+ *
+ * A sampled connection gets a trace id when it is accepted; every span
+ * recorded for it afterwards (on whichever thread serves it) carries that
+ * id, so one slow request can be followed from accept() to close() in
+ * chrome://tracing or ui.perfetto.dev. Spans go into a per-thread ring
+ * buffer without locks; SIGUSR1 (or trace_dump()) writes the buffers out.
+ *
+ * With tracing off, trace_clock() returns 0 and every other call returns
+ * right away. With tracing on, unsampled connections cost one table load
+ * per span, so "--trace 1000" can stay enabled under production load.
+ */
+
+// events kept per thread; older ones are overwritten
+const int TRACE_BUFFER_EVENTS = 16 * 1024;
+// client fds above this are never traced
+const int TRACE_MAX_FDS = 64 * 1024;
+
+enum TraceSpan {
+    TRACE_ACCEPT,   // accept() returned the connection
+    TRACE_ENQUEUE,  // handed to the pool (arg: lane)
+    TRACE_DEQUEUE,  // taken by a worker (arg: microseconds spent queued)
+    TRACE_RECV,     // request read (arg: bytes)
+    TRACE_PARSE,    // request line parsed
+    TRACE_OPEN,     // file looked up in the fd cache (arg: file size)
+    TRACE_UPSTREAM, // proxied request sent, upstream's response head read (arg: status)
+    TRACE_SEND,     // response written (arg: bytes)
+    TRACE_CLOSE,    // connection closed
+    NUM_TRACE_SPANS
+};
+
+/**
+ * @brief Turns tracing on if the command line asks for it.
+ * Understands "--trace N" (sample one connection in N, 1 traces all) and
+ * "--trace-file PATH" (default trace-<pid>.json). Starts a thread that
+ * dumps the buffers on SIGUSR1; call before lifecycle_init() so no other
+ * thread is created with SIGUSR1 unblocked.
+ *
+ * @param argc main()'s argc.
+ * @param argv main()'s argv.
+ * @return 0 if successful (or tracing not requested), -1 on error
+ */
+int trace_init(int argc, char** argv);
+
+/**
+ * @brief Restarts the SIGUSR1 dump thread in a process forked after trace_init().
+ * The process writes its own file: trace-<pid>.json, or the --trace-file
+ * path with ".<pid>" appended.
+ *
+ * @return 0 if successful (or tracing is off), -1 on error
+ */
+int trace_forked();
+
+/**
+ * @brief Turns tracing on directly (tests, embedding).
+ *
+ * @param sample_every Sample one connection in this many; 0 turns tracing off.
+ */
+void trace_enable(int sample_every);
+
+/**
+ * @brief Start time of a span.
+ *
+ * @return CLOCK_MONOTONIC nanoseconds, or 0 while tracing is off
+ */
+uint64_t trace_clock();
+
+/**
+ * @brief Decides whether a new connection is sampled and records its accept span.
+ *
+ * @param fd       Accepted client socket.
+ * @param start_ns trace_clock() taken before accept().
+ */
+void trace_accept(int fd, uint64_t start_ns);
+
+/**
+ * @brief Records a span [start_ns, now] for a connection, if it is sampled.
+ *
+ * @param fd       Client socket.
+ * @param span     What happened.
+ * @param start_ns trace_clock() taken when it started (0 records nothing).
+ * @param arg      Span-specific value (see TraceSpan).
+ */
+void trace_span(int fd, TraceSpan span, uint64_t start_ns, int64_t arg = 0);
+
+/**
+ * @brief Makes fd the connection this thread is serving, for trace_here().
+ * Code that does not see the socket (e.g. http_build_response()) can then
+ * still attribute its spans. Pass -1 when done.
+ *
+ * @param fd Client socket, or -1.
+ */
+void trace_bind(int fd);
+
+/**
+ * @brief Records a span for the connection bound with trace_bind().
+ *
+ * @param span     What happened.
+ * @param start_ns trace_clock() taken when it started (0 records nothing).
+ * @param arg      Span-specific value (see TraceSpan).
+ */
+void trace_here(TraceSpan span, uint64_t start_ns, int64_t arg = 0);
+
+/**
+ * @brief Writes every thread's buffered spans as Chrome trace-event JSON.
+ * Safe to call while other threads keep recording.
+ *
+ * @param path Output file.
+ * @return Number of events written, or -1 if the file cannot be written
+ */
+int trace_dump(const char* path);
@@ -0,0 +1,196 @@
+#include "upload.h"
+#include "body_io.h"
+#include "http_parser.h"
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+// "./www/<dir>" on disk, "/<dir>/" in URIs; empty while uploads are off
+std::string upload_path;
+std::string upload_uri;
+off_t max_bytes = UPLOAD_DEFAULT_MAX;
+
+std::atomic<uint64_t> stored(0);
+std::atomic<uint64_t> stored_bytes(0);
+std::atomic<uint64_t> rejected(0);
+std::atomic<uint64_t> failed(0);
+std::atomic<uint64_t> sequence(0);
+
+void fail(UploadResult* result, int status, const char* reason) {
+    result->status = status;
+    result->reason = reason;
+    result->uri.clear();
+    if (status >= 500) failed++;
+    else rejected++;
+}
+
+// a plain file name: no dot files (temporaries), no traversal, no subdirectories
+bool valid_name(const std::string &name) {
+    if (name.empty() || name.size() > 255 || name[0] == '.') return false;
+    for (char c : name) {
+        if (!isalnum((unsigned char)c) && c != '.' && c != '_' && c != '-') return false;
+    }
+    return true;
+}
+
+// decodes chunked transfer coding (RFC 9112 7.1); chunk data is spliced like a plain body
+bool copy_chunks(BodyReader* r, int file_fd, off_t* offset, const int pipe_fds[2], bool* too_big) {
+    std::string line;
+    for (;;) {
+        unsigned long long size;
+        if (!body_read_line(r, line, UPLOAD_LINE_MAX) || !body_chunk_size(line, &size)) return false;
+        if (size == 0) break;
+        if (size > (unsigned long long)(max_bytes - *offset)) {
+            *too_big = true;
+            return false;
+        }
+        if (!body_splice(r, file_fd, offset, (off_t)size, pipe_fds, UPLOAD_PIPE_SIZE, NULL)) return false;
+        if (!body_read_line(r, line, UPLOAD_LINE_MAX) || !line.empty()) return false;
+    }
+    // trailer fields up to the blank line are discarded
+    do {
+        if (!body_read_line(r, line, UPLOAD_LINE_MAX)) return false;
+    } while (!line.empty());
+    return true;
+}
+
+} // namespace
+
+int upload_init(int argc, char** argv){
+  const char* dir = NULL;
+  off_t max = UPLOAD_DEFAULT_MAX;
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--uploads") == 0) dir = argv[++i];
+    else if (strcmp(argv[i], "--upload-max") == 0) max = atoll(argv[++i]);
+  }
+  if (!dir) return 0;
+  if (upload_enable(dir, max) < 0){
+    perror("Failed to create the upload directory");
+    return -1;
+  }
+  http_register_stats("uploads", upload_write_stats, NULL);
+  printf("Accepting uploads into %s (at most %lld bytes each)\n", upload_path.c_str(), (long long)max);
+  return 0;
+}
+
+int upload_enable(const char* dir, off_t max){
+  if (!valid_name(dir)){
+    errno = EINVAL;
+    return -1;
+  }
+  std::string path = std::string("./www/") + dir;
+  if (mkdir(path.c_str(), 0755) < 0 && errno != EEXIST) return -1;
+  upload_path = path;
+  upload_uri = std::string("/") + dir + "/";
+  max_bytes = max > 0 ? max : UPLOAD_DEFAULT_MAX;
+  return 0;
+}
+
+bool upload_request(const char* req, size_t len){
+  if (upload_path.empty()) return false;
+  std::string method, uri, version;
+  parse_request_line(req, len, method, uri, version);
+  return (method == "PUT" || method == "POST") && uri.compare(0, upload_uri.size(), upload_uri) == 0;
+}
+
+void upload_receive(int client_fd, const char* received, size_t received_len, UploadResult* result){
+  result->bytes = 0;
+  // a stalled client must not hold a worker forever (splice() honours this as well)
+  timeval idle = { UPLOAD_IDLE_TIMEOUT_S, 0 };
+  setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+
+  // the first read may have ended inside the headers
+  std::string buf(received, received_len);
+  ssize_t head_len = body_read_head(client_fd, buf, UPLOAD_HEAD_MAX);
+  if (head_len < 0 && errno == EMSGSIZE) return fail(result, 431, "Request Header Fields Too Large");
+  if (head_len <= 0) return fail(result, 400, "Bad Request");
+  const char* req = buf.data();
+  size_t len = buf.size();
+  const char* body = req + head_len;
+
+  std::string method, uri, version;
+  parse_request_line(req, len, method, uri, version);
+
+  // PUT names the file; POST to the directory itself gets a fresh name
+  std::string name = uri.substr(upload_uri.size());
+  if (method == "POST" && name.empty()){
+    name = "upload-" + std::to_string(time(NULL)) + "-" + std::to_string(getpid()) + "-" +
+           std::to_string(sequence.fetch_add(1, std::memory_order_relaxed));
+  }
+  if (!valid_name(name)) return fail(result, 403, "Forbidden");
+
+  bool chunked = has_token(header_value(req, len, "Transfer-Encoding"), "chunked");
+  std::string length_header = header_value(req, len, "Content-Length");
+  off_t length = -1;
+  if (!chunked){
+    if (length_header.empty()) return fail(result, 411, "Length Required");
+    char* end;
+    length = strtoll(length_header.c_str(), &end, 10);
+    if (*end || length < 0) return fail(result, 400, "Bad Request");
+    if (length > max_bytes) return fail(result, 413, "Content Too Large");
+  }
+
+  if (has_token(header_value(req, len, "Expect"), "100-continue")){
+    const char* go_on = "HTTP/1.1 100 Continue\r\n\r\n";
+    send(client_fd, go_on, strlen(go_on), MSG_NOSIGNAL);
+  }
+  std::string tmp = upload_path + "/.upload-XXXXXX";
+  int file_fd = mkstemp(&tmp[0]);
+  if (file_fd < 0) return fail(result, 500, "Internal Server Error");
+  fchmod(file_fd, 0644);
+
+  int pipe_fds[2];
+  if (body_open_pipe(pipe_fds, UPLOAD_PIPE_SIZE) < 0){
+    close(file_fd);
+    unlink(tmp.c_str());
+    return fail(result, 500, "Internal Server Error");
+  }
+
+  uint64_t t = trace_clock();
+  BodyReader reader = { client_fd, body, len - (body - req) };
+  off_t offset = 0;
+  bool too_big = false;
+  bool ok = chunked ? copy_chunks(&reader, file_fd, &offset, pipe_fds, &too_big)
+                    : body_splice(&reader, file_fd, &offset, length, pipe_fds, UPLOAD_PIPE_SIZE, NULL);
+  trace_span(client_fd, TRACE_RECV, t, offset);
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+
+  if (!ok){
+    close(file_fd);
+    unlink(tmp.c_str());
+    if (too_big) return fail(result, 413, "Content Too Large");
+    return fail(result, 400, "Bad Request");
+  }
+
+  // the rename is the commit point: readers never see a partial file
+  std::string target = upload_path + "/" + name;
+  bool existed = access(target.c_str(), F_OK) == 0;
+  if (close(file_fd) < 0 || rename(tmp.c_str(), target.c_str()) < 0){
+    unlink(tmp.c_str());
+    return fail(result, 500, "Internal Server Error");
+  }
+
+  stored++;
+  stored_bytes += offset;
+  result->status = existed ? 200 : 201;
+  result->reason = existed ? "OK" : "Created";
+  result->uri = upload_uri + name;
+  result->bytes = offset;
+}
+
+void upload_write_stats(std::ostream &out, void*){
+  out << "{\"stored\": " << stored.load() << ", \"bytes\": " << stored_bytes.load()
+      << ", \"rejected\": " << rejected.load() << ", \"failed\": " << failed.load() << "}";
+}
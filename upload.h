@@ -0,0 +1,96 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * PUT/POST uploads into one directory under ./www.
+ *
+ * Bodies framed by Content-Length or chunked transfer coding are moved
+ * socket -> pipe -> file with splice(), so payload bytes never enter user
+ * space; only chunk-size lines are read. Each upload goes to a hidden
+ * temporary file that is renamed over the target once the body is
+ * complete, so readers see either the old file or the whole new one.
+ *
+ * Off unless a server is started with --uploads DIR.
+ */
+
+// largest accepted body unless --upload-max says otherwise
+const off_t UPLOAD_DEFAULT_MAX = 256LL << 20;
+// capacity requested for the splice pipe (capped by /proc/sys/fs/pipe-max-size)
+const int UPLOAD_PIPE_SIZE = 1 << 20;
+// a client sending nothing for this long loses its upload
+const int UPLOAD_IDLE_TIMEOUT_S = 30;
+// longest chunk-size or trailer line accepted in a chunked body
+const size_t UPLOAD_LINE_MAX = 1024;
+// largest request header block accepted, however many segments it comes in
+const size_t UPLOAD_HEAD_MAX = 16 * 1024;
+// how long a refused upload's remaining body is read and dropped before the close
+const int UPLOAD_LINGER_MS = 2000;
+
+/**
+ * @struct UploadResult
+ * @brief Outcome of one upload, turned into the response by handle_client()
+ * @var status HTTP status (201 created, 200 replaced, 4xx/5xx if nothing was stored)
+ * @var reason Reason phrase for status
+ * @var uri    URI the stored file is served at, empty on failure
+ * @var bytes  Body bytes written to the file
+*/
+typedef struct{
+    int status;
+    const char* reason;
+    std::string uri;
+    off_t bytes;
+  } UploadResult;
+
+/**
+ * @brief Enables uploads if the command line asks for it.
+ * Understands "--uploads DIR" (a directory under ./www, created if missing;
+ * PUT /DIR/name stores a file, POST /DIR/ stores one under a new name) and
+ * "--upload-max BYTES".
+ *
+ * @param argc main()'s argc.
+ * @param argv main()'s argv.
+ * @return 0 if successful (or uploads not requested), -1 if the directory cannot be created
+ */
+int upload_init(int argc, char** argv);
+
+/**
+ * @brief Enables uploads directly (tests, embedding).
+ *
+ * @param dir       Directory name under ./www, without slashes.
+ * @param max_bytes Largest accepted body.
+ * @return 0 if successful, -1 if the directory cannot be created
+ */
+int upload_enable(const char* dir, off_t max_bytes);
+
+/**
+ * @brief Whether a request is a PUT or POST into the upload directory.
+ *
+ * @param req Raw request bytes.
+ * @param len Number of bytes in req.
+ * @return True if upload_receive() should take the request
+ */
+bool upload_request(const char* req, size_t len);
+
+/**
+ * @brief Streams a request body into the upload directory.
+ * Sends "100 Continue" if the client waits for it. The socket must be
+ * positioned right after the len bytes already received; headers that
+ * did not fit in them are read first (431 past UPLOAD_HEAD_MAX).
+ *
+ * @param client_fd The connected client (blocking).
+ * @param req       Bytes received so far: at least the request line, maybe the whole head and some body.
+ * @param len       Number of bytes in req.
+ * @param result    Receives the outcome.
+ */
+void upload_receive(int client_fd, const char* req, size_t len, UploadResult* result);
+
+/**
+ * @brief Writes upload counters as JSON (the "uploads" /__stats section).
+ *
+ * @param out Stream receiving a JSON object.
+ * @param ctx Unused.
+ */
+void upload_write_stats(std::ostream &out, void* ctx);